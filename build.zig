@@ -4,6 +4,10 @@ pub fn build(b: *std.Build) void {
     const target = b.standardTargetOptions(.{});
     const optimize = b.standardOptimizeOption(.{});
 
+    const memory_poison = b.option(MemoryPoison, "memory-poison", "Selects how unused memory is poisoned. Defaults to 'pattern' in debug builds and 'none' otherwise. 'asan' requires an AddressSanitizer build.");
+    const lexer = b.option(Lexer, "lexer", "Selects the lexer implementation. 'flex' generates it from src/parser/lexer.l, 'handwritten' uses the SIMD accelerated src/parser/lexer.c.") orelse .flex;
+    const parser = b.option(Parser, "parser", "Selects the parser implementation. 'bison' generates it from src/parser/parser.y, 'recursive_descent' uses the hand-written src/parser/descent.c and needs no bison.") orelse .bison;
+
     const flex_dep = b.dependency("flex", .{});
     const flex = flex_dep.artifact("flex");
 
@@ -35,7 +39,9 @@ pub fn build(b: *std.Build) void {
 
     // the "flex" output depends on the header that is generated by
     // the "bison" step
-    lexer_gen.step.dependOn(&parser_gen.step);
+    if (parser == .bison) {
+        lexer_gen.step.dependOn(&parser_gen.step);
+    }
 
     // Also install the C sources and headers if requested:
     {
@@ -56,6 +62,10 @@ pub fn build(b: *std.Build) void {
         bundle_step.dependOn(&b.addInstallFile(.{ .path = "include/apigen.h" }, "include/apigen.h").step); // public header
         bundle_step.dependOn(&b.addInstallFile(.{ .path = "src/apigen-internals.h" }, "include/apigen-internals.h").step); // public header
         bundle_step.dependOn(&b.addInstallFile(.{ .path = "src/parser/parser.h" }, "src/parser/parser.h").step); // internal header
+        bundle_step.dependOn(&b.addInstallFile(.{ .path = "src/parser/lexer.h" }, "src/parser/lexer.h").step); // internal header
+        bundle_step.dependOn(&b.addInstallFile(.{ .path = "src/parser/lexer.c" }, "src/parser/lexer.c").step); // alternative lexer
+        bundle_step.dependOn(&b.addInstallFile(.{ .path = "src/parser/descent.h" }, "src/parser/descent.h").step); // internal header
+        bundle_step.dependOn(&b.addInstallFile(.{ .path = "src/parser/descent.c" }, "src/parser/descent.c").step); // alternative parser
     }
 
     const exe = b.addExecutable(.{
@@ -66,16 +76,33 @@ pub fn build(b: *std.Build) void {
     });
 
     exe.addIncludePath(BuildHelper.getPathDir(lexer_h_source));
-    exe.addIncludePath(BuildHelper.getPathDir(parser_h_source));
+    if (parser == .bison) {
+        exe.addIncludePath(BuildHelper.getPathDir(parser_h_source));
+    }
 
     exe.linkLibC();
     exe.addIncludePath(.{ .path = "include" });
     exe.addCSourceFiles(&apigen_sources, &strict_cflags);
+    if (memory_poison) |mode| {
+        exe.defineCMacro("APIGEN_MEMORY_POISON", mode.macroValue());
+    }
 
     // both require access to "parser.h":
     const local_include = [_][]const u8{ "-I", b.pathFromRoot("src") };
-    exe.addCSourceFile(.{ .file = lexer_c_source, .flags = &lax_cflags ++ local_include });
-    exe.addCSourceFile(.{ .file = parser_c_source, .flags = &lax_cflags ++ local_include });
+    switch (lexer) {
+        .flex => exe.addCSourceFile(.{ .file = lexer_c_source, .flags = &lax_cflags ++ local_include }),
+        .handwritten => {
+            exe.defineCMacro("APIGEN_USE_HANDWRITTEN_LEXER", null);
+            exe.addCSourceFile(.{ .file = .{ .path = "src/parser/lexer.c" }, .flags = &strict_cflags ++ local_include });
+        },
+    }
+    switch (parser) {
+        .bison => exe.addCSourceFile(.{ .file = parser_c_source, .flags = &lax_cflags ++ local_include }),
+        .recursive_descent => {
+            exe.defineCMacro("APIGEN_USE_RECURSIVE_DESCENT_PARSER", null);
+            exe.addCSourceFile(.{ .file = .{ .path = "src/parser/descent.c" }, .flags = &strict_cflags ++ local_include });
+        },
+    }
 
     b.installArtifact(exe);
 
@@ -100,6 +127,50 @@ pub fn build(b: *std.Build) void {
             test_step.dependOn(&run.step);
         }
 
+        // includes are parsed and types are resolved differently with multiple jobs, so run the analyzer tests again:
+        for (analyzer_test_files) |test_file| {
+            const run = b.addRunArtifact(exe);
+            run.addArg("--test-mode=analyzer");
+            run.addArg("--jobs=4");
+            run.addFileSourceArg(.{ .path = test_file });
+            run.addCheck(.{ .expect_term = .{ .Exited = 0 } });
+            run.stdin = .{ .bytes = "" };
+            run.has_side_effects = true;
+            test_step.dependOn(&run.step);
+        }
+
+        // doc comments must not change what is accepted:
+        for (analyzer_test_files) |test_file| {
+            const run = b.addRunArtifact(exe);
+            run.addArg("--test-mode=analyzer");
+            run.addArg("--no-docs");
+            run.addFileSourceArg(.{ .path = test_file });
+            run.addCheck(.{ .expect_term = .{ .Exited = 0 } });
+            run.stdin = .{ .bytes = "" };
+            run.has_side_effects = true;
+            test_step.dependOn(&run.step);
+        }
+
+        // the first run fills the module cache, the second one only loads from it:
+        const module_cache_dir = b.makeTempPath();
+        for (analyzer_test_files) |test_file| {
+            var previous_run: ?*std.Build.Step.Run = null;
+            for (0..2) |_| {
+                const run = b.addRunArtifact(exe);
+                run.addArg("--test-mode=analyzer");
+                run.addArgs(&.{ "--module-cache", module_cache_dir });
+                run.addFileSourceArg(.{ .path = test_file });
+                run.addCheck(.{ .expect_term = .{ .Exited = 0 } });
+                run.stdin = .{ .bytes = "" };
+                run.has_side_effects = true;
+                if (previous_run) |previous| {
+                    run.step.dependOn(&previous.step);
+                }
+                test_step.dependOn(&run.step);
+                previous_run = run;
+            }
+        }
+
         const BackendLang = enum { c, @"c++", rust, zig, go };
 
         const enabled_backends = [_]BackendLang{ .c, .zig };
@@ -183,10 +254,14 @@ pub fn build(b: *std.Build) void {
                     "tests/unit/arena.c",
                     "tests/unit/framework.c",
                     "tests/unit/io.c",
+                    "tests/unit/string-pool.c",
+                    "tests/unit/type-pool.c",
 
                     "src/base.c",
                     "src/memory.c",
                     "src/io.c",
+                    "src/string-pool.c",
+                    "src/type-pool.c",
                 },
                 &strict_cflags,
             );
@@ -208,9 +283,11 @@ const apigen_sources = [_][]const u8{
     "src/base.c",
     "src/diag.c",
     "src/type-pool.c",
+    "src/string-pool.c",
     "src/test-runner.c",
     "src/analyzer.c",
     "src/parser/parser.c",
+    "src/parser/module-cache.c",
     "src/gen/c_cpp.c",
     "src/gen/rust.c",
     "src/gen/zig.c",
@@ -269,7 +346,12 @@ const analyzer_positive_files = [_][]const u8{
     "tests/analyzer/ok/include.api",
     "tests/analyzer/ok/nested-include.api",
     "tests/analyzer/ok/empty-include.api",
+    "tests/analyzer/ok/diamond-include.api",
+    "tests/analyzer/ok/include-cycle.api",
+    "tests/analyzer/ok/include-spelling.api",
     "tests/analyzer/ok/fn-with-alias-type.api",
+    "tests/analyzer/ok/many-members.api",
+    "tests/analyzer/ok/mixed-declarations.api",
 };
 
 const analyzer_negative_files = [_][]const u8{
@@ -295,6 +377,14 @@ const analyzer_negative_files = [_][]const u8{
     "tests/analyzer/fail/nested-struct-bad.api",
     "tests/analyzer/fail/union-empty.api",
     "tests/analyzer/fail/constexpr-type-unsupported.api",
+    "tests/analyzer/fail/alias-cycle.api",
+    "tests/analyzer/fail/alias-undeclared.api",
+    "tests/analyzer/fail/include-spelling.api",
+    "tests/analyzer/fail/struct-duplicate-field-many.api",
+    "tests/analyzer/fail/duplicate-parameter-many.api",
+    "tests/analyzer/fail/enum-duplicate-item-many.api",
+    "tests/analyzer/fail/enum-duplicate-value-many.api",
+    "tests/analyzer/fail/mixed-declarations.api",
 };
 
 const lax_cflags = [_][]const u8{"-std=c11"};
@@ -328,6 +418,30 @@ const analyzer_test_files = analyzer_positive_files ++ analyzer_negative_files +
 
 const backend_test_files = analyzer_positive_files ++ general_examples;
 
+const MemoryPoison = enum {
+    none,
+    pattern,
+    asan,
+
+    fn macroValue(mode: MemoryPoison) []const u8 {
+        return switch (mode) {
+            .none => "0",
+            .pattern => "1",
+            .asan => "2",
+        };
+    }
+};
+
+const Lexer = enum {
+    flex,
+    handwritten,
+};
+
+const Parser = enum {
+    bison,
+    recursive_descent,
+};
+
 const BuildHelper = struct {
     pub fn getPathDir(path: std.Build.LazyPath) std.Build.LazyPath {
         const ComputeStep = struct {
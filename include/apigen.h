@@ -47,6 +47,7 @@ struct apigen_Stream;
 enum apigen_FileMode {
     APIGEN_IO_INPUT = 0,
     APIGEN_IO_OUTPUT = 1,
+    APIGEN_IO_INPUT_OPTIONAL = 2, ///< same as `APIGEN_IO_INPUT`, but a missing file is not reported
 };
 
 struct apigen_Directory
@@ -54,14 +55,24 @@ struct apigen_Directory
     void * context;
     bool (*openDir)(void * context, char const * file_name, struct apigen_Directory * out_dir);
     bool (*openFile)(void * context, enum apigen_FileMode mode, char const * file_name, struct apigen_Stream * out_file);
+    bool (*replaceFile)(void * context, char const * file_name, char const * data, size_t length); ///< optional, see `apigen_io_replace_file`
     void (*close)(void * context);
 };
 
+/// Identifies a file independent of the path it was opened with.
+struct apigen_FileId
+{
+    uint64_t device;
+    uint64_t inode;
+};
+
 struct apigen_Stream
 {
     void * context;
     void (*write)(void * context, char const * data, size_t length);
     size_t (*read)(void * context, char * data, size_t length);
+    char * (*map)(void * context, size_t * out_length); ///< optional, see `apigen_io_map`
+    bool (*identify)(void * context, struct apigen_FileId * out_id); ///< optional, see `apigen_io_identify`
     void (*close)(void * context);
 };
 
@@ -74,10 +85,15 @@ extern struct apigen_Stream const apigen_io_null;
 // open the current directory
 struct apigen_Directory apigen_io_cwd(void);
 bool apigen_io_open_file_read(struct apigen_Directory parent, char const * path, struct apigen_Stream * out_stream);
+bool apigen_io_open_file_read_optional(struct apigen_Directory parent, char const * path, struct apigen_Stream * out_stream); ///< does not report missing files
 bool apigen_io_open_file_write(struct apigen_Directory parent, char const * path, struct apigen_Stream * out_stream);
 bool apigen_io_open_dir(struct apigen_Directory parent, char const * path, struct apigen_Directory * out_dir);
 void apigen_io_close_dir(struct apigen_Directory * dir);
 
+/// Creates or replaces the file at `path` with `data`. The file is replaced atomically, so concurrent
+/// readers either see the old or the new contents, but never a partially written file.
+bool apigen_io_replace_file(struct apigen_Directory dir, char const * path, char const * data, size_t length);
+
 struct apigen_Stream apigen_io_from_stream(FILE * file);
 void apigen_io_close(struct apigen_Stream * stream);
 
@@ -88,6 +104,15 @@ void apigen_io_print(struct apigen_Stream stream, char const * data);
 
 size_t apigen_io_read(struct apigen_Stream stream, char * data, size_t length);
 
+/// Maps the complete contents of an input stream into memory and returns them, or `NULL` if the
+/// stream cannot be mapped (for example stdin). The buffer stays valid until the stream is closed.
+/// It is writable, but changes are private to the process and never written back.
+/// The buffer is followed by two zero bytes that are not included in `out_length`.
+char * apigen_io_map(struct apigen_Stream stream, size_t * out_length);
+
+/// Stores the identity of the file behind `stream` in `out_id`. Returns `false` if the stream is not a file.
+bool apigen_io_identify(struct apigen_Stream stream, struct apigen_FileId * out_id);
+
 
 char * apigen_io_dirname(char const * path); // returned memory must be freed with apigen_free, returns NULL if no dirname is present.
 
@@ -250,32 +275,226 @@ struct apigen_FunctionType
 void * apigen_alloc(size_t size);
 void   apigen_free(void * ptr);
 
+/// The subsystems the memory profiler distinguishes. Each allocation is accounted to the
+/// tag that is active on the calling thread.
+enum apigen_MemoryTag
+{
+    APIGEN_MEMORY_TAG_OTHER = 0,
+    APIGEN_MEMORY_TAG_LEXER,
+    APIGEN_MEMORY_TAG_PARSER,
+    APIGEN_MEMORY_TAG_ANALYZER,
+    APIGEN_MEMORY_TAG_DIAGNOSTICS,
+    APIGEN_MEMORY_TAG_BACKEND,
+
+    APIGEN_MEMORY_TAG_COUNT,
+};
+
+struct apigen_MemoryTagStats
+{
+    size_t heap_allocs;     ///< number of `apigen_alloc` calls
+    size_t heap_current;    ///< bytes currently allocated with `apigen_alloc`
+    size_t heap_peak;       ///< maximum of `heap_current`
+    size_t arena_allocs;    ///< number of arena allocations
+    size_t arena_requested; ///< bytes requested from arenas
+    size_t arena_padding;   ///< bytes lost to alignment inside arenas
+    size_t arena_chunks;    ///< bytes of chunk memory arenas had to obtain for this tag
+};
+
+/// Sets the active memory tag of the calling thread and returns the previous one.
+enum apigen_MemoryTag apigen_memory_set_tag(enum apigen_MemoryTag tag);
+
+char const * apigen_memory_tag_name(enum apigen_MemoryTag tag);
+
+/// Enables the heap statistics, which are only kept for allocations made afterwards.
+/// Must be called before other threads are started.
+void apigen_memory_enable_stats(void);
+
+/// Returns the statistics of `tag`. Arena statistics of other threads are only included
+/// after they called `apigen_memory_flush_thread_stats`.
+struct apigen_MemoryTagStats apigen_memory_get_stats(enum apigen_MemoryTag tag);
+
+/// Adds the arena statistics of the calling thread to the global statistics.
+/// Threads other than the main thread must call this before they exit.
+void apigen_memory_flush_thread_stats(void);
+
 struct apigen_MemoryArenaChunk;
 
+/// Upper limit for the number of chunk tails an arena keeps for reuse.
+#define APIGEN_MEMORY_ARENA_MAX_PARTIAL_CHUNKS 8
+
 struct apigen_MemoryArena
 {
     struct apigen_MemoryArenaChunk * first_chunk;
     struct apigen_MemoryArenaChunk * last_chunk;
-    size_t                           chunk_size;
+    struct apigen_MemoryArenaChunk * partial_chunks;  ///< retired chunks which still have a usable tail
+    size_t                           chunk_size;      ///< size of the next regular chunk, doubles with each new chunk
+    size_t                           max_chunk_size;  ///< upper limit for `chunk_size`, may be changed after init
+    size_t                           reserved_size;   ///< size of the virtual memory reservation, 0 for chunked arenas
+    size_t                           committed_front; ///< committed bytes at the start of the reservation
+    size_t                           committed_back;  ///< committed bytes at the end of the reservation
+    struct apigen_MemoryArenaChunk * adopted_chunks;  ///< chunks taken over from other arenas, only released on deinit
+    struct apigen_MemoryArenaChunk * free_chunks;     ///< empty chunks left over by `apigen_memory_arena_reset`, used before new ones are allocated
+    struct apigen_MemoryArenaChunk * mark_chunk;      ///< `last_chunk` at the newest mark, allocations before it must not grow in place
+    size_t                           mark_used;       ///< bytes used in `mark_chunk` at the newest mark
 };
 
 void apigen_memory_arena_init(struct apigen_MemoryArena * arena);
+
+/// Initializes `arena` as a single reservation of `reserve_size` bytes of virtual memory that is committed on demand.
+/// Allocations are a contiguous bump and never call malloc, but the arena cannot grow beyond the reservation.
+/// If `use_huge_pages` is set, the kernel is asked to back the reservation with huge pages.
+/// Returns `false` if the platform does not support reservations, the arena is not initialized then.
+bool apigen_memory_arena_init_reserved(struct apigen_MemoryArena * arena, size_t reserve_size, bool use_huge_pages);
 void apigen_memory_arena_deinit(struct apigen_MemoryArena * arena);
 
+/// Allocates `size` bytes aligned to `alignof(max_align_t)`.
 void * apigen_memory_arena_alloc(struct apigen_MemoryArena * arena, size_t size);
+
+/// Allocates `size` bytes aligned to `alignment`, which must be a power of two not larger than `alignof(max_align_t)`.
+void * apigen_memory_arena_alloc_aligned(struct apigen_MemoryArena * arena, size_t size, size_t alignment);
+
+/// Allocates `size` bytes without any alignment or padding. Use this for strings and other byte data.
+char * apigen_memory_arena_alloc_packed(struct apigen_MemoryArena * arena, size_t size);
+
 char * apigen_memory_arena_dupestr(struct apigen_MemoryArena * arena, char const * str);
 
+/// The allocation position of a chunk, saved by `apigen_memory_arena_mark`.
+struct apigen_MemoryArenaChunkPosition
+{
+    struct apigen_MemoryArenaChunk * chunk;
+    size_t                           used;
+    size_t                           packed;
+};
+
+/// A saved allocation position of an arena, created by `apigen_memory_arena_mark`.
+struct apigen_MemoryArenaMark
+{
+    struct apigen_MemoryArenaChunkPosition last;
+    struct apigen_MemoryArenaChunkPosition partial[APIGEN_MEMORY_ARENA_MAX_PARTIAL_CHUNKS]; ///< the partial list, in list order
+    size_t                                 partial_count;
+    size_t                                 chunk_size;
+    struct apigen_MemoryArenaChunk *       previous_mark_chunk;
+    size_t                                 previous_mark_used;
+};
+
+/// Saves the current allocation position of `arena`. Allocations done after this call
+/// can be released with `apigen_memory_arena_rewind`, or kept with `apigen_memory_arena_keep`.
+/// Marks must be rewound or kept in the reverse order they were taken.
+/// Arrays allocated before the mark do not grow in place anymore, as rewinding would cut them.
+struct apigen_MemoryArenaMark apigen_memory_arena_mark(struct apigen_MemoryArena * arena);
+
+/// Releases all allocations done since `mark` was taken. Chunks created after the mark are freed.
+void apigen_memory_arena_rewind(struct apigen_MemoryArena * arena, struct apigen_MemoryArenaMark mark);
+
+/// Keeps all allocations done since `mark` was taken, so the mark cannot be rewound anymore.
+/// Arrays allocated before the mark can grow in place again.
+void apigen_memory_arena_keep(struct apigen_MemoryArena * arena, struct apigen_MemoryArenaMark mark);
+
+/// Releases all allocations of `arena`, but keeps all chunks for further allocations.
+/// All marks taken before are invalidated.
+void apigen_memory_arena_reset(struct apigen_MemoryArena * arena);
+
+/// Takes over all memory of `other`, so allocations made from `other` stay valid until `arena` is deinitialized.
+/// `other` must be a chunked arena and must not be used anymore, like after `apigen_memory_arena_deinit`.
+/// Adopted memory is not released by `apigen_memory_arena_rewind` or `apigen_memory_arena_reset`.
+void apigen_memory_arena_adopt(struct apigen_MemoryArena * arena, struct apigen_MemoryArena * other);
+
+/// Prints a table of the allocation statistics of all memory tags, followed by the chunk usage of `arena`.
+void apigen_memory_render_report(struct apigen_Stream stream, struct apigen_MemoryArena const * arena);
+
+/// Grows the arena allocated array `items` with `*capacity` elements of `item_size` bytes, so it can
+/// hold at least `min_capacity` elements, but at least twice as many as before. The array is extended
+/// in place if it is the most recent allocation of `arena` and no mark was taken since it was allocated,
+/// otherwise it is moved to a new location.
+/// Returns the new array and updates `*capacity`.
+/// Like any allocation, the grown part is released when the arena is rewound to an earlier mark.
+void * apigen_memory_arena_grow_array(struct apigen_MemoryArena * arena, void * items, size_t item_size, size_t alignment, size_t * capacity, size_t min_capacity);
+
+/// Declares `struct _Array`, a growable array of `_Item` that is stored in an arena.
+#define APIGEN_DECLARE_ARRAY(_Array, _Item) \
+    struct _Array                          \
+    {                                      \
+        _Item * items;                     \
+        size_t  count;                     \
+        size_t  capacity;                  \
+    }
+
+/// Defines `_Prefix##_append`, which appends an item to a `struct _Array` declared with `APIGEN_DECLARE_ARRAY`,
+/// and `_Prefix##_append_all`, which appends `count` items with at most one reallocation.
+#define APIGEN_DEFINE_ARRAY_OPERATORS(_Array, _Item, _Prefix)                                                                                                \
+    static inline void _Prefix##_append(struct apigen_MemoryArena * arena, struct _Array * array, _Item item)                                                \
+    {                                                                                                                                                        \
+        APIGEN_NOT_NULL(arena);                                                                                                                              \
+        APIGEN_NOT_NULL(array);                                                                                                                              \
+        if (array->count == array->capacity) {                                                                                                               \
+            array->items = apigen_memory_arena_grow_array(arena, array->items, sizeof(_Item), _Alignof(_Item), &array->capacity, 0);                         \
+        }                                                                                                                                                    \
+        array->items[array->count] = item;                                                                                                                   \
+        array->count += 1;                                                                                                                                   \
+    }                                                                                                                                                        \
+                                                                                                                                                             \
+    static inline void _Prefix##_append_all(struct apigen_MemoryArena * arena, struct _Array * array, _Item const * items, size_t count)                     \
+    {                                                                                                                                                        \
+        APIGEN_NOT_NULL(arena);                                                                                                                              \
+        APIGEN_NOT_NULL(array);                                                                                                                              \
+        if (count == 0) {                                                                                                                                    \
+            return;                                                                                                                                          \
+        }                                                                                                                                                    \
+        if (array->count + count > array->capacity) {                                                                                                        \
+            size_t const min_capacity = array->count + count;                                                                                                \
+            array->items              = apigen_memory_arena_grow_array(arena, array->items, sizeof(_Item), _Alignof(_Item), &array->capacity, min_capacity); \
+        }                                                                                                                                                    \
+        for (size_t i = 0; i < count; i++) {                                                                                                                 \
+            array->items[array->count + i] = items[i];                                                                                                       \
+        }                                                                                                                                                    \
+        array->count += count;                                                                                                                               \
+    }
+
+// string interning:
+
+struct apigen_StringPoolSlot;
+
+/// A set of unique strings, implemented as an open addressing hash table.
+/// Strings returned by the pool can be compared by pointer.
+struct apigen_StringPool
+{
+    struct apigen_MemoryArena *    arena;
+    struct apigen_StringPoolSlot * slots;
+    size_t                         slot_count; ///< always a power of two
+    size_t                         count;
+};
+
+void apigen_string_pool_init(struct apigen_StringPool * pool, struct apigen_MemoryArena * arena);
+
+/// Returns the unique copy of `str`, which lives as long as the arena of `pool`.
+char const * apigen_string_pool_intern(struct apigen_StringPool * pool, char const * str);
+
+/// Returns the unique copy of the first `len` bytes of `str`, which lives as long as the arena of `pool`.
+char const * apigen_string_pool_intern_len(struct apigen_StringPool * pool, char const * str, size_t len);
+
+/// Returns the unique copy of `str`, or `NULL` if `str` was never interned.
+char const * apigen_string_pool_find(struct apigen_StringPool const * pool, char const * str);
+
 // type management:
 
 struct apigen_TypePoolNamedType;
 struct apigen_TypePoolCache;
+struct apigen_TypePoolShard;
 
 struct apigen_TypePool
 {
     struct apigen_MemoryArena * arena;
+    struct apigen_StringPool *  strings; ///< type names are interned here
 
-    struct apigen_TypePoolNamedType * named_types;
-    struct apigen_TypePoolCache *     cache;
+    struct apigen_TypePoolNamedType * named_types;      ///< open addressing hash table keyed by the interned name, created on first registration
+    size_t                            named_type_slots; ///< always a power of two
+    size_t                            named_type_count;
+
+    struct apigen_TypePoolCache ** cache;       ///< open addressing hash table keyed by the structural hash of the interned types
+    size_t                         cache_slots; ///< always a power of two
+    size_t                         cache_count;
+
+    struct apigen_TypePoolShard * shards; ///< if set, types are interned into these locked tables instead of `cache`
 };
 
 /// Looks up a type by name, returns `NULL` if no type named `name` exists.
@@ -287,6 +506,11 @@ bool apigen_register_type(struct apigen_TypePool * pool, struct apigen_Type cons
 /// given. The returned value has same lifetime as the `pool` parameter.
 struct apigen_Type const * apigen_intern_type(struct apigen_TypePool * pool, struct apigen_Type const * type);
 
+/// Moves the intern cache of `pool` into shards which are locked individually, so types can be interned
+/// from several threads. Each thread uses its own copy of `pool` with a private `arena`, all copies
+/// share the named types and the sharded cache. Named types must not be registered while copies are in use.
+void apigen_type_pool_enable_sharing(struct apigen_TypePool * pool);
+
 char const * apigen_type_str(enum apigen_TypeId id);
 
 bool apigen_type_eql(struct apigen_Type const * type1, struct apigen_Type const * type2);
@@ -343,6 +567,25 @@ struct apigen_Document
 
 struct apigen_ParserDeclaration;
 
+APIGEN_DECLARE_ARRAY(apigen_ParserDeclarationArray, struct apigen_ParserDeclaration);
+APIGEN_DECLARE_ARRAY(apigen_ParserLineStartArray, uint32_t);
+
+/// A file read by the parser. Source locations are stored as byte offsets, and are
+/// only translated into lines and columns with `line_starts` when a diagnostic is emitted.
+struct apigen_ParserSource
+{
+    char const *                       file_name;
+    struct apigen_FileId               file_id;
+    bool                               has_file_id; ///< `false` for streams that are not files, like stdin
+    struct apigen_ParserLineStartArray line_starts; ///< byte offset of each line, the first one is always 0
+    uint32_t                           length;      ///< number of bytes scanned for line breaks so far
+};
+
+APIGEN_DECLARE_ARRAY(apigen_ParserSourceArray, struct apigen_ParserSource);
+
+struct apigen_ParserIncludeJob;
+struct apigen_ParserFileMap;
+
 struct apigen_ParserState
 {
     struct apigen_Directory     source_dir;
@@ -350,19 +593,39 @@ struct apigen_ParserState
     struct apigen_Stream        file;
     char const *                file_name;
     struct apigen_MemoryArena * ast_arena;
+    struct apigen_MemoryArena * document_arena; ///< stores the interned identifiers and the analyzed document, `ast_arena` is used if `NULL`
     char const *                line_feed; ///< used for multiline strings
     struct apigen_Diagnostics * diagnostics;
+    struct apigen_StringPool *  strings; ///< interns all identifiers, created by `apigen_parse` in the document arena if `NULL`
+    struct apigen_ParserSourceArray * sources; ///< all files read so far, created by `apigen_parse` if `NULL`
+    struct apigen_ParserFileMap *     source_ids; ///< maps the file ids of `sources` to their index, created by `apigen_parse` if `NULL`
+    uint32_t                    jobs;    ///< number of threads that parse include files and resolve types, everything runs on the calling thread if this is less than 2
+    struct apigen_Directory const * module_cache; ///< optional directory that keeps parsed include files between runs
+    bool                        skip_documentation; ///< doc comments are dropped by the lexer, so all documentation is `NULL`
+
+    struct apigen_ParserIncludeJob * include_job;   ///< set while the file is parsed by an include worker
+    bool                             keep_includes; ///< includes are only recorded as placeholder declarations, used for the module cache
+
+    // lexer state:
+    uint32_t source_index; ///< index of `file` in `sources`
+    uint32_t offset;       ///< byte offset of the next token in `file`
 
     // output data:
-    struct apigen_ParserDeclaration * top_level_declarations;
+    struct apigen_ParserDeclarationArray top_level_declarations;
 };
 
 /// Parses `state->file` into an AST stored in
 /// `state->top_level_declarations`.
+/// With `state->jobs` set to 2 or more, included files are parsed on a pool of
+/// worker threads and their declarations are spliced in at the include site.
 bool apigen_parse(struct apigen_ParserState * state);
 
 /// Analyzes `state->top_level_declarations` into concrete
 /// types and declarations
+/// With `state->jobs` set to 2 or more, the bodies of structs, unions and enums are
+/// resolved on a pool of worker threads. The document is the same as with a single thread.
+/// The document is allocated from `state->document_arena` and only refers to memory of that
+/// arena and of `state->strings`, so `state->ast_arena` can be released afterwards.
 bool apigen_analyze(struct apigen_ParserState * state, struct apigen_Document * out_document);
 
 // diagnostics:
@@ -397,6 +660,7 @@ _Mac(apigen_error_constexpr_out_of_range,   1014, "The value assigned to constan
 _Mac(apigen_error_constexpr_illegal_type,   1015, "The constant '%s' is declared with an unsupported type")                                                       \
 _Mac(apigen_error_invalid_include_path,     1016, "The include path '%s' is not valid.")                                                                          \
 _Mac(apigen_error_missing_include_file,     1017, "The include path '%s' does not exist.")                                                                        \
+_Mac(apigen_error_cyclic_type_alias,        1018, "The type '%s' depends on itself")                                                                              \
 _Mac(apigen_error_internal,                 5999, "Internal compiler error")                                                                                      \
                                                                                                                                                                   \
 _Mac(apigen_warning_enum_int_undefined,     6000, "Chosen enum backing type %s has no well-defined range. Generated code may not be portable")                    \
@@ -413,22 +677,33 @@ enum apigen_DiagnosticCode
 
 struct apigen_DiagnosticItem;
 
+APIGEN_DECLARE_ARRAY(apigen_DiagnosticItemArray, struct apigen_DiagnosticItem);
+
 #define APIGEN_DIAGNOSTIC_FLAG_ERROR (1U << 0)
 #define APIGEN_DIAGNOSTIC_FLAG_WARN  (1U << 1)
 #define APIGEN_DIAGNOSTIC_FLAG_NOTE  (1U << 2)
 
 struct apigen_Diagnostics
 {
-    struct apigen_MemoryArena *    arena;
-    size_t                         item_count;
-    struct apigen_DiagnosticItem * items;
-    uint32_t                       flags;
+    struct apigen_MemoryArena *       arena;
+    struct apigen_DiagnosticItemArray items; ///< in order of emission
+    uint32_t                          flags;
 };
 
 void apigen_diagnostics_init(struct apigen_Diagnostics * diags, struct apigen_MemoryArena * arena);
 void apigen_diagnostics_deinit(struct apigen_Diagnostics * diags);
 
+/// Appends copies of all diagnostics in `other` to `diags`, so `other` can be released afterwards.
+void apigen_diagnostics_merge(struct apigen_Diagnostics * diags, struct apigen_Diagnostics const * other);
+
+/// Appends copies of `count` diagnostics of `other`, starting at index `first`, to `diags`.
+/// If `file_name` is not `NULL`, the copies are reported in that file instead of their original one.
+void apigen_diagnostics_merge_range(struct apigen_Diagnostics * diags, struct apigen_Diagnostics const * other, size_t first, size_t count, char const * file_name);
+
 bool apigen_diagnostics_remove_one(struct apigen_Diagnostics * diags, enum apigen_DiagnosticCode code);
+
+/// Like `apigen_diagnostics_remove_one`, but only removes a diagnostic in `file_name`, unless it is `NULL`.
+bool apigen_diagnostics_remove_one_in(struct apigen_Diagnostics * diags, enum apigen_DiagnosticCode code, char const * file_name);
 bool apigen_diagnostics_has_any(struct apigen_Diagnostics const * diags);
 
 void apigen_diagnostics_emit(
@@ -1,8 +1,10 @@
 #include "apigen.h"
 #include "parser/parser.h"
 
+#include <pthread.h>
 #include <stdio.h>
-#include <setjmp.h>
+#include <stdalign.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <limits.h>
 #include <inttypes.h>
@@ -14,13 +16,17 @@ static void emit_diagnostics(
     enum apigen_DiagnosticCode code,
     ...)
 {
+    char const * file_name;
+    uint32_t     line, column;
+    apigen_parser_resolve_location(parser, location, &file_name, &line, &column);
+
     va_list list;
     va_start(list, code);
     apigen_diagnostics_vemit(
         parser->diagnostics,
-        parser->file_name,
-        location.first_line,
-        location.first_column,
+        file_name,
+        line,
+        column,
         code,
         list
     );
@@ -159,6 +165,15 @@ static bool is_stringly_type(struct apigen_Type type, size_t len)
     }
 }
 
+/// Returns `value` with its string copied into `arena`, so it does not refer to the AST anymore.
+static struct apigen_Value copy_value(struct apigen_MemoryArena * arena, struct apigen_Value value)
+{
+    if(value.type == apigen_value_str) {
+        value.value_str = apigen_memory_arena_dupestr(arena, value.value_str);
+    }
+    return value;
+}
+
 struct ValueRange { int64_t min; uint64_t max; };
 
 static bool range_is_valid(struct ValueRange range)
@@ -298,12 +313,6 @@ static enum apigen_TypeId mapPtrType(enum apigen_ParserTypeId src_type_id, bool
     }
 }
 
-enum ResolveStateResponse
-{
-    RESOLVE_FAILED_GENERIC = 3,
-    RESOLVE_MISSING_SYMBOL = 10,
-};
-
 struct GlobalResolutionQueueNode
 {
     struct GlobalResolutionQueueNode * next;
@@ -363,37 +372,80 @@ static struct GlobalResolutionQueueNode * gsq_pop(struct GlobalResolutionQueue *
     }
 }
 
-struct ResolveState
+struct MemberIndexSlot
 {
-    struct apigen_ParserState * parser;
-    struct apigen_TypePool * pool;
+    uint64_t key;
+    size_t   index; ///< index of the member + 1, 0 marks an empty slot
+};
 
-    bool emit_resolve_errors;
-    jmp_buf generic_error_retpoint;
+/// Open addressing hash table that maps a key to the index of the first member that used it.
+/// Finds duplicate member names and enum values in linear time instead of comparing each
+/// member against all previous ones.
+struct MemberIndexMap
+{
+    struct MemberIndexSlot * slots;
+    size_t                   slot_count; ///< always a power of two
+};
 
-    char nested_type_name_hint_buf[1024];
-    size_t nested_type_name_hint_len;
+static struct MemberIndexMap member_index_map_init(struct apigen_MemoryArena * arena, size_t member_count)
+{
+    APIGEN_NOT_NULL(arena);
 
-    struct GlobalResolutionQueue * global_resolver_queue;
-};
+    // keep the load factor at or below 1/2:
+    size_t slot_count = 16;
+    while(slot_count < 2 * member_count) {
+        slot_count *= 2;
+    }
+
+    struct MemberIndexSlot * const slots = apigen_memory_arena_alloc_aligned(arena, slot_count * sizeof(struct MemberIndexSlot), alignof(struct MemberIndexSlot));
+    memset(slots, 0, slot_count * sizeof(struct MemberIndexSlot));
 
-static void APIGEN_NORETURN handle_resolve_error(struct ResolveState * state, struct apigen_ParserType const * const type)
+    return (struct MemberIndexMap) {
+        .slots      = slots,
+        .slot_count = slot_count,
+    };
+}
+
+/// Returns the index of the first member inserted with `key`, or inserts `index` for `key`
+/// and returns `SIZE_MAX` if the key is new.
+static size_t member_index_map_insert(struct MemberIndexMap * map, uint64_t key, size_t index)
 {
-    APIGEN_NOT_NULL(state);
-    APIGEN_NOT_NULL(type);
-    APIGEN_ASSERT(type->type == apigen_parser_type_named);
-    if(state->emit_resolve_errors) {
-        emit_diagnostics(state->parser, type->location, apigen_error_undeclared_identifier, type->named_data);
+    APIGEN_NOT_NULL(map);
+
+    size_t const mask = map->slot_count - 1;
+
+    size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    while(map->slots[slot].index != 0) {
+        if(map->slots[slot].key == key) {
+            return map->slots[slot].index - 1;
+        }
+        slot = (slot + 1) & mask;
     }
-    longjmp(state->generic_error_retpoint, RESOLVE_MISSING_SYMBOL);
+
+    map->slots[slot] = (struct MemberIndexSlot) {
+        .key   = key,
+        .index = index + 1,
+    };
+    return SIZE_MAX;
 }
 
-static void APIGEN_NORETURN exit_type_resolution(struct ResolveState * state)
+/// Identifiers are interned, so their address identifies the name.
+static uint64_t member_name_key(char const * identifier)
 {
-    APIGEN_NOT_NULL(state);
-    longjmp(state->generic_error_retpoint, RESOLVE_FAILED_GENERIC);
+    return (uint64_t)(uintptr_t)identifier;
 }
 
+struct ResolveState
+{
+    struct apigen_ParserState * parser;
+    struct apigen_TypePool * pool;
+
+    char nested_type_name_hint_buf[1024];
+    size_t nested_type_name_hint_len;
+
+    struct GlobalResolutionQueue * global_resolver_queue;
+};
+
 static char const * unique_type_suffix(enum apigen_ParserTypeId id)
 {
     switch(id) {
@@ -407,7 +459,7 @@ static char const * unique_type_suffix(enum apigen_ParserTypeId id)
 
 static void resolver_notify_unique_type(struct ResolveState * resolver, struct apigen_Type * unique_type, struct apigen_ParserType const * src_type)
 {
-    struct GlobalResolutionQueueNode * node = apigen_memory_arena_alloc(resolver->global_resolver_queue->arena, sizeof(struct GlobalResolutionQueueNode));
+    struct GlobalResolutionQueueNode * node = apigen_memory_arena_alloc_aligned(resolver->global_resolver_queue->arena, sizeof(struct GlobalResolutionQueueNode), alignof(struct GlobalResolutionQueueNode));
     *node = (struct GlobalResolutionQueueNode) {
         .next = NULL,
         .dst_type = unique_type,
@@ -426,7 +478,7 @@ static struct apigen_Type const * resolve_type_inner(struct ResolveState * resol
         case apigen_parser_type_named: {
             struct apigen_Type const * const named_type = apigen_lookup_type(resolver->pool, src_type->named_data);
             if(named_type == NULL) {
-                handle_resolve_error(resolver, src_type);
+                emit_diagnostics(resolver->parser, src_type->location, apigen_error_undeclared_identifier, src_type->named_data);
             }
             return named_type;
         }
@@ -465,7 +517,7 @@ static struct apigen_Type const * resolve_type_inner(struct ResolveState * resol
                     src_type->location,
                     apigen_error_array_size_not_uint
                 );
-                exit_type_resolution(resolver);
+                return NULL;
             }
 
             struct apigen_Array const extra_data = (struct apigen_Array) {
@@ -484,48 +536,38 @@ static struct apigen_Type const * resolve_type_inner(struct ResolveState * resol
 
         case apigen_parser_type_function: {
             struct apigen_Type const * const return_type = resolve_type_inner(resolver, src_type->function_data.return_type);
-
-            size_t parameter_count = 0;
-            {
-                struct apigen_ParserField const * param_iter = src_type->function_data.parameters;
-                while(param_iter != NULL) {
-                    parameter_count += 1;
-                    param_iter = param_iter->next;
-                }
+            if(return_type == NULL) {
+                return NULL;
             }
 
-            struct apigen_NamedValue * const parameters = apigen_memory_arena_alloc(resolver->pool->arena, parameter_count * sizeof(struct apigen_Type));
+            size_t const parameter_count = src_type->function_data.parameters.count;
+
+            struct apigen_NamedValue * const parameters = apigen_memory_arena_alloc_aligned(resolver->pool->arena, parameter_count * sizeof(struct apigen_NamedValue), alignof(struct apigen_NamedValue));
             {
                 bool duplicate_param = false;
 
-                size_t index = 0;
-                struct apigen_ParserField const * param_iter = src_type->function_data.parameters;
-                while(param_iter != NULL) {
+                struct MemberIndexMap parameter_names = member_index_map_init(resolver->global_resolver_queue->arena, parameter_count);
 
-                    for(size_t i = 0; i < index; i++) {
-                        if(apigen_streq(parameters[i].name, param_iter->identifier)) {
-                            emit_diagnostics(resolver->parser, param_iter->location, apigen_error_duplicate_parameter, param_iter->identifier);
-                            duplicate_param = true;
-                            break;
-                        }
+                for(size_t index = 0; index < parameter_count; index++) {
+                    struct apigen_ParserField const * const param_iter = &src_type->function_data.parameters.items[index];
+
+                    if(member_index_map_insert(&parameter_names, member_name_key(param_iter->identifier), index) != SIZE_MAX) {
+                        emit_diagnostics(resolver->parser, param_iter->location, apigen_error_duplicate_parameter, param_iter->identifier);
+                        duplicate_param = true;
                     }
 
                     parameters[index] = (struct apigen_NamedValue) {
                         .documentation = apigen_memory_arena_dupestr(resolver->pool->arena, param_iter->documentation),
-                        .name          = apigen_memory_arena_dupestr(resolver->pool->arena, param_iter->identifier),
+                        .name          = param_iter->identifier,
                         .type          = resolve_type_inner(resolver, &param_iter->type),
                     };
                     if(parameters[index].type == NULL) {
                         return NULL;
                     }
-
-                    index += 1;
-                    param_iter = param_iter->next;
                 }
-                APIGEN_ASSERT(parameter_count == index);
 
                 if(duplicate_param) {
-                    exit_type_resolution(resolver);
+                    return NULL;
                 }
             }
 
@@ -552,12 +594,12 @@ static struct apigen_Type const * resolve_type_inner(struct ResolveState * resol
 
             size_t const total_len = strlen(resolver->nested_type_name_hint_buf) + strlen(type_name_suffix) + 2;
 
-            char * const nested_type_name = apigen_memory_arena_alloc(resolver->pool->arena, total_len);
+            char * const nested_type_name = apigen_memory_arena_alloc_packed(resolver->pool->arena, total_len);
             strcpy(nested_type_name, resolver->nested_type_name_hint_buf);
             strcat(nested_type_name, "_");
             strcat(nested_type_name, type_name_suffix);
 
-            struct apigen_Type * const unique_type = apigen_memory_arena_alloc(resolver->pool->arena, sizeof(struct apigen_Type));
+            struct apigen_Type * const unique_type = apigen_memory_arena_alloc_aligned(resolver->pool->arena, sizeof(struct apigen_Type), alignof(struct apigen_Type));
             *unique_type = (struct apigen_Type) {
                 .name = nested_type_name,
                 .id = map_unique_parser_type_id(src_type->type),
@@ -574,14 +616,14 @@ static struct apigen_Type const * resolve_type_inner(struct ResolveState * resol
     return NULL;
 }
 
+/// Resolves `src_type` into an interned type of `pool`. Returns `NULL` after emitting
+/// the diagnostics if the type could not be resolved.
 static struct apigen_Type const * resolve_type(
         struct apigen_ParserState * const parser,
         struct apigen_TypePool * const pool,
         struct GlobalResolutionQueue * resolve_queue,
-        bool emit_resolve_errors,
         char const * container_name,
-        struct apigen_ParserType const * src_type,
-        bool * non_resolve_error // will be set to `true` if a non-resolution error occurred
+        struct apigen_ParserType const * src_type
     )
 {
     APIGEN_NOT_NULL(parser);
@@ -592,7 +634,6 @@ static struct apigen_Type const * resolve_type(
     struct ResolveState resolve_state = {
         .parser = parser,
         .pool = pool,
-        .emit_resolve_errors = emit_resolve_errors,
         .global_resolver_queue = resolve_queue,
 
         .nested_type_name_hint_buf = {0},
@@ -603,26 +644,7 @@ static struct apigen_Type const * resolve_type(
     memcpy(resolve_state.nested_type_name_hint_buf, container_name, resolve_state.nested_type_name_hint_len);
     resolve_state.nested_type_name_hint_buf[resolve_state.nested_type_name_hint_len] = 0;
 
-    int const response = setjmp(resolve_state.generic_error_retpoint);
-    if(response == 0)
-    {
-        struct apigen_Type const * const resolved_type = resolve_type_inner(&resolve_state, src_type);
-        APIGEN_NOT_NULL(resolved_type);
-        return resolved_type;
-    }
-    else if(response == RESOLVE_FAILED_GENERIC)
-    {
-        if(non_resolve_error) *non_resolve_error = true;
-        return NULL;
-    }
-    else if(response == RESOLVE_MISSING_SYMBOL)
-    {
-        return NULL;
-    }
-    else
-    {
-        apigen_panic("Invalid response from setjmp, please validate your code!");
-    }
+    return resolve_type_inner(&resolve_state, src_type);
 }
 
 static bool analyze_struct_type(struct apigen_ParserState * const state, struct apigen_TypePool * const type_pool, struct GlobalResolutionQueue * const resolve_queue, struct apigen_Type * const dst_type, struct apigen_ParserType const * const src_type)
@@ -634,47 +656,35 @@ static bool analyze_struct_type(struct apigen_ParserState * const state, struct
 
     bool ok = true;
 
-    size_t field_count = 0;
-    {
-        struct apigen_ParserField const * field = src_type->union_struct_fields;
-        while(field != NULL) {
-            field_count += 1;
-            field = field->next;
-        }
-    }
+    size_t const field_count = src_type->union_struct_fields.count;
 
-    struct apigen_NamedValue * const fields = apigen_memory_arena_alloc(type_pool->arena, field_count * sizeof(struct apigen_NamedValue));
+    struct apigen_NamedValue * const fields = apigen_memory_arena_alloc_aligned(type_pool->arena, field_count * sizeof(struct apigen_NamedValue), alignof(struct apigen_NamedValue));
 
     if(field_count > 0)
     {
-        size_t index = 0;
-        struct apigen_ParserField const * src_field = src_type->union_struct_fields;
-        while(src_field != NULL) {
+        struct MemberIndexMap field_names = member_index_map_init(resolve_queue->arena, field_count);
+
+        for(size_t index = 0; index < field_count; index++) {
+            struct apigen_ParserField const * const src_field = &src_type->union_struct_fields.items[index];
+
             char type_hint_buffer[1024];
             snprintf(type_hint_buffer, sizeof(type_hint_buffer)-1, "%s_%s", dst_type->name, src_field->identifier);
 
             struct apigen_NamedValue * const dst_field = &fields[index];
             *dst_field = (struct apigen_NamedValue) {
                 .documentation = apigen_memory_arena_dupestr(type_pool->arena, src_field->documentation),
-                .name          = apigen_memory_arena_dupestr(type_pool->arena, src_field->identifier),
-                .type          = resolve_type(state, type_pool, resolve_queue, true, type_hint_buffer, &src_field->type, NULL),
+                .name          = src_field->identifier,
+                .type          = resolve_type(state, type_pool, resolve_queue, type_hint_buffer, &src_field->type),
             };
 
-            for(size_t i = 0; i < index; i++)
-            {
-                if(apigen_streq(dst_field->name, fields[i].name)) {
-                    emit_diagnostics(state, src_field->location, apigen_error_duplicate_field, dst_field->name);
-                    break;
-                }
+            if(member_index_map_insert(&field_names, member_name_key(dst_field->name), index) != SIZE_MAX) {
+                emit_diagnostics(state, src_field->location, apigen_error_duplicate_field, dst_field->name);
             }
 
             if(dst_field->type == NULL)
             {
                 ok = false;
             }
-
-            index += 1;
-            src_field = src_field->next;
         }
     }
     else
@@ -682,7 +692,7 @@ static bool analyze_struct_type(struct apigen_ParserState * const state, struct
         emit_diagnostics(state, src_type->location, apigen_warning_struct_empty);
     }
 
-    struct apigen_UnionOrStruct * const struct_or_union = apigen_memory_arena_alloc(type_pool->arena, sizeof(struct apigen_UnionOrStruct));
+    struct apigen_UnionOrStruct * const struct_or_union = apigen_memory_arena_alloc_aligned(type_pool->arena, sizeof(struct apigen_UnionOrStruct), alignof(struct apigen_UnionOrStruct));
     *struct_or_union = (struct apigen_UnionOrStruct) {
         .field_count = field_count,
         .fields      = fields,
@@ -706,7 +716,7 @@ static bool analyze_enum_type(struct apigen_ParserState * const state, struct ap
 
     struct apigen_Type const * underlying_type = NULL;
     if(src_type->enum_data.underlying_type != NULL) {
-        underlying_type = resolve_type(state, type_pool, resolve_queue, true, dst_type->name, src_type->enum_data.underlying_type, NULL);
+        underlying_type = resolve_type(state, type_pool, resolve_queue, dst_type->name, src_type->enum_data.underlying_type);
         if(underlying_type != NULL) {
             if(is_integer_type(*underlying_type)) {
                 int_range = get_integer_range(underlying_type->id);
@@ -727,21 +737,12 @@ static bool analyze_enum_type(struct apigen_ParserState * const state, struct ap
         }
     }
 
-    size_t items_count = 0;
-    {
-        struct apigen_ParserEnumItem const * iter = src_type->enum_data.items;
-        while(iter != NULL) {
-            items_count += 1;
-            iter = iter->next;
-        }
-    }
+    size_t const items_count = src_type->enum_data.items.count;
 
     if(items_count > 0)
     {
-        struct apigen_EnumItem * const items = apigen_memory_arena_alloc(type_pool->arena, items_count * sizeof(struct apigen_EnumItem));
+        struct apigen_EnumItem * const items = apigen_memory_arena_alloc_aligned(type_pool->arena, items_count * sizeof(struct apigen_EnumItem), alignof(struct apigen_EnumItem));
         {
-            size_t index = 0;
-            struct apigen_ParserEnumItem const * iter = src_type->enum_data.items;
             union {
                 uint64_t uval;
                 int64_t ival;
@@ -751,14 +752,14 @@ static bool analyze_enum_type(struct apigen_ParserState * const state, struct ap
 
             struct ValueRange actual_range = INIT_LIMIT_RANGE;
 
-            while(iter != NULL) {
+            struct MemberIndexMap item_names  = member_index_map_init(resolve_queue->arena, items_count);
+            struct MemberIndexMap item_values = member_index_map_init(resolve_queue->arena, items_count);
 
-                for(size_t i = 0; i < index; i++)
-                {
-                    if(apigen_streq(items[i].name, iter->identifier)) {
-                        emit_diagnostics(state, iter->location, apigen_error_duplicate_enum_item, iter->identifier);
-                        break;
-                    }
+            for(size_t index = 0; index < items_count; index++) {
+                struct apigen_ParserEnumItem const * const iter = &src_type->enum_data.items.items[index];
+
+                if(member_index_map_insert(&item_names, member_name_key(iter->identifier), index) != SIZE_MAX) {
+                    emit_diagnostics(state, iter->location, apigen_error_duplicate_enum_item, iter->identifier);
                 }
 
                 bool skip_range_check = false;
@@ -826,18 +827,17 @@ static bool analyze_enum_type(struct apigen_ParserState * const state, struct ap
                     }
                 }
 
-                for(size_t i = 0; i < index; i++)
                 {
                     // we can safely compare uval as we're comparing for "bit pattern equality"
-                    if(items[i].uvalue == current_value.uval) {
+                    size_t const previous = member_index_map_insert(&item_values, current_value.uval, index);
+                    if(previous != SIZE_MAX) {
                         char buffer[256];
                         if(value_is_signed) {
                             (void)snprintf(buffer, sizeof buffer, "%"PRId64, current_value.ival);
                         } else {
                             (void)snprintf(buffer, sizeof buffer, "%"PRIu64, current_value.uval);
                         }
-                        emit_diagnostics(state, iter->location, apigen_error_duplicate_enum_value, iter->identifier, buffer, items[i].name);
-                        break;
+                        emit_diagnostics(state, iter->location, apigen_error_duplicate_enum_value, iter->identifier, buffer, items[previous].name);
                     }
                 }
 
@@ -845,7 +845,7 @@ static bool analyze_enum_type(struct apigen_ParserState * const state, struct ap
                 if(value_is_signed) {
                     *item = (struct apigen_EnumItem) {
                         .documentation = apigen_memory_arena_dupestr(type_pool->arena, iter->documentation),
-                        .name          = apigen_memory_arena_dupestr(type_pool->arena, iter->identifier),
+                        .name          = iter->identifier,
                         .ivalue        = current_value.ival,
                     };
                     insert_ival_into_range(&actual_range, current_value.ival);
@@ -854,17 +854,14 @@ static bool analyze_enum_type(struct apigen_ParserState * const state, struct ap
                 else {
                     *item = (struct apigen_EnumItem) {
                         .documentation = apigen_memory_arena_dupestr(type_pool->arena, iter->documentation),
-                        .name          = apigen_memory_arena_dupestr(type_pool->arena, iter->identifier),
+                        .name          = iter->identifier,
                         .uvalue        = current_value.uval,
                     };
                     insert_uval_into_range(&actual_range, current_value.uval);
                     current_value.uval += 1;
 
                 }
-                iter = iter->next;
-                index += 1;
             }
-            APIGEN_ASSERT(index == items_count);
 
             if(underlying_type == NULL)
             {
@@ -908,7 +905,7 @@ static bool analyze_enum_type(struct apigen_ParserState * const state, struct ap
         //     }
         // }
 
-        struct apigen_Enum * enum_extra = apigen_memory_arena_alloc(type_pool->arena, sizeof(struct apigen_Enum));
+        struct apigen_Enum * enum_extra = apigen_memory_arena_alloc_aligned(type_pool->arena, sizeof(struct apigen_Enum), alignof(struct apigen_Enum));
         *enum_extra = (struct apigen_Enum) {
             .underlying_type = underlying_type,
             .item_count = items_count,
@@ -955,14 +952,670 @@ static bool resolve_unique_type(
     }
 }
 
-bool apigen_analyze(struct apigen_ParserState * const state, struct apigen_Document * const out_document)
+APIGEN_DECLARE_ARRAY(DeclarationPtrArray, struct apigen_ParserDeclaration *);
+APIGEN_DEFINE_ARRAY_OPERATORS(DeclarationPtrArray, struct apigen_ParserDeclaration *, declaration_ptr_array)
+
+/// The top level declarations sorted by kind in a single pass, so each phase only visits
+/// the declarations it processes. All buckets keep the declaration order.
+struct DeclarationBuckets
 {
+    struct DeclarationPtrArray types;        ///< all type declarations
+    struct DeclarationPtrArray unique_types; ///< declarations of structs, unions, enums and opaque types
+    struct DeclarationPtrArray type_aliases; ///< all other type declarations
+    struct DeclarationPtrArray variables;    ///< const and var declarations
+    struct DeclarationPtrArray functions;
+    struct DeclarationPtrArray constants;    ///< constexpr declarations
+};
+
+static void sort_declarations_into_buckets(struct apigen_ParserDeclarationArray declarations, struct apigen_MemoryArena * arena, struct DeclarationBuckets * buckets)
+{
+    APIGEN_NOT_NULL(arena);
+    APIGEN_NOT_NULL(buckets);
+
+    *buckets = (struct DeclarationBuckets) { 0 };
+
+    for(size_t decl_index = 0; decl_index < declarations.count; decl_index++) {
+        struct apigen_ParserDeclaration * const decl = &declarations.items[decl_index];
+
+        switch(decl->kind) {
+            case apigen_parser_const_declaration:
+            case apigen_parser_var_declaration:
+                declaration_ptr_array_append(arena, &buckets->variables, decl);
+                break;
+
+            case apigen_parser_constexpr_declaration:
+                declaration_ptr_array_append(arena, &buckets->constants, decl);
+                break;
+
+            case apigen_parser_fn_declaration:
+                declaration_ptr_array_append(arena, &buckets->functions, decl);
+                break;
+
+            case apigen_parser_type_declaration:
+                declaration_ptr_array_append(arena, &buckets->types, decl);
+                if(is_unique_type(decl->type.type)) {
+                    declaration_ptr_array_append(arena, &buckets->unique_types, decl);
+                }
+                else {
+                    declaration_ptr_array_append(arena, &buckets->type_aliases, decl);
+                }
+                break;
+
+            case apigen_parser_include_declaration:
+                apigen_panic("Document contains unresolved include paths!");
+        }
+    }
+}
+
+/// Resolution state of a type alias in the dependency graph of phase 3.
+enum AliasState
+{
+    ALIAS_PENDING = 0,
+    ALIAS_RESOLVED,
+    ALIAS_FAILED,  ///< an error was emitted while resolving the alias or one of its dependencies
+    ALIAS_BLOCKED, ///< the alias depends on an undeclared identifier or on itself
+};
+
+struct AliasNode
+{
+    struct apigen_ParserDeclaration * decl;
+
+    size_t first_dependency; ///< index into `AliasGraph.dependencies`
+    size_t dependency_count;
+    bool   has_undeclared_dependency;
+
+    // bookkeeping of Tarjan's strongly connected components algorithm:
+    size_t dfs_index;       ///< order of discovery, starting at 1. 0 means not yet visited
+    size_t lowlink;
+    size_t next_dependency; ///< the next dependency to visit by the depth-first search
+    bool   on_stack;
+
+    enum AliasState state;
+};
+
+APIGEN_DECLARE_ARRAY(AliasIndexArray, size_t);
+APIGEN_DEFINE_ARRAY_OPERATORS(AliasIndexArray, size_t, alias_index_array)
+
+struct AliasGraph
+{
+    struct apigen_ParserState *    parser;
+    struct apigen_MemoryArena *    arena;
+    struct apigen_TypePool *       pool;
+    struct GlobalResolutionQueue * resolve_queue;
+
+    struct AliasNode * nodes; ///< in declaration order
+    size_t             node_count;
+
+    size_t * name_slots;      ///< open addressing hash table keyed by the interned alias name, stores the node index + 1
+    size_t   name_slot_count; ///< always a power of two
+
+    struct AliasIndexArray dependencies; ///< edges of all nodes, each node owns a contiguous range
+    struct AliasIndexArray component_stack;
+    struct AliasIndexArray visit_stack;
+    size_t                 next_dfs_index;
+    size_t                 blocked_count;
+};
+
+/// Returns the slot of the alias named `interned_name`, or the empty slot where it belongs.
+static size_t * find_alias_slot(struct AliasGraph const * graph, char const * interned_name)
+{
+    size_t const mask = graph->name_slot_count - 1;
+
+    // identifiers are interned, so the address of the name is a sufficient key:
+    size_t index = (size_t)(((uint64_t)(uintptr_t)interned_name * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    while(graph->name_slots[index] != 0 && graph->nodes[graph->name_slots[index] - 1].decl->identifier != interned_name) {
+        index = (index + 1) & mask;
+    }
+    return &graph->name_slots[index];
+}
+
+/// Appends an edge for each alias referenced by `type`. Names that are neither an alias nor
+/// already published in the type pool are reported as undeclared.
+static void collect_alias_dependencies(struct AliasGraph * graph, size_t node_index, struct apigen_ParserType const * type)
+{
+    APIGEN_NOT_NULL(graph);
+    APIGEN_NOT_NULL(type);
+
+    switch(type->type) {
+        case apigen_parser_type_named: {
+            if(apigen_lookup_type(graph->pool, type->named_data) != NULL) {
+                return;
+            }
+            size_t const slot = *find_alias_slot(graph, type->named_data);
+            if(slot != 0) {
+                alias_index_array_append(graph->arena, &graph->dependencies, slot - 1);
+            }
+            else {
+                emit_diagnostics(graph->parser, type->location, apigen_error_undeclared_identifier, type->named_data);
+                graph->nodes[node_index].has_undeclared_dependency = true;
+            }
+            return;
+        }
+
+        case apigen_parser_type_ptr_to_one:
+        case apigen_parser_type_ptr_to_many:
+        case apigen_parser_type_ptr_to_many_sentinelled:
+            collect_alias_dependencies(graph, node_index, type->pointer_data.underlying_type);
+            return;
+
+        case apigen_parser_type_array:
+            collect_alias_dependencies(graph, node_index, type->array_data.underlying_type);
+            return;
+
+        case apigen_parser_type_function:
+            collect_alias_dependencies(graph, node_index, type->function_data.return_type);
+            for(size_t i = 0; i < type->function_data.parameters.count; i++) {
+                collect_alias_dependencies(graph, node_index, &type->function_data.parameters.items[i].type);
+            }
+            return;
+
+        case apigen_parser_type_enum:
+        case apigen_parser_type_struct:
+        case apigen_parser_type_union:
+        case apigen_parser_type_opaque:
+            // anonymous unique types are resolved after all aliases are published
+            return;
+    }
+}
+
+/// Resolves the alias of `node` and publishes it into the type pool.
+static enum AliasState publish_alias(struct AliasGraph * graph, struct AliasNode * node)
+{
+    struct apigen_ParserDeclaration * const decl = node->decl;
+
+    struct apigen_Type const * const resolved_type = resolve_type(graph->parser, graph->pool, graph->resolve_queue, decl->identifier, &decl->type);
+    if(resolved_type == NULL) {
+        return ALIAS_FAILED;
+    }
+
+    struct apigen_Type * const alias_type = apigen_memory_arena_alloc_aligned(graph->pool->arena, sizeof(struct apigen_Type), alignof(struct apigen_Type));
+    *alias_type = (struct apigen_Type) {
+        .name = decl->identifier,
+        .extra = resolved_type,
+        .is_anonymous = false,
+        .id = apigen_typeid_alias,
+    };
+
+    if(!apigen_register_type(graph->pool, alias_type, decl->identifier)) {
+        emit_diagnostics(graph->parser, decl->location, apigen_error_duplicate_symbol, decl->identifier);
+        return ALIAS_FAILED;
+    }
+
+    decl->associated_type = alias_type;
+    return ALIAS_RESOLVED;
+}
+
+/// Called when Tarjan's algorithm has found a complete strongly connected component. All
+/// components the aliases depend on are already finished, so each alias is resolved exactly once.
+static void finish_alias_component(struct AliasGraph * graph, size_t component_start)
+{
+    size_t const * const members      = &graph->component_stack.items[component_start];
+    size_t const         member_count = graph->component_stack.count - component_start;
+
+    struct AliasNode * const first = &graph->nodes[members[0]];
+
+    bool is_cyclic = (member_count > 1);
+    for(size_t i = 0; i < first->dependency_count; i++) {
+        if(graph->dependencies.items[first->first_dependency + i] == members[0]) {
+            is_cyclic = true;
+        }
+    }
+
+    if(is_cyclic) {
+        for(size_t i = 0; i < member_count; i++) {
+            struct AliasNode * const node = &graph->nodes[members[i]];
+            emit_diagnostics(graph->parser, node->decl->location, apigen_error_cyclic_type_alias, node->decl->identifier);
+            node->on_stack = false;
+            node->state = ALIAS_BLOCKED;
+        }
+        graph->blocked_count += member_count;
+    }
+    else {
+        APIGEN_ASSERT(member_count == 1);
+
+        enum AliasState state = first->has_undeclared_dependency ? ALIAS_BLOCKED : ALIAS_PENDING;
+        for(size_t i = 0; (state != ALIAS_BLOCKED) && (i < first->dependency_count); i++) {
+            enum AliasState const dependency_state = graph->nodes[graph->dependencies.items[first->first_dependency + i]].state;
+            APIGEN_ASSERT(dependency_state != ALIAS_PENDING);
+            if(dependency_state != ALIAS_RESOLVED) {
+                state = dependency_state;
+            }
+        }
+
+        if(state == ALIAS_PENDING) {
+            state = publish_alias(graph, first);
+        }
+        else if(state == ALIAS_BLOCKED) {
+            graph->blocked_count += 1;
+        }
+
+        first->on_stack = false;
+        first->state = state;
+    }
+
+    graph->component_stack.count = component_start;
+}
+
+static void enter_alias_node(struct AliasGraph * graph, size_t node_index)
+{
+    struct AliasNode * const node = &graph->nodes[node_index];
+    graph->next_dfs_index += 1;
+    node->dfs_index = graph->next_dfs_index;
+    node->lowlink   = graph->next_dfs_index;
+    node->on_stack  = true;
+    alias_index_array_append(graph->arena, &graph->component_stack, node_index);
+    alias_index_array_append(graph->arena, &graph->visit_stack, node_index);
+}
+
+/// Iterative version of Tarjan's algorithm, so long alias chains cannot exhaust the call stack.
+static void visit_alias_node(struct AliasGraph * graph, size_t root_index)
+{
+    enter_alias_node(graph, root_index);
+
+    while(graph->visit_stack.count > 0) {
+        size_t const node_index = graph->visit_stack.items[graph->visit_stack.count - 1];
+        struct AliasNode * const node = &graph->nodes[node_index];
+
+        if(node->next_dependency < node->dependency_count) {
+            size_t const dependency_index = graph->dependencies.items[node->first_dependency + node->next_dependency];
+            struct AliasNode const * const dependency = &graph->nodes[dependency_index];
+            node->next_dependency += 1;
+
+            if(dependency->dfs_index == 0) {
+                enter_alias_node(graph, dependency_index);
+            }
+            else if(dependency->on_stack && (dependency->dfs_index < node->lowlink)) {
+                node->lowlink = dependency->dfs_index;
+            }
+            continue;
+        }
+
+        graph->visit_stack.count -= 1;
+        if(graph->visit_stack.count > 0) {
+            struct AliasNode * const parent = &graph->nodes[graph->visit_stack.items[graph->visit_stack.count - 1]];
+            if(node->lowlink < parent->lowlink) {
+                parent->lowlink = node->lowlink;
+            }
+        }
+
+        if(node->lowlink == node->dfs_index) {
+            size_t component_start = graph->component_stack.count;
+            do {
+                component_start -= 1;
+            } while(graph->component_stack.items[component_start] != node_index);
+
+            finish_alias_component(graph, component_start);
+        }
+    }
+}
+
+/// Resolves all type aliases in dependency order and publishes them into `pool`.
+/// Returns `false` after emitting diagnostics if any alias could not be resolved.
+static bool resolve_type_aliases(
+    struct apigen_ParserState * const state,
+    struct apigen_MemoryArena * const scratch_arena,
+    struct apigen_TypePool * const pool,
+    struct GlobalResolutionQueue * const resolve_queue,
+    struct DeclarationPtrArray const * const type_aliases)
+{
+    struct AliasGraph graph = {
+        .parser        = state,
+        .arena         = scratch_arena,
+        .pool          = pool,
+        .resolve_queue = resolve_queue,
+        .node_count    = type_aliases->count,
+    };
+    if(graph.node_count == 0) {
+        return true;
+    }
+
+    graph.nodes = apigen_memory_arena_alloc_aligned(scratch_arena, graph.node_count * sizeof(struct AliasNode), alignof(struct AliasNode));
+
+    // keep the load factor of the name table at or below 1/2:
+    graph.name_slot_count = 16;
+    while(graph.name_slot_count < 2 * graph.node_count) {
+        graph.name_slot_count *= 2;
+    }
+    graph.name_slots = apigen_memory_arena_alloc_aligned(scratch_arena, graph.name_slot_count * sizeof(size_t), alignof(size_t));
+    memset(graph.name_slots, 0, graph.name_slot_count * sizeof(size_t));
+
+    for(size_t node_index = 0; node_index < graph.node_count; node_index++) {
+        struct apigen_ParserDeclaration * const decl = type_aliases->items[node_index];
+        APIGEN_ASSERT(decl->associated_type == NULL);
+
+        graph.nodes[node_index] = (struct AliasNode) { .decl = decl };
+
+        // references resolve to the first declaration, later ones are reported as duplicates when published:
+        size_t * const slot = find_alias_slot(&graph, decl->identifier);
+        if(*slot == 0) {
+            *slot = node_index + 1;
+        }
+    }
+
+    for(size_t node_index = 0; node_index < graph.node_count; node_index++) {
+        struct AliasNode * const node = &graph.nodes[node_index];
+        node->first_dependency = graph.dependencies.count;
+        collect_alias_dependencies(&graph, node_index, &node->decl->type);
+        node->dependency_count = graph.dependencies.count - node->first_dependency;
+    }
+
+    for(size_t node_index = 0; node_index < graph.node_count; node_index++) {
+        if(graph.nodes[node_index].dfs_index == 0) {
+            visit_alias_node(&graph, node_index);
+        }
+    }
+
+    bool ok = true;
+    for(size_t node_index = 0; node_index < graph.node_count; node_index++) {
+        APIGEN_ASSERT(graph.nodes[node_index].state != ALIAS_PENDING);
+        if(graph.nodes[node_index].state != ALIAS_RESOLVED) {
+            ok = false;
+        }
+    }
+
+    if(graph.blocked_count > 0) {
+        emit_diagnostics(state, (struct apigen_ParserLocation){0}, apigen_error_unresolved_symbols, graph.blocked_count);
+    }
+
+    return ok;
+}
+
+// Parallel resolution of unique types:
+//
+// With `apigen_ParserState.jobs` set, the bodies of unique types (phase 4 and 9) are resolved by jobs on a
+// pool of worker threads. Each worker owns an arena for the resolved types, a scratch arena and a copy of the
+// document type pool that interns into the shared, sharded cache. Workers take jobs from the back of their own
+// deque and steal jobs from the front of the other deques when they run dry.
+// A job records its diagnostics and the anonymous types it found, and the results are replayed afterwards
+// in the order the serial analysis processes the types, so both produce the same document.
+
+struct UniqueTypeJob;
+
+APIGEN_DECLARE_ARRAY(UniqueTypeJobArray, struct UniqueTypeJob *);
+APIGEN_DEFINE_ARRAY_OPERATORS(UniqueTypeJobArray, struct UniqueTypeJob *, unique_type_job_array)
+
+struct UniqueTypeJob
+{
+    struct apigen_Type *             dst_type;
+    struct apigen_ParserType const * src_type;
+
+    // only valid after the job was run:
+    struct GlobalResolutionQueue discovered;  ///< anonymous types found while resolving `dst_type`, in order of discovery
+    struct UniqueTypeJobArray    nested_jobs; ///< the jobs created for `discovered` if nested types are resolved by the pool
+    struct apigen_Diagnostics    diagnostics;
+    bool                         ok;
+};
+
+struct UniqueTypeScheduler;
+
+struct UniqueTypeWorker
+{
+    struct UniqueTypeScheduler * scheduler;
+
+    pthread_mutex_t           lock;       ///< guards `deque` and `deque_head`
+    struct UniqueTypeJobArray deque;      ///< the owner takes jobs from the back, other workers steal from the front
+    size_t                    deque_head; ///< index of the first job that was not stolen yet
+
+    struct apigen_MemoryArena arena;         ///< stores the resolved types, adopted by the document afterwards
+    struct apigen_MemoryArena scratch_arena; ///< stores the jobs and their results until they are replayed
+    struct apigen_TypePool    type_pool;     ///< copy of the document type pool that allocates from `arena`
+    struct apigen_ParserState parser;        ///< copy of the parser state that emits into the diagnostics of the current job
+};
+
+struct UniqueTypeScheduler
+{
+    struct UniqueTypeWorker * workers;
+    size_t                    worker_count;
+    size_t                    next_worker;    ///< the worker that receives the next job added by `unique_type_scheduler_add`
+    bool                      resolve_nested; ///< anonymous types are resolved by nested jobs instead of being left in `discovered`
+    atomic_size_t             pending_jobs;   ///< number of jobs that were queued, but are not done yet
+
+    pthread_mutex_t           idle_lock;      ///< guards waiting on `wakeup`
+    pthread_cond_t            wakeup;         ///< signalled when a job was queued or the last job is done
+    atomic_size_t             wakeup_count;   ///< incremented with `idle_lock` held whenever `wakeup` is signalled
+};
+
+static void unique_type_scheduler_init(struct UniqueTypeScheduler * scheduler, struct apigen_ParserState * state, struct apigen_TypePool const * pool, bool resolve_nested)
+{
+    APIGEN_NOT_NULL(scheduler);
     APIGEN_NOT_NULL(state);
+    APIGEN_NOT_NULL(pool);
+    APIGEN_ASSERT(state->jobs > 1);
+    APIGEN_ASSERT(pool->shards != NULL);
+
+    *scheduler = (struct UniqueTypeScheduler) {
+        .workers        = apigen_alloc(state->jobs * sizeof(struct UniqueTypeWorker)),
+        .worker_count   = state->jobs,
+        .next_worker    = 0,
+        .resolve_nested = resolve_nested,
+    };
+    atomic_init(&scheduler->pending_jobs, 0);
+    atomic_init(&scheduler->wakeup_count, 0);
+    pthread_mutex_init(&scheduler->idle_lock, NULL);
+    pthread_cond_init(&scheduler->wakeup, NULL);
+
+    for(size_t i = 0; i < scheduler->worker_count; i++) {
+        struct UniqueTypeWorker * const worker = &scheduler->workers[i];
+        *worker = (struct UniqueTypeWorker) {
+            .scheduler  = scheduler,
+            .deque      = { 0 },
+            .deque_head = 0,
+            .type_pool  = *pool,
+            .parser     = *state,
+        };
+        pthread_mutex_init(&worker->lock, NULL);
+        apigen_memory_arena_init(&worker->arena);
+        apigen_memory_arena_init(&worker->scratch_arena);
+        worker->type_pool.arena = &worker->arena;
+    }
+}
+
+/// Releases the workers. The resolved types are adopted by `document_arena`, all job results become invalid.
+static void unique_type_scheduler_deinit(struct UniqueTypeScheduler * scheduler, struct apigen_MemoryArena * document_arena)
+{
+    APIGEN_NOT_NULL(scheduler);
+    APIGEN_NOT_NULL(document_arena);
+    APIGEN_ASSERT(atomic_load(&scheduler->pending_jobs) == 0);
+
+    for(size_t i = 0; i < scheduler->worker_count; i++) {
+        struct UniqueTypeWorker * const worker = &scheduler->workers[i];
+        apigen_memory_arena_adopt(document_arena, &worker->arena);
+        apigen_memory_arena_deinit(&worker->scratch_arena);
+        pthread_mutex_destroy(&worker->lock);
+    }
+    pthread_cond_destroy(&scheduler->wakeup);
+    pthread_mutex_destroy(&scheduler->idle_lock);
+    apigen_free(scheduler->workers);
+}
+
+static struct UniqueTypeJob * create_unique_type_job(struct apigen_MemoryArena * arena, struct apigen_Type * dst_type, struct apigen_ParserType const * src_type)
+{
+    struct UniqueTypeJob * const job = apigen_memory_arena_alloc_aligned(arena, sizeof(struct UniqueTypeJob), alignof(struct UniqueTypeJob));
+    *job = (struct UniqueTypeJob) {
+        .dst_type = dst_type,
+        .src_type = src_type,
+    };
+    return job;
+}
+
+/// Wakes up one idle worker, or all of them if `all` is set.
+static void wake_unique_type_workers(struct UniqueTypeScheduler * scheduler, bool all)
+{
+    pthread_mutex_lock(&scheduler->idle_lock);
+    atomic_fetch_add(&scheduler->wakeup_count, 1);
+    if(all) {
+        pthread_cond_broadcast(&scheduler->wakeup);
+    }
+    else {
+        pthread_cond_signal(&scheduler->wakeup);
+    }
+    pthread_mutex_unlock(&scheduler->idle_lock);
+}
+
+static void push_unique_type_job(struct UniqueTypeWorker * worker, struct UniqueTypeJob * job)
+{
+    atomic_fetch_add(&worker->scheduler->pending_jobs, 1);
+
+    pthread_mutex_lock(&worker->lock);
+    unique_type_job_array_append(&worker->scratch_arena, &worker->deque, job);
+    pthread_mutex_unlock(&worker->lock);
+
+    wake_unique_type_workers(worker->scheduler, false);
+}
+
+/// Takes the newest job of `worker`, or returns `NULL` if its deque is empty.
+static struct UniqueTypeJob * pop_unique_type_job(struct UniqueTypeWorker * worker)
+{
+    struct UniqueTypeJob * job = NULL;
+
+    pthread_mutex_lock(&worker->lock);
+    if(worker->deque.count > worker->deque_head) {
+        worker->deque.count -= 1;
+        job = worker->deque.items[worker->deque.count];
+        if(worker->deque.count == worker->deque_head) {
+            worker->deque.count = 0;
+            worker->deque_head  = 0;
+        }
+    }
+    pthread_mutex_unlock(&worker->lock);
+
+    return job;
+}
+
+/// Takes the oldest job of `victim`, or returns `NULL` if its deque is empty.
+static struct UniqueTypeJob * steal_unique_type_job(struct UniqueTypeWorker * victim)
+{
+    struct UniqueTypeJob * job = NULL;
+
+    pthread_mutex_lock(&victim->lock);
+    if(victim->deque.count > victim->deque_head) {
+        job = victim->deque.items[victim->deque_head];
+        victim->deque_head += 1;
+        if(victim->deque.count == victim->deque_head) {
+            victim->deque.count = 0;
+            victim->deque_head  = 0;
+        }
+    }
+    pthread_mutex_unlock(&victim->lock);
+
+    return job;
+}
+
+/// Queues a job for `dst_type`. Jobs are distributed over all workers before the scheduler runs.
+static struct UniqueTypeJob * unique_type_scheduler_add(struct UniqueTypeScheduler * scheduler, struct apigen_Type * dst_type, struct apigen_ParserType const * src_type)
+{
+    APIGEN_NOT_NULL(scheduler);
+
+    struct UniqueTypeWorker * const worker = &scheduler->workers[scheduler->next_worker];
+    scheduler->next_worker = (scheduler->next_worker + 1) % scheduler->worker_count;
+
+    struct UniqueTypeJob * const job = create_unique_type_job(&worker->scratch_arena, dst_type, src_type);
+    push_unique_type_job(worker, job);
+    return job;
+}
+
+static void run_unique_type_job(struct UniqueTypeWorker * worker, struct UniqueTypeJob * job)
+{
+    // all results are stored in the arena of the worker that runs the job:
+    job->discovered  = (struct GlobalResolutionQueue) { .arena = &worker->scratch_arena };
+    job->nested_jobs = (struct UniqueTypeJobArray) { 0 };
+    apigen_diagnostics_init(&job->diagnostics, &worker->scratch_arena);
+
+    worker->parser.diagnostics = &job->diagnostics;
+    job->ok = resolve_unique_type(&worker->parser, &worker->type_pool, &job->discovered, job->dst_type, job->src_type);
+
+    if(worker->scheduler->resolve_nested) {
+        struct GlobalResolutionQueueNode * node;
+        while((node = gsq_pop(&job->discovered)) != NULL) {
+            struct UniqueTypeJob * const nested_job = create_unique_type_job(&worker->scratch_arena, node->dst_type, node->src_type);
+            unique_type_job_array_append(&worker->scratch_arena, &job->nested_jobs, nested_job);
+            push_unique_type_job(worker, nested_job);
+        }
+    }
+
+    // nested jobs are already counted, so the pending count cannot drop to zero before they are done:
+    if(atomic_fetch_sub(&worker->scheduler->pending_jobs, 1) == 1) {
+        wake_unique_type_workers(worker->scheduler, true);
+    }
+}
+
+/// Runs jobs until all jobs of all workers are done.
+static void run_unique_type_worker(struct UniqueTypeWorker * worker)
+{
+    struct UniqueTypeScheduler * const scheduler = worker->scheduler;
+    size_t const worker_index = (size_t)(worker - scheduler->workers);
+
+    while(atomic_load(&scheduler->pending_jobs) > 0) {
+        // read before looking for jobs, so a job queued after the search is never missed:
+        size_t const wakeup_count = atomic_load(&scheduler->wakeup_count);
+
+        struct UniqueTypeJob * job = pop_unique_type_job(worker);
+        for(size_t i = 1; (job == NULL) && (i < scheduler->worker_count); i++) {
+            job = steal_unique_type_job(&scheduler->workers[(worker_index + i) % scheduler->worker_count]);
+        }
+
+        if(job != NULL) {
+            run_unique_type_job(worker, job);
+        }
+        else {
+            // the running jobs may still queue nested jobs:
+            pthread_mutex_lock(&scheduler->idle_lock);
+            while((atomic_load(&scheduler->wakeup_count) == wakeup_count) && (atomic_load(&scheduler->pending_jobs) > 0)) {
+                pthread_cond_wait(&scheduler->wakeup, &scheduler->idle_lock);
+            }
+            pthread_mutex_unlock(&scheduler->idle_lock);
+        }
+    }
+}
+
+static void * unique_type_worker_thread(void * worker)
+{
+    apigen_memory_set_tag(APIGEN_MEMORY_TAG_ANALYZER);
+    run_unique_type_worker(worker);
+    apigen_memory_flush_thread_stats();
+    return NULL;
+}
+
+/// Runs all queued jobs and their nested jobs to completion.
+static void unique_type_scheduler_run(struct UniqueTypeScheduler * scheduler)
+{
+    APIGEN_NOT_NULL(scheduler);
+
+    if(atomic_load(&scheduler->pending_jobs) == 0) {
+        return;
+    }
+
+    // The calling thread is the first worker:
+    size_t const thread_count = scheduler->worker_count - 1;
+    pthread_t * const threads = apigen_alloc(thread_count * sizeof(pthread_t));
+    size_t started_threads = 0;
+    while(started_threads < thread_count) {
+        if(pthread_create(&threads[started_threads], NULL, unique_type_worker_thread, &scheduler->workers[started_threads + 1]) != 0) {
+            break; // jobs of the missing workers are stolen by the others
+        }
+        started_threads += 1;
+    }
+
+    run_unique_type_worker(&scheduler->workers[0]);
+
+    for(size_t i = 0; i < started_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    apigen_free(threads);
+}
+
+static bool analyze_document(struct apigen_ParserState * const state, struct apigen_MemoryArena * const scratch_arena, struct apigen_Document * const out_document)
+{
+    APIGEN_NOT_NULL(state);
+    APIGEN_NOT_NULL(scratch_arena);
     APIGEN_NOT_NULL(out_document);
+    APIGEN_NOT_NULL(state->strings);
 
     *out_document = (struct apigen_Document) {
         .type_pool = {
-            .arena = state->ast_arena,
+            // the document must not refer to the AST, which may be released right after the analysis:
+            .arena   = (state->document_arena != NULL) ? state->document_arena : state->ast_arena,
+            .strings = state->strings,
         },
 
         .type_count     = 0,
@@ -979,157 +1632,109 @@ bool apigen_analyze(struct apigen_ParserState * const state, struct apigen_Docum
     };
 
     struct GlobalResolutionQueue resolve_queue = {
-        .arena = out_document->type_pool.arena,
+        .arena = scratch_arena,
     };
 
-    // Phase 1: Figure out how much memory we need for all exported declarations:
+    // Phase 1: Sort the declarations by kind, which also tells how much memory we need for all exported declarations:
+    struct DeclarationBuckets buckets;
+    sort_declarations_into_buckets(state->top_level_declarations, scratch_arena, &buckets);
     {
-        struct apigen_ParserDeclaration const * decl = state->top_level_declarations;
-        while(decl != NULL) {
-            switch(decl->kind) {
-                case apigen_parser_const_declaration:
-                case apigen_parser_var_declaration:
-                    out_document->variable_count += 1;
-                    break;
-
-                case apigen_parser_constexpr_declaration:
-                    out_document->constant_count += 1;
-                    break;
-
-                case apigen_parser_fn_declaration:
-                    out_document->function_count += 1;
-                    break;
-
-                case apigen_parser_type_declaration:
-                    out_document->type_count += 1;
-                    break;
-
-                case apigen_parser_include_declaration:
-                    apigen_panic("Document contains unresolved include paths!");
-            }
-            decl = decl->next;
-        }
-
-        out_document->types     = apigen_memory_arena_alloc(state->ast_arena, out_document->type_count     * sizeof(struct apigen_Type const *));
-        out_document->functions = apigen_memory_arena_alloc(state->ast_arena, out_document->function_count * sizeof(struct apigen_Function));
-        out_document->variables = apigen_memory_arena_alloc(state->ast_arena, out_document->variable_count * sizeof(struct apigen_Global));
-        out_document->constants = apigen_memory_arena_alloc(state->ast_arena, out_document->constant_count * sizeof(struct apigen_Constant));
+        out_document->type_count     = buckets.types.count;
+        out_document->function_count = buckets.functions.count;
+        out_document->variable_count = buckets.variables.count;
+        out_document->constant_count = buckets.constants.count;
+
+        out_document->types     = apigen_memory_arena_alloc_aligned(out_document->type_pool.arena, out_document->type_count     * sizeof(struct apigen_Type const *), alignof(struct apigen_Type const *));
+        out_document->functions = apigen_memory_arena_alloc_aligned(out_document->type_pool.arena, out_document->function_count * sizeof(struct apigen_Function), alignof(struct apigen_Function));
+        out_document->variables = apigen_memory_arena_alloc_aligned(out_document->type_pool.arena, out_document->variable_count * sizeof(struct apigen_Global), alignof(struct apigen_Global));
+        out_document->constants = apigen_memory_arena_alloc_aligned(out_document->type_pool.arena, out_document->constant_count * sizeof(struct apigen_Constant), alignof(struct apigen_Constant));
     }
 
     // Phase 2: Publish all named unique types (struct, union, ...) into the pool
     {
         bool ok = true;
 
-        struct apigen_ParserDeclaration * decl = state->top_level_declarations;
-        while(decl != NULL) {
-            if(decl->kind == apigen_parser_type_declaration) {
-                if(is_unique_type( decl->type.type)) {
-                    struct apigen_Type * const unique_type = apigen_memory_arena_alloc(state->ast_arena, sizeof(struct apigen_Type));
-                    *unique_type = (struct apigen_Type) {
-                        .name = decl->identifier,
-                        .id = map_unique_parser_type_id(decl->type.type),
-                        .extra = NULL, // no internal resolution yet
-                        .is_anonymous = false,
-                    };
+        for(size_t i = 0; i < buckets.unique_types.count; i++) {
+            struct apigen_ParserDeclaration * const decl = buckets.unique_types.items[i];
 
-                    if(!apigen_register_type(&out_document->type_pool, unique_type, NULL)) {
-                        emit_diagnostics(state, decl->location, apigen_error_duplicate_symbol, decl->identifier);
-                        ok = false;
-                    }
+            struct apigen_Type * const unique_type = apigen_memory_arena_alloc_aligned(out_document->type_pool.arena, sizeof(struct apigen_Type), alignof(struct apigen_Type));
+            *unique_type = (struct apigen_Type) {
+                .name = decl->identifier,
+                .id = map_unique_parser_type_id(decl->type.type),
+                .extra = NULL, // no internal resolution yet
+                .is_anonymous = false,
+            };
 
-                    decl->associated_type = unique_type;
-                }
+            if(!apigen_register_type(&out_document->type_pool, unique_type, NULL)) {
+                emit_diagnostics(state, decl->location, apigen_error_duplicate_symbol, decl->identifier);
+                ok = false;
             }
-            decl = decl->next;
+
+            decl->associated_type = unique_type;
         }
         if(!ok) {
             return false;
         }
     }
 
-    // Phase 3: Resolve and publish all global non-unique types (pointers, aliases, ...)
-    {
-        size_t resolved_count;
-        size_t resolve_failed_count;
-        bool non_resolve_error;
-        bool emit_resolve_errors = false;
-        while(true) {
-            resolved_count = 0;
-            resolve_failed_count = 0;
-            non_resolve_error = false;
-
-            struct apigen_ParserDeclaration * decl = state->top_level_declarations;
-            while(decl != NULL) {
-                if(decl->kind == apigen_parser_type_declaration) {
-                    if(decl->associated_type == NULL) {
-                        APIGEN_ASSERT(!is_unique_type( decl->type.type));
-
-                        struct apigen_Type const * const resolved_type = resolve_type(state, &out_document->type_pool, &resolve_queue, emit_resolve_errors, decl->identifier, &decl->type, &non_resolve_error);
-                        if(resolved_type != NULL) {
-
-                            struct apigen_Type * const alias_type = apigen_memory_arena_alloc(out_document->type_pool.arena, sizeof(struct apigen_Type));
-                            *alias_type = (struct apigen_Type) {
-                                .name = apigen_memory_arena_dupestr(out_document->type_pool.arena, decl->identifier),
-                                .extra = resolved_type,
-                                .is_anonymous = false,
-                                .id = apigen_typeid_alias,
-                            };
-
-                            if(apigen_register_type(&out_document->type_pool, alias_type, decl->identifier)) {
-                                decl->associated_type = (struct apigen_Type *)alias_type; // This is fine, we don't need the mutable reference here anyways
-                                resolved_count += 1;
-                            }
-                            else {
-                                emit_diagnostics(state, decl->location, apigen_error_duplicate_symbol, decl->identifier);
-                                non_resolve_error = true;
-                            }
+    // Phase 3: Resolve and publish all global non-unique types (pointers, aliases, ...) in dependency order
+    if(!resolve_type_aliases(state, scratch_arena, &out_document->type_pool, &resolve_queue, &buckets.type_aliases)) {
+        return false;
+    }
 
-                        }
-                        else {
-                            resolve_failed_count += 1;
-                        }
-                    }
-                }
-                decl = decl->next;
-            }
+    // All named types are registered now, so the remaining types can be interned from several threads:
+    bool const resolve_in_parallel = (state->jobs > 1);
+    if(resolve_in_parallel) {
+        apigen_type_pool_enable_sharing(&out_document->type_pool);
+    }
 
-            if(resolved_count == 0) {
-                if(emit_resolve_errors) {
-                    break;
-                }
-                emit_resolve_errors = true;
-            }
-            if(non_resolve_error) {
-                break;
-            }
+    // Phase 4: Now resolve all unique types
+    if(resolve_in_parallel) {
+        struct UniqueTypeScheduler scheduler;
+        unique_type_scheduler_init(&scheduler, state, &out_document->type_pool, false);
+
+        struct UniqueTypeJobArray jobs = { 0 };
+        for(size_t i = 0; i < buckets.unique_types.count; i++) {
+            struct apigen_ParserDeclaration const * const decl = buckets.unique_types.items[i];
+            APIGEN_ASSERT(decl->associated_type != NULL);
+            unique_type_job_array_append(scratch_arena, &jobs, unique_type_scheduler_add(&scheduler, decl->associated_type, &decl->type));
         }
 
-        if(non_resolve_error) {
-            return false;
+        unique_type_scheduler_run(&scheduler);
+
+        // replay the results in declaration order:
+        bool ok = true;
+        for(size_t i = 0; i < jobs.count; i++) {
+            struct UniqueTypeJob * const job = jobs.items[i];
+
+            apigen_diagnostics_merge(state->diagnostics, &job->diagnostics);
+            if(!job->ok) {
+                ok = false;
+            }
+
+            struct GlobalResolutionQueueNode * node;
+            while((node = gsq_pop(&job->discovered)) != NULL) {
+                struct GlobalResolutionQueueNode * const copy = apigen_memory_arena_alloc_aligned(scratch_arena, sizeof(struct GlobalResolutionQueueNode), alignof(struct GlobalResolutionQueueNode));
+                *copy = *node;
+                gsq_push(&resolve_queue, copy);
+            }
         }
 
-        if(resolve_failed_count > 0) {
-            emit_diagnostics(state, (struct apigen_ParserLocation){0}, apigen_error_unresolved_symbols, resolve_failed_count);
+        unique_type_scheduler_deinit(&scheduler, out_document->type_pool.arena);
+        if(!ok) {
             return false;
         }
     }
-
-    // Phase 4: Now resolve all unique types
-    {
+    else {
         bool ok = true;
-        struct apigen_ParserDeclaration const * decl = state->top_level_declarations;
-        while(decl != NULL) {
-            if(decl->kind == apigen_parser_type_declaration) {
-                if(is_unique_type(decl->type.type)) {
-                    APIGEN_ASSERT(decl->associated_type != NULL);
+        for(size_t i = 0; i < buckets.unique_types.count; i++) {
+            struct apigen_ParserDeclaration const * const decl = buckets.unique_types.items[i];
+            APIGEN_ASSERT(decl->associated_type != NULL);
 
-                    bool const resolve_ok = resolve_unique_type(state, &out_document->type_pool, &resolve_queue, decl->associated_type, &decl->type);
-                    if(!resolve_ok) {
-                        ok = false;
-                    }
-                }
+            bool const resolve_ok = resolve_unique_type(state, &out_document->type_pool, &resolve_queue, decl->associated_type, &decl->type);
+            if(!resolve_ok) {
+                ok = false;
             }
-            decl = decl->next;
         }
         if(!ok) {
             return false;
@@ -1137,45 +1742,31 @@ bool apigen_analyze(struct apigen_ParserState * const state, struct apigen_Docum
     }
 
     // Phase 5: Store all declared type into the document
-    {
-        size_t index = 0;
-        struct apigen_ParserDeclaration const * decl = state->top_level_declarations;
-        while(decl != NULL) {
-            if(decl->kind == apigen_parser_type_declaration) {
-                APIGEN_ASSERT(decl->associated_type != NULL);
-                out_document->types[index] = decl->associated_type;
-                index += 1;
-            }
-            decl = decl->next;
-        }
-        APIGEN_ASSERT(index == out_document->type_count);
+    for(size_t index = 0; index < buckets.types.count; index++) {
+        struct apigen_ParserDeclaration const * const decl = buckets.types.items[index];
+        APIGEN_ASSERT(decl->associated_type != NULL);
+        out_document->types[index] = decl->associated_type;
     }
 
     // Phase 6: Resolve external variables (globals, consts)
     {
         bool ok = true;
-        size_t index = 0;
-        struct apigen_ParserDeclaration const * decl = state->top_level_declarations;
-        while(decl != NULL) {
-            if((decl->kind == apigen_parser_const_declaration) || (decl->kind == apigen_parser_var_declaration)) {
-                struct apigen_Global * const global = &out_document->variables[index];
-                *global = (struct apigen_Global) {
-                    .documentation = apigen_memory_arena_dupestr(out_document->type_pool.arena, decl->documentation),
-                    .name          = apigen_memory_arena_dupestr(out_document->type_pool.arena, decl->identifier),
-                    .type          = resolve_type(state, &out_document->type_pool, &resolve_queue, true, decl->identifier, &decl->type, NULL),
-                    .is_const      = (decl->kind == apigen_parser_const_declaration),
-                };
-                if(global->type != NULL) {
-                    // TODO: Check viability?
-                } else {
-                    ok = false;
-                }
-
-                index += 1;
+        for(size_t index = 0; index < buckets.variables.count; index++) {
+            struct apigen_ParserDeclaration const * const decl = buckets.variables.items[index];
+
+            struct apigen_Global * const global = &out_document->variables[index];
+            *global = (struct apigen_Global) {
+                .documentation = apigen_memory_arena_dupestr(out_document->type_pool.arena, decl->documentation),
+                .name          = decl->identifier,
+                .type          = resolve_type(state, &out_document->type_pool, &resolve_queue, decl->identifier, &decl->type),
+                .is_const      = (decl->kind == apigen_parser_const_declaration),
+            };
+            if(global->type != NULL) {
+                // TODO: Check viability?
+            } else {
+                ok = false;
             }
-            decl = decl->next;
         }
-        APIGEN_ASSERT(index == out_document->variable_count);
         if(!ok) {
             return false;
         }
@@ -1184,29 +1775,23 @@ bool apigen_analyze(struct apigen_ParserState * const state, struct apigen_Docum
     // Phase 7: Resolve function definitions
     {
         bool ok = true;
-        size_t index = 0;
-        struct apigen_ParserDeclaration const * decl = state->top_level_declarations;
-        while(decl != NULL) {
-            if(decl->kind == apigen_parser_fn_declaration) {
-                struct apigen_Function * const func = &out_document->functions[index];
-                *func = (struct apigen_Function) {
-                    .documentation = apigen_memory_arena_dupestr(out_document->type_pool.arena, decl->documentation),
-                    .name          = apigen_memory_arena_dupestr(out_document->type_pool.arena, decl->identifier),
-                    .type          = resolve_type(state, &out_document->type_pool, &resolve_queue, true, decl->identifier, &decl->type, NULL),
-                    // TODO: Implement/add calling convention support!
-                };
-                if(func->type != NULL) {
-                    APIGEN_ASSERT(func->type->id == apigen_typeid_function);
-                    // TODO: Check viability?
-                } else {
-                    ok = false;
-                }
-
-                index += 1;
+        for(size_t index = 0; index < buckets.functions.count; index++) {
+            struct apigen_ParserDeclaration const * const decl = buckets.functions.items[index];
+
+            struct apigen_Function * const func = &out_document->functions[index];
+            *func = (struct apigen_Function) {
+                .documentation = apigen_memory_arena_dupestr(out_document->type_pool.arena, decl->documentation),
+                .name          = decl->identifier,
+                .type          = resolve_type(state, &out_document->type_pool, &resolve_queue, decl->identifier, &decl->type),
+                // TODO: Implement/add calling convention support!
+            };
+            if(func->type != NULL) {
+                APIGEN_ASSERT(func->type->id == apigen_typeid_function);
+                // TODO: Check viability?
+            } else {
+                ok = false;
             }
-            decl = decl->next;
         }
-        APIGEN_ASSERT(index == out_document->function_count);
         if(!ok) {
             return false;
         }
@@ -1215,68 +1800,62 @@ bool apigen_analyze(struct apigen_ParserState * const state, struct apigen_Docum
     // Phase 8: Resolve constexpr variables
     {
         bool ok = true;
-        size_t index = 0;
-        struct apigen_ParserDeclaration const * decl = state->top_level_declarations;
-        while(decl != NULL) {
-            if(decl->kind == apigen_parser_constexpr_declaration) {
-                struct apigen_Constant * const global = &out_document->constants[index];
-                *global = (struct apigen_Constant) {
-                    .documentation = apigen_memory_arena_dupestr(out_document->type_pool.arena, decl->documentation),
-                    .name          = apigen_memory_arena_dupestr(out_document->type_pool.arena, decl->identifier),
-                    .type          = resolve_type(state, &out_document->type_pool, &resolve_queue, true, decl->identifier, &decl->type, NULL),
-                    .value         = decl->initial_value,
-                };
+        for(size_t index = 0; index < buckets.constants.count; index++) {
+            struct apigen_ParserDeclaration const * const decl = buckets.constants.items[index];
+
+            struct apigen_Constant * const global = &out_document->constants[index];
+            *global = (struct apigen_Constant) {
+                .documentation = apigen_memory_arena_dupestr(out_document->type_pool.arena, decl->documentation),
+                .name          = decl->identifier,
+                .type          = resolve_type(state, &out_document->type_pool, &resolve_queue, decl->identifier, &decl->type),
+                .value         = copy_value(out_document->type_pool.arena, decl->initial_value),
+            };
 
-                size_t length_hint = SIZE_MAX;
-                if(global->value.type == apigen_value_str) {
-                    length_hint = strlen(global->value.value_str);
-                }
+            size_t length_hint = SIZE_MAX;
+            if(global->value.type == apigen_value_str) {
+                length_hint = strlen(global->value.value_str);
+            }
 
 
-                if(global->type != NULL) {
-                    if(is_integer_type(*global->type)) {
-                        struct ValueRange const range = get_integer_range(global->type->id);
-                        if(range_is_valid(range)) {
-                            switch(global->value.type) {
-                                case apigen_value_sint:
-                                    if(!svalue_in_range(range, global->value.value_sint)) {
-                                        emit_diagnostics(state, decl->location, apigen_error_constexpr_out_of_range, global->name);
-                                    }
-                                    break;
-
-                                case apigen_value_uint:
-                                    if(!uvalue_in_range(range, global->value.value_uint)) {
-                                        emit_diagnostics(state, decl->location, apigen_error_constexpr_out_of_range, global->name);
-                                    }
-                                    break;
-
-                                default:
-                                    emit_diagnostics(state, decl->location, apigen_error_constexpr_type_mismatch, global->name);
-                                    break;
-                            }
-                        }
-                        else {
-                            emit_diagnostics(state, decl->location, apigen_warning_constexpr_unchecked, global->name);
-                        }
-                    }
-                    else if(is_stringly_type(*global->type, length_hint)) {
-                        if(global->value.type != apigen_value_str) {
-                            emit_diagnostics(state, decl->location, apigen_error_constexpr_type_mismatch, global->name);
+            if(global->type != NULL) {
+                if(is_integer_type(*global->type)) {
+                    struct ValueRange const range = get_integer_range(global->type->id);
+                    if(range_is_valid(range)) {
+                        switch(global->value.type) {
+                            case apigen_value_sint:
+                                if(!svalue_in_range(range, global->value.value_sint)) {
+                                    emit_diagnostics(state, decl->location, apigen_error_constexpr_out_of_range, global->name);
+                                }
+                                break;
+
+                            case apigen_value_uint:
+                                if(!uvalue_in_range(range, global->value.value_uint)) {
+                                    emit_diagnostics(state, decl->location, apigen_error_constexpr_out_of_range, global->name);
+                                }
+                                break;
+
+                            default:
+                                emit_diagnostics(state, decl->location, apigen_error_constexpr_type_mismatch, global->name);
+                                break;
                         }
                     }
                     else {
-                        emit_diagnostics(state, decl->location, apigen_error_constexpr_illegal_type, global->name);
+                        emit_diagnostics(state, decl->location, apigen_warning_constexpr_unchecked, global->name);
+                    }
+                }
+                else if(is_stringly_type(*global->type, length_hint)) {
+                    if(global->value.type != apigen_value_str) {
+                        emit_diagnostics(state, decl->location, apigen_error_constexpr_type_mismatch, global->name);
                     }
-
-                } else {
-                    ok = false;
+                }
+                else {
+                    emit_diagnostics(state, decl->location, apigen_error_constexpr_illegal_type, global->name);
                 }
 
-                index += 1;
+            } else {
+                ok = false;
             }
-            decl = decl->next;
         }
-        APIGEN_ASSERT(index == out_document->constant_count);
         if(!ok) {
             return false;
         }
@@ -1288,15 +1867,49 @@ bool apigen_analyze(struct apigen_ParserState * const state, struct apigen_Docum
         bool ok = true;
         struct GlobalResolutionQueue ready_types = { 0 };
         struct GlobalResolutionQueueNode * node;
-        while((node = gsq_pop(&resolve_queue)) != NULL)
-        {
-            // fprintf(stderr, "resolve anonymous type %s\n", node->dst_type->name);
-            bool const resolve_ok = resolve_unique_type(state, &out_document->type_pool, &resolve_queue, node->dst_type, node->src_type);
-            if(!resolve_ok) {
-                ok = false;
+        if(resolve_in_parallel) {
+            struct UniqueTypeScheduler scheduler;
+            unique_type_scheduler_init(&scheduler, state, &out_document->type_pool, true);
+
+            struct UniqueTypeJobArray jobs = { 0 };
+            while((node = gsq_pop(&resolve_queue)) != NULL) {
+                unique_type_job_array_append(scratch_arena, &jobs, unique_type_scheduler_add(&scheduler, node->dst_type, node->src_type));
+            }
+
+            unique_type_scheduler_run(&scheduler);
+
+            // the serial queue resolves the types breadth-first, so the nested jobs are replayed in the same order:
+            for(size_t i = 0; i < jobs.count; i++) {
+                struct UniqueTypeJob * const job = jobs.items[i];
+
+                apigen_diagnostics_merge(state->diagnostics, &job->diagnostics);
+                if(!job->ok) {
+                    ok = false;
+                }
+                unique_type_job_array_append_all(scratch_arena, &jobs, job->nested_jobs.items, job->nested_jobs.count);
+
+                struct GlobalResolutionQueueNode * const ready_node = apigen_memory_arena_alloc_aligned(scratch_arena, sizeof(struct GlobalResolutionQueueNode), alignof(struct GlobalResolutionQueueNode));
+                *ready_node = (struct GlobalResolutionQueueNode) {
+                    .dst_type = job->dst_type,
+                    .src_type = job->src_type,
+                };
+                additional_types += 1;
+                gsq_push(&ready_types, ready_node);
+            }
+
+            unique_type_scheduler_deinit(&scheduler, out_document->type_pool.arena);
+        }
+        else {
+            while((node = gsq_pop(&resolve_queue)) != NULL)
+            {
+                // fprintf(stderr, "resolve anonymous type %s\n", node->dst_type->name);
+                bool const resolve_ok = resolve_unique_type(state, &out_document->type_pool, &resolve_queue, node->dst_type, node->src_type);
+                if(!resolve_ok) {
+                    ok = false;
+                }
+                additional_types += 1;
+                gsq_push(&ready_types, node);
             }
-            additional_types += 1;
-            gsq_push(&ready_types, node);
         }
         if(!ok) {
             return false;
@@ -1307,7 +1920,7 @@ bool apigen_analyze(struct apigen_ParserState * const state, struct apigen_Docum
             size_t old_count = out_document->type_count;
 
             out_document->type_count += additional_types;
-            out_document->types = apigen_memory_arena_alloc(state->ast_arena, out_document->type_count * sizeof(struct apigen_Type const *));
+            out_document->types = apigen_memory_arena_alloc_aligned(out_document->type_pool.arena, out_document->type_count * sizeof(struct apigen_Type const *), alignof(struct apigen_Type const *));
 
             memcpy(out_document->types, old_types, old_count * sizeof(struct apigen_Type const *));
 
@@ -1323,3 +1936,23 @@ bool apigen_analyze(struct apigen_ParserState * const state, struct apigen_Docum
 
     return true;
 }
+
+bool apigen_analyze(struct apigen_ParserState * const state, struct apigen_Document * const out_document)
+{
+    APIGEN_NOT_NULL(state);
+    APIGEN_NOT_NULL(out_document);
+
+    enum apigen_MemoryTag const previous_tag = apigen_memory_set_tag(APIGEN_MEMORY_TAG_ANALYZER);
+
+    // The resolution queue is only required during analysis and is not part of the document:
+    struct apigen_MemoryArena scratch_arena;
+    apigen_memory_arena_init(&scratch_arena);
+
+    bool const ok = analyze_document(state, &scratch_arena, out_document);
+
+    apigen_memory_arena_deinit(&scratch_arena);
+
+    apigen_memory_set_tag(previous_tag);
+
+    return ok;
+}
@@ -14,6 +14,29 @@ void apigen_dump_stack_trace(void);
 extern void * (*apigen_memory_alloc_backend)(size_t);
 extern void (*apigen_memory_free_backend)(void*);
 
+// Poisoning policy for fresh and released memory, selected with -DAPIGEN_MEMORY_POISON=<mode>:
+//   0: no poisoning (default for NDEBUG builds)
+//   1: fill with the 0xAA pattern (default for debug builds)
+//   2: pattern fill, and unused arena memory is additionally marked inaccessible
+//      for AddressSanitizer (requires -fsanitize=address)
+#define APIGEN_MEMORY_POISON_NONE    0
+#define APIGEN_MEMORY_POISON_PATTERN 1
+#define APIGEN_MEMORY_POISON_ASAN    2
+
+#ifndef APIGEN_MEMORY_POISON
+#ifdef NDEBUG
+#define APIGEN_MEMORY_POISON APIGEN_MEMORY_POISON_NONE
+#else
+#define APIGEN_MEMORY_POISON APIGEN_MEMORY_POISON_PATTERN
+#endif
+#endif
+
+#if APIGEN_MEMORY_POISON >= APIGEN_MEMORY_POISON_PATTERN
+#define APIGEN_POISON_FILL(_Ptr, _Size) memset((_Ptr), 0xAA, (_Size))
+#else
+#define APIGEN_POISON_FILL(_Ptr, _Size) ((void)(_Ptr), (void)(_Size))
+#endif
+
 enum TestMode
 {
     TEST_MODE_DISABLED = 0,
@@ -30,6 +53,16 @@ enum TargetLanguage
     LANG_GO
 };
 
+enum ArenaMode
+{
+    ARENA_MODE_CHUNKED = 0,
+    ARENA_MODE_RESERVE,
+    ARENA_MODE_RESERVE_HUGE,
+};
+
+/// Upper limit for `--jobs`, more threads than this would only wait for the queue lock.
+#define APIGEN_MAX_JOBS 256
+
 struct CliOptions
 {
     char const * executable;
@@ -41,13 +74,21 @@ struct CliOptions
     enum TestMode       test_mode;
     char const *        output;
     bool                implementation;
+    bool                no_docs;
     enum TargetLanguage language;
+    enum ArenaMode      arena_mode;
+    bool                memory_report;
+    uint32_t            jobs;
+    char const *        module_cache;
 };
 
 struct CliOptions apigen_parse_options_or_exit(int argc, char ** argv);
 
 bool apigen_open_input_from_cwd(struct apigen_ParserState * state, char const * path);
 
+/// Opens the module cache directory `path` into `out_dir` and lets `state` use it. Does nothing if `path` is `NULL`.
+bool apigen_open_module_cache_from_cwd(struct apigen_ParserState * state, char const * path, struct apigen_Directory * out_dir);
+
 int apigen_test_runner(
     struct apigen_MemoryArena * const arena,
     struct apigen_Diagnostics * const diagnostics,
@@ -4,6 +4,29 @@
 #include "apigen.h"
 #include "apigen-internals.h"
 
+/// Size of the address space reserved for `--arena reserve`. Only touched pages are backed by memory.
+/// The central arena and the AST arena both exist while parsing, so the address space is split between
+/// them instead of reserving it twice. The AST gets the smaller part, it is released before the backends run.
+#if SIZE_MAX > UINT32_MAX
+static size_t const CENTRAL_ARENA_RESERVE_SIZE = (size_t)48 * 1024 * 1024 * 1024;
+static size_t const AST_ARENA_RESERVE_SIZE     = (size_t)16 * 1024 * 1024 * 1024;
+#else
+static size_t const CENTRAL_ARENA_RESERVE_SIZE = (size_t)384 * 1024 * 1024;
+static size_t const AST_ARENA_RESERVE_SIZE     = (size_t)128 * 1024 * 1024;
+#endif
+
+/// Initializes `arena` with the allocation strategy selected by `--arena`, reserved arenas get `reserve_size` bytes of address space.
+static void init_arena(struct apigen_MemoryArena * arena, enum ArenaMode mode, size_t reserve_size)
+{
+    if (mode == ARENA_MODE_CHUNKED) {
+        apigen_memory_arena_init(arena);
+    }
+    else if (!apigen_memory_arena_init_reserved(arena, reserve_size, (mode == ARENA_MODE_RESERVE_HUGE))) {
+        fprintf(stderr, "warning: failed to reserve virtual memory, falling back to chunked arena.\n");
+        apigen_memory_arena_init(arena);
+    }
+}
+
 static int apigen_main(
     struct apigen_MemoryArena * const arena,
     struct apigen_Diagnostics * const diagnostics,
@@ -13,9 +36,13 @@ static int apigen_main(
         .source_dir  = apigen_io_cwd(),
         .file        = apigen_io_null,
         .file_name   = "stdin",
-        .ast_arena   = arena,
+        .ast_arena   = NULL, // set right before parsing
         .line_feed   = "\r\n",
         .diagnostics = diagnostics,
+        .jobs        = options->jobs,
+
+        .document_arena     = arena,
+        .skip_documentation = options->no_docs,
     };
 
     if (options->positional_count != 1) {
@@ -27,56 +54,78 @@ static int apigen_main(
         return EXIT_FAILURE;
     }
 
+    struct apigen_Directory module_cache;
+    if(!apigen_open_module_cache_from_cwd(&state, options->module_cache, &module_cache)) {
+        return EXIT_FAILURE;
+    }
+
     if(options->language == LANG_GO)
         apigen_panic("oh no!");
 
+    // The AST is only required until the document is analyzed, so it gets its own arena
+    // which is released before the backends run:
+    struct apigen_MemoryArena ast_arena;
+    init_arena(&ast_arena, options->arena_mode, AST_ARENA_RESERVE_SIZE);
+    state.ast_arena = &ast_arena;
+
     bool ok = apigen_parse(&state);
-    if (ok) {
-        struct apigen_Document document;
 
+    struct apigen_Document document;
+    if (ok) {
         ok = apigen_analyze(&state, &document);
-        if (ok) {
+    }
 
-            FILE * output;
-            if ((options->output == NULL) || apigen_streq(options->output, "-")) {
-                output = stdout;
-            }
-            else {
-                output = fopen(options->output, "wb");
-                if (output == NULL) {
-                    fprintf(stderr, "error: could not open %s!\n", options->output);
-                    return EXIT_FAILURE;
-                }
-            }
+    // the document does not refer to the AST, so its memory is not needed anymore:
+    apigen_memory_arena_deinit(&ast_arena);
+    state.ast_arena = NULL;
 
-            struct apigen_Stream out_stream = apigen_io_from_stream(output);
-
-            switch (options->language) {
-                case LANG_C:
-                    ok = apigen_render_c(out_stream, arena, diagnostics, &document);
-                    break;
-                case LANG_CPP:
-                    ok = apigen_render_cpp(out_stream, arena, diagnostics, &document);
-                    break;
-                case LANG_ZIG:
-                    ok = apigen_render_zig(out_stream, arena, diagnostics, &document);
-                    break;
-                case LANG_RUST:
-                    ok = apigen_render_rust(out_stream, arena, diagnostics, &document);
-                    break;
-                case LANG_GO:
-                    ok = apigen_render_go(out_stream, arena, diagnostics, &document);
-                    break;
+    FILE * output = NULL;
+    if (ok) {
+        if ((options->output == NULL) || apigen_streq(options->output, "-")) {
+            output = stdout;
+        }
+        else {
+            output = fopen(options->output, "wb");
+            if (output == NULL) {
+                fprintf(stderr, "error: could not open %s!\n", options->output);
+                ok = false;
             }
+        }
+    }
 
-            if (output != stdout) {
-                fclose(output);
-            }
+    if (output != NULL) {
+        struct apigen_Stream out_stream = apigen_io_from_stream(output);
+
+        enum apigen_MemoryTag const previous_tag = apigen_memory_set_tag(APIGEN_MEMORY_TAG_BACKEND);
+        switch (options->language) {
+            case LANG_C:
+                ok = apigen_render_c(out_stream, arena, diagnostics, &document);
+                break;
+            case LANG_CPP:
+                ok = apigen_render_cpp(out_stream, arena, diagnostics, &document);
+                break;
+            case LANG_ZIG:
+                ok = apigen_render_zig(out_stream, arena, diagnostics, &document);
+                break;
+            case LANG_RUST:
+                ok = apigen_render_rust(out_stream, arena, diagnostics, &document);
+                break;
+            case LANG_GO:
+                ok = apigen_render_go(out_stream, arena, diagnostics, &document);
+                break;
+        }
+        apigen_memory_set_tag(previous_tag);
+
+        if (output != stdout) {
+            fclose(output);
         }
     }
 
     apigen_io_close(&state.file);
     apigen_io_close_dir(&state.source_dir);
+    if(state.module_cache != NULL) {
+        apigen_io_close_dir(&module_cache);
+    }
 
     return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -105,15 +154,22 @@ int main(int argc, char ** argv)
     apigen_enable_debug_diagnostics();
 
     struct CliOptions options = apigen_parse_options_or_exit(argc, argv);
+    if (options.memory_report) {
+        apigen_memory_enable_stats();
+    }
 
     struct apigen_MemoryArena central_arena;
-    apigen_memory_arena_init(&central_arena);
+    init_arena(&central_arena, options.arena_mode, CENTRAL_ARENA_RESERVE_SIZE);
 
     struct apigen_Diagnostics diagnostics;
     apigen_diagnostics_init(&diagnostics, &central_arena);
 
     int result = wrapped_main(&central_arena, &diagnostics, &options);
 
+    if (options.memory_report) {
+        apigen_memory_render_report(apigen_io_stderr, &central_arena);
+    }
+
     apigen_diagnostics_render(&diagnostics, apigen_io_stderr);
 
     apigen_diagnostics_deinit(&diagnostics);
@@ -17,6 +17,12 @@ void apigen_print_help(char const * exe, FILE * out)
         "   -o, --output <path>    Instead of printing the output to stdout, will write the output to <path>.\n"
         "   -l, --language <lang>  Generates code for the given language. Valid options are: [c], c++, zig, rust, go\n"
         "   -i, --implementation   Generates an implementation stub, not a binding.\n"
+        "       --no-docs          Ignores all doc comments, the output contains no documentation.\n"
+        "   -j, --jobs <count>     Parses included files and resolves types with <count> threads. Defaults to [1].\n"
+        "       --module-cache <dir>\n"
+        "                          Caches the parsed included files in <dir> and reuses them while they are unchanged.\n"
+        "       --arena <mode>     Selects the memory allocation strategy. Valid options are: [chunked], reserve, reserve-huge\n"
+        "       --memory-report    Prints the memory usage of each processing phase to stderr.\n"
         // "" "\n"
         ;
     if (exe == NULL) {
@@ -30,6 +36,7 @@ static char const * short_option_map[128] = {
     ['o'] = "output",
     ['l'] = "language",
     ['i'] = "implementation",
+    ['j'] = "jobs",
 };
 
 static void move_arg_to_end(int argc, char ** argv, int index)
@@ -71,6 +78,14 @@ static enum OptionConsumption parse_option(struct CliOptions * out, char const *
         out->implementation = true;
         return IGNORE_VALUE;
     }
+    else if (apigen_streq(option, "no-docs")) {
+        out->no_docs = true;
+        return IGNORE_VALUE;
+    }
+    else if (apigen_streq(option, "memory-report")) {
+        out->memory_report = true;
+        return IGNORE_VALUE;
+    }
     else if (apigen_streq(option, "test-mode")) {
         if (value == NULL) {
             parse_option_error(option, "expects output file name");
@@ -120,6 +135,43 @@ static enum OptionConsumption parse_option(struct CliOptions * out, char const *
         }
         return CONSUME_VALUE;
     }
+    else if (apigen_streq(option, "jobs")) {
+        if (value == NULL) {
+            parse_option_error(option, "expects thread count");
+        }
+        char *              end   = NULL;
+        unsigned long const count = strtoul(value, &end, 10);
+        if ((*value == 0) || (*end != 0) || (count == 0) || (count > APIGEN_MAX_JOBS)) {
+            parse_option_error(option, "illegal thread count");
+        }
+        out->jobs = (uint32_t)count;
+        return CONSUME_VALUE;
+    }
+    else if (apigen_streq(option, "module-cache")) {
+        if (value == NULL) {
+            parse_option_error(option, "expects directory path");
+        }
+        out->module_cache = value;
+        return CONSUME_VALUE;
+    }
+    else if (apigen_streq(option, "arena")) {
+        if (value == NULL) {
+            parse_option_error(option, "expects arena mode");
+        }
+        else if (apigen_streq(value, "chunked")) {
+            out->arena_mode = ARENA_MODE_CHUNKED;
+        }
+        else if (apigen_streq(value, "reserve")) {
+            out->arena_mode = ARENA_MODE_RESERVE;
+        }
+        else if (apigen_streq(value, "reserve-huge")) {
+            out->arena_mode = ARENA_MODE_RESERVE_HUGE;
+        }
+        else {
+            parse_option_error(option, "unknown arena mode");
+        }
+        return CONSUME_VALUE;
+    }
     else {
         parse_option_error(option, "illegal option");
     }
@@ -138,6 +190,8 @@ struct CliOptions apigen_parse_options_or_exit(int argc, char ** argv)
         .positionals      = NULL,
         .output           = NULL,
         .help             = false,
+        .jobs             = 1,
+        .module_cache     = NULL,
     };
 
     int  index         = 1;
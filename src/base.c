@@ -194,3 +194,16 @@ bool apigen_open_input_from_cwd(struct apigen_ParserState * state, char const *
     return true;
 }
 
+bool apigen_open_module_cache_from_cwd(struct apigen_ParserState * state, char const * path, struct apigen_Directory * out_dir)
+{
+    if (path == NULL) {
+        return true;
+    }
+    if(!apigen_io_open_dir(apigen_io_cwd(), path, out_dir)) {
+        fprintf(stderr, "error: could not open module cache %s!\n", path);
+        return false;
+    }
+    state->module_cache = out_dir;
+    return true;
+}
+
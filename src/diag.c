@@ -1,11 +1,10 @@
 #include "apigen.h"
+#include "apigen-internals.h"
 
 #include <string.h>
 
 struct apigen_DiagnosticItem
 {
-    struct apigen_DiagnosticItem * next;
-
     enum apigen_DiagnosticCode code;
 
     char const * message;
@@ -45,6 +44,8 @@ static char const * get_diag_code_fmt_string(enum apigen_DiagnosticCode code)
     apigen_panic("Error code was not added to format list");
 }
 
+APIGEN_DEFINE_ARRAY_OPERATORS(apigen_DiagnosticItemArray, struct apigen_DiagnosticItem, diagnostic_items)
+
 void apigen_diagnostics_emit(
     struct apigen_Diagnostics * diags,
     char const *                file_name,
@@ -85,7 +86,9 @@ void apigen_diagnostics_vemit(
         APIGEN_ASSERT(formatted_message_len >= 0);
     }
 
-    char * const formatted_message = apigen_memory_arena_alloc(diags->arena, (size_t)(formatted_message_len + 1));
+    enum apigen_MemoryTag const previous_tag = apigen_memory_set_tag(APIGEN_MEMORY_TAG_DIAGNOSTICS);
+
+    char * const formatted_message = apigen_memory_arena_alloc_packed(diags->arena, (size_t)(formatted_message_len + 1));
     {
         va_list list;
         va_copy(list, src_list);
@@ -98,30 +101,28 @@ void apigen_diagnostics_vemit(
         formatted_message[formatted_message_len] = 0; // ensure NULL terminator
     }
 
-    struct apigen_DiagnosticItem * const item = apigen_memory_arena_alloc(diags->arena, sizeof(struct apigen_DiagnosticItem));
-    *item                                     = (struct apigen_DiagnosticItem){
-                                            .next = diags->items,
-
-                                            .code    = code,
-                                            .message = formatted_message,
-
-                                            .file_name = apigen_memory_arena_dupestr(diags->arena, file_name),
-                                            .line      = line_number,
-                                            .column    = column_number,
-    };
+    diagnostic_items_append(diags->arena, &diags->items, (struct apigen_DiagnosticItem){
+        .code    = code,
+        .message = formatted_message,
 
-    diags->items = item;
-    diags->item_count += 1;
+        .file_name = apigen_memory_arena_dupestr(diags->arena, file_name),
+        .line      = line_number,
+        .column    = column_number,
+    });
 
     diags->flags |= classify_diag_code(code);
+
+    apigen_memory_set_tag(previous_tag);
 }
 
 void apigen_diagnostics_render(struct apigen_Diagnostics const * diags, struct apigen_Stream stream)
 {
     APIGEN_NOT_NULL(diags);
 
-    struct apigen_DiagnosticItem const * iter = diags->items;
-    while (iter) {
+    // newest diagnostics are rendered first:
+    for (size_t i = diags->items.count; i > 0; i--) {
+        struct apigen_DiagnosticItem const * const iter = &diags->items.items[i - 1];
+
         char const * type_kind = NULL;
         switch (classify_diag_code(iter->code)) {
             case APIGEN_DIAGNOSTIC_FLAG_ERROR: type_kind = "error"; break;
@@ -140,31 +141,27 @@ void apigen_diagnostics_render(struct apigen_Diagnostics const * diags, struct a
             type_kind,
             (int)iter->code,
             iter->message);
-        iter = iter->next;
     }
 }
 
 bool apigen_diagnostics_remove_one(struct apigen_Diagnostics * diags, enum apigen_DiagnosticCode code)
+{
+    return apigen_diagnostics_remove_one_in(diags, code, NULL);
+}
+
+bool apigen_diagnostics_remove_one_in(struct apigen_Diagnostics * diags, enum apigen_DiagnosticCode code, char const * file_name)
 {
     APIGEN_NOT_NULL(diags);
 
-    struct apigen_DiagnosticItem * previous = NULL;
-    struct apigen_DiagnosticItem * iter     = diags->items;
-    while (iter) {
-        if (iter->code == code) {
-            if (previous != NULL) {
-                previous->next = iter->next;
-            }
-            if (iter == diags->items) {
-                diags->items = iter->next;
-            }
-            iter->next = NULL;
+    // remove the newest matching diagnostic:
+    for (size_t i = diags->items.count; i > 0; i--) {
+        struct apigen_DiagnosticItem * const item = &diags->items.items[i - 1];
+        if (item->code == code && (file_name == NULL || apigen_streq(item->file_name, file_name))) {
+            size_t const tail_count = diags->items.count - i;
+            memmove(item, item + 1, tail_count * sizeof(struct apigen_DiagnosticItem));
+            diags->items.count -= 1;
             return true;
         }
-        else {
-            previous = iter;
-            iter     = iter->next;
-        }
     }
     return false;
 }
@@ -173,7 +170,7 @@ bool apigen_diagnostics_has_any(struct apigen_Diagnostics const * diags)
 {
     APIGEN_NOT_NULL(diags);
 
-    return (diags->items != 0);
+    return (diags->items.count != 0);
 }
 
 void apigen_diagnostics_init(struct apigen_Diagnostics * diags, struct apigen_MemoryArena * arena)
@@ -188,5 +185,36 @@ void apigen_diagnostics_init(struct apigen_Diagnostics * diags, struct apigen_Me
 void apigen_diagnostics_deinit(struct apigen_Diagnostics * diags)
 {
     APIGEN_NOT_NULL(diags);
-    memset(diags, 0xAA, sizeof(struct apigen_Diagnostics));
+    APIGEN_POISON_FILL(diags, sizeof(struct apigen_Diagnostics));
+}
+
+void apigen_diagnostics_merge(struct apigen_Diagnostics * diags, struct apigen_Diagnostics const * other)
+{
+    APIGEN_NOT_NULL(other);
+
+    apigen_diagnostics_merge_range(diags, other, 0, other->items.count, NULL);
+}
+
+void apigen_diagnostics_merge_range(struct apigen_Diagnostics * diags, struct apigen_Diagnostics const * other, size_t first, size_t count, char const * file_name)
+{
+    APIGEN_NOT_NULL(diags);
+    APIGEN_NOT_NULL(other);
+    APIGEN_ASSERT(first <= other->items.count && count <= other->items.count - first);
+
+    enum apigen_MemoryTag const previous_tag = apigen_memory_set_tag(APIGEN_MEMORY_TAG_DIAGNOSTICS);
+
+    for (size_t i = first; i < first + count; i++) {
+        struct apigen_DiagnosticItem const * const item = &other->items.items[i];
+        diagnostic_items_append(diags->arena, &diags->items, (struct apigen_DiagnosticItem){
+            .code    = item->code,
+            .message = apigen_memory_arena_dupestr(diags->arena, item->message),
+
+            .file_name = apigen_memory_arena_dupestr(diags->arena, (file_name != NULL) ? file_name : item->file_name),
+            .line      = item->line,
+            .column    = item->column,
+        });
+        diags->flags |= classify_diag_code(item->code);
+    }
+
+    apigen_memory_set_tag(previous_tag);
 }
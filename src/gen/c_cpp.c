@@ -1,5 +1,6 @@
 #include "apigen.h"
 
+#include <stdalign.h>
 #include <string.h>
 #include <inttypes.h>
 #include <ctype.h>
@@ -437,13 +438,6 @@ static void render_declaration(struct apigen_Stream const stream, enum Declarati
     render_type_suffix(stream, type, render_mode, indent);
 }
 
-struct TypeDeclSpec
-{
-    struct apigen_Type const * type;
-    bool requires_forward_decl;
-    struct TypeOrderDependency * dependencies;
-};
-
 enum DependencyType {
     DEP_HARD = 0,
     DEP_WEAK = 1,
@@ -453,15 +447,24 @@ struct TypeOrderDependency
 {
     enum DependencyType weakness; // if weak, can be forward-declared, otherwise requries hard decl
     struct apigen_Type const * type;
-    struct TypeOrderDependency * next;
+};
+
+APIGEN_DECLARE_ARRAY(TypeOrderDependencyArray, struct TypeOrderDependency);
+APIGEN_DEFINE_ARRAY_OPERATORS(TypeOrderDependencyArray, struct TypeOrderDependency, type_order_dependencies)
+
+struct TypeDeclSpec
+{
+    struct apigen_Type const * type;
+    bool requires_forward_decl;
+    struct TypeOrderDependencyArray dependencies;
 };
 
 static void add_type_dependency(struct apigen_MemoryArena * const arena, struct TypeDeclSpec * const container, struct apigen_Type const * const type, enum DependencyType dep_type)
 {
     { // deduplicate or reduce weakness if possible:
 
-        struct TypeOrderDependency * iter = container->dependencies;
-        while(iter != NULL) {
+        for(size_t i = 0; i < container->dependencies.count; i++) {
+            struct TypeOrderDependency * const iter = &container->dependencies.items[i];
             if(iter->type == type) {
                 if(iter->weakness > dep_type) {
                     // reference isn't weak, ensure we actually have a non-weak dependency added:
@@ -469,17 +472,13 @@ static void add_type_dependency(struct apigen_MemoryArena * const arena, struct
                 }
                 return;
             }
-            iter = iter->next;
         }
     }
 
-    struct TypeOrderDependency * const dep = apigen_memory_arena_alloc(arena, sizeof(struct TypeOrderDependency));
-    *dep = (struct TypeOrderDependency) {
+    type_order_dependencies_append(arena, &container->dependencies, (struct TypeOrderDependency) {
         .weakness = dep_type,
         .type = type,
-        .next = container->dependencies,
-    };
-    container->dependencies = dep;
+    });
 }
 
 static void fetch_dependencies(struct apigen_MemoryArena * const arena, struct TypeDeclSpec * const container, struct apigen_Type const * const type, bool top_level, enum DependencyType dep_weakness)
@@ -637,7 +636,7 @@ static struct TypeDeclSpec * create_type_order_map(struct apigen_MemoryArena * c
     APIGEN_NOT_NULL(document);
 
     size_t const array_len = document->type_count;
-    struct TypeDeclSpec * const array = apigen_memory_arena_alloc(arena, document->type_count * sizeof(struct TypeDeclSpec));
+    struct TypeDeclSpec * const array = apigen_memory_arena_alloc_aligned(arena, document->type_count * sizeof(struct TypeDeclSpec), alignof(struct TypeDeclSpec));
 
     // Phase 1: collect all dependencies:
     for(size_t i = 0; i < array_len; i++)
@@ -645,7 +644,7 @@ static struct TypeDeclSpec * create_type_order_map(struct apigen_MemoryArena * c
         array[i] = (struct TypeDeclSpec) {
             .type = document->types[i],
             .requires_forward_decl = false,
-            .dependencies = NULL,
+            .dependencies = { 0 },
         };
         fetch_dependencies(arena, &array[i], array[i].type, true, DEP_HARD);
     }
@@ -659,9 +658,9 @@ static struct TypeDeclSpec * create_type_order_map(struct apigen_MemoryArena * c
             size_t dep_first = (array_len - 1);
             size_t dep_last  = 0;
             {
-                struct TypeOrderDependency const * iter = item.dependencies;
-                while(iter != NULL)
+                for(size_t i = 0; i < item.dependencies.count; i++)
                 {
+                    struct TypeOrderDependency const * const iter = &item.dependencies.items[i];
                     if(iter->weakness == DEP_HARD) {
                         bool found = false;
                         for(size_t j = 0; !found && (j < array_len); j++) {
@@ -673,12 +672,11 @@ static struct TypeDeclSpec * create_type_order_map(struct apigen_MemoryArena * c
                         }
                         APIGEN_ASSERT(found); // all dependencies MUST be resolvable, otherwise it's a bug in the analyzer phase
                     }
-                    iter = iter->next;
                 }
             }
             APIGEN_ASSERT((dep_first >= 0) && (dep_first < array_len));
             APIGEN_ASSERT((dep_last >= 0) && (dep_last < array_len));
-            bool const deps_ok = (item.dependencies == NULL) || (dep_last < index);
+            bool const deps_ok = (item.dependencies.count == 0) || (dep_last < index);
 
             // fprintf(stderr, "[%3zu] range: [%3zu,%3zu] deps for %s are %s\n", index, dep_first, dep_last, item.type->name, deps_ok ? "ok" : "bad");
 
@@ -700,9 +698,9 @@ static struct TypeDeclSpec * create_type_order_map(struct apigen_MemoryArena * c
     {
         struct TypeDeclSpec const item = array[index];
 
-        struct TypeOrderDependency const * iter = item.dependencies;
-        while(iter != NULL)
+        for(size_t i = 0; i < item.dependencies.count; i++)
         {
+            struct TypeOrderDependency const * const iter = &item.dependencies.items[i];
             if(iter->weakness == DEP_WEAK) {
                 for(size_t j = index + 1; (j < array_len); j++) {
                     if(array[j].type == iter->type) {
@@ -710,7 +708,6 @@ static struct TypeDeclSpec * create_type_order_map(struct apigen_MemoryArena * c
                     }
                 }
             }
-            iter = iter->next;
         }
     }
 
@@ -738,6 +735,9 @@ bool apigen_render_c(struct apigen_Stream const stream, struct apigen_MemoryAren
         "\n"
     );
 
+    // The type order map is only required while rendering, so release it afterwards:
+    struct apigen_MemoryArenaMark const scratch_mark = apigen_memory_arena_mark(arena);
+
     struct TypeDeclSpec const * const ordered_types = create_type_order_map(arena, document);
 
     // Phase 1: Render necessary forward declarations
@@ -834,6 +834,8 @@ bool apigen_render_c(struct apigen_Stream const stream, struct apigen_MemoryAren
         "\n"
     );
 
+    apigen_memory_arena_rewind(arena, scratch_mark);
+
     return true;
 }
 
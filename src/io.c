@@ -1,6 +1,8 @@
 #define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS
 
 #include "apigen.h"
+#include "apigen-internals.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -80,7 +82,7 @@ void apigen_io_close(struct apigen_Stream * stream)
     if(stream->close != NULL) {
         stream->close(stream->context);
     }
-    memset(stream, 0xAA, sizeof *stream);
+    APIGEN_POISON_FILL(stream, sizeof *stream);
 }
 
 struct apigen_Stream const apigen_io_stdout = {.write = apigen_io_writeStdOut};
@@ -100,6 +102,25 @@ size_t apigen_io_read(struct apigen_Stream stream, char * data, size_t length)
     return stream.read(stream.context, data, length);
 }
 
+char * apigen_io_map(struct apigen_Stream stream, size_t * out_length)
+{
+    APIGEN_NOT_NULL(out_length);
+    if(stream.read == NULL) apigen_panic("apigen_io_map() on write-only stream called.");
+    if(stream.map == NULL) {
+        return NULL;
+    }
+    return stream.map(stream.context, out_length);
+}
+
+bool apigen_io_identify(struct apigen_Stream stream, struct apigen_FileId * out_id)
+{
+    APIGEN_NOT_NULL(out_id);
+    if(stream.identify == NULL) {
+        return false;
+    }
+    return stream.identify(stream.context, out_id);
+}
+
 void apigen_io_print(struct apigen_Stream stream, char const * data)
 {
     apigen_io_write(stream, data, strlen(data));
@@ -118,21 +139,27 @@ void apigen_io_vprintf(struct apigen_Stream stream, char const * format, va_list
 {
     char fixed_buffer[1024];
 
+    // `list` is consumed by each vsnprintf() call, so keep a copy for the second attempt:
+    va_list retry_list;
+    va_copy(retry_list, list);
+
     int const top_res = vsnprintf(fixed_buffer, sizeof fixed_buffer, format, list);
-    if (top_res >= 0) {
+    APIGEN_ASSERT(top_res >= 0);
+    if ((size_t)top_res < sizeof fixed_buffer) {
+        va_end(retry_list);
         apigen_io_write(stream, fixed_buffer, (size_t)top_res);
         return;
     }
 
-    int const dynamic_length = vsnprintf(NULL, 0, format, list);
-    APIGEN_ASSERT(dynamic_length >= 0);
+    size_t const dynamic_length = (size_t)top_res;
 
-    char * const dynamic_buffer = apigen_alloc((size_t)dynamic_length);
+    char * const dynamic_buffer = apigen_alloc(dynamic_length + 1);
 
-    int const length = vsnprintf(dynamic_buffer, (size_t)dynamic_length, format, list);
-    APIGEN_ASSERT(length == dynamic_length);
+    int const length = vsnprintf(dynamic_buffer, dynamic_length + 1, format, retry_list);
+    va_end(retry_list);
+    APIGEN_ASSERT(length == top_res);
 
-    apigen_io_write(stream, dynamic_buffer, (size_t)length);
+    apigen_io_write(stream, dynamic_buffer, dynamic_length);
 
     apigen_free(dynamic_buffer);
 }
@@ -142,15 +169,31 @@ void apigen_io_vprintf(struct apigen_Stream stream, char const * format, va_list
 #else
 // posix api will work the same everywhere:
 
+#include <errno.h>
+#include <limits.h>
+#include <stdatomic.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 
 typedef intptr_t fd_t;
 
+/// Context of files opened for reading. The file is either read with `read()`,
+/// or mapped as a whole into memory.
+struct PosixInputFile
+{
+    fd_t   fd;
+    char * mapping;      ///< `NULL` until the file was mapped
+    size_t mapping_size; ///< size of the mapping, including the zero padding
+    size_t file_size;
+    size_t read_offset;  ///< read position inside `mapping`
+};
+
 static bool posix_dir_openFile(void * context, enum apigen_FileMode mode, char const * file_name, struct apigen_Stream * out_stream);
 static bool posix_dir_openDir(void * context, char const * file_name, struct apigen_Directory * out_dir);
+static bool posix_dir_replaceFile(void * context, char const * file_name, char const * data, size_t length);
 static void posix_fd_write(void * context, char const * data, size_t length);
 static void posix_fd_close(void * context);
 
@@ -172,10 +215,8 @@ static void posix_fd_write(void * context, char const * data, size_t length)
     }
 }
 
-static size_t posix_fd_read(void * context, char * data, size_t length)
+static size_t posix_fd_read(fd_t const file_fd, char * data, size_t length)
 {
-    fd_t const file_fd = (fd_t)context;
-
     size_t offset = 0;
     while(offset < length) {
         ssize_t len = read(file_fd, data + offset, length - offset);
@@ -191,6 +232,83 @@ static size_t posix_fd_read(void * context, char * data, size_t length)
     return offset;
 }
 
+static size_t posix_input_read(void * context, char * data, size_t length)
+{
+    struct PosixInputFile * const file = context;
+
+    if(file->mapping == NULL) {
+        return posix_fd_read(file->fd, data, length);
+    }
+
+    size_t const count = (length < file->file_size - file->read_offset) ? length : (file->file_size - file->read_offset);
+    memcpy(data, file->mapping + file->read_offset, count);
+    file->read_offset += count;
+    return count;
+}
+
+static char * posix_input_map(void * context, size_t * out_length)
+{
+    struct PosixInputFile * const file = context;
+
+    if(file->mapping == NULL) {
+        struct stat info;
+        if(fstat(file->fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+            return NULL;
+        }
+        size_t const file_size = (size_t)info.st_size;
+        size_t const page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+        // Reserve zeroed memory with room for the two terminating zero bytes, then map the file over it.
+        // Everything behind the end of the file reads as zero, either from the last file page or from the
+        // anonymous pages behind it:
+        size_t const mapping_size = (file_size + 2 + page_size - 1) & ~(page_size - 1);
+
+        char * const mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(mapping == MAP_FAILED) {
+            return NULL;
+        }
+        if(file_size > 0) {
+            if(mmap(mapping, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, (int)file->fd, 0) == MAP_FAILED) {
+                munmap(mapping, mapping_size);
+                return NULL;
+            }
+        }
+
+        file->mapping      = mapping;
+        file->mapping_size = mapping_size;
+        file->file_size    = file_size;
+        file->read_offset  = 0;
+    }
+
+    *out_length = file->file_size;
+    return file->mapping;
+}
+
+static bool posix_input_identify(void * context, struct apigen_FileId * out_id)
+{
+    struct PosixInputFile * const file = context;
+
+    struct stat info;
+    if(fstat(file->fd, &info) != 0) {
+        return false;
+    }
+    *out_id = (struct apigen_FileId) {
+        .device = (uint64_t)info.st_dev,
+        .inode  = (uint64_t)info.st_ino,
+    };
+    return true;
+}
+
+static void posix_input_close(void * context)
+{
+    struct PosixInputFile * const file = context;
+    if(file->mapping != NULL) {
+        munmap(file->mapping, file->mapping_size);
+    }
+    close(file->fd);
+    apigen_free(file);
+}
+
 static bool posix_dir_openFile(void * context, enum apigen_FileMode mode, char const * file_name, struct apigen_Stream * out_dir)
 {
     fd_t const dir_fd = (fd_t)context;
@@ -206,15 +324,31 @@ static bool posix_dir_openFile(void * context, enum apigen_FileMode mode, char c
 
     fd_t const file_fd = openat(dir_fd, file_name, flags, 0);
     if(file_fd == -1) {
-        perror("failed to open file");
+        if(mode != APIGEN_IO_INPUT_OPTIONAL || errno != ENOENT) {
+            perror("failed to open file");
+        }
         return false;
     }
-    *out_dir = (struct apigen_Stream) {
-        .context = (void*)file_fd,
-        .write = (mode == APIGEN_IO_OUTPUT) ? posix_fd_write : NULL,
-        .read  = (mode == APIGEN_IO_INPUT)  ? posix_fd_read : NULL,
-        .close = posix_fd_close,
-    };
+    if(mode == APIGEN_IO_OUTPUT) {
+        *out_dir = (struct apigen_Stream) {
+            .context = (void*)file_fd,
+            .write = posix_fd_write,
+            .close = posix_fd_close,
+        };
+    }
+    else {
+        struct PosixInputFile * const file = apigen_alloc(sizeof(struct PosixInputFile));
+        *file = (struct PosixInputFile) {
+            .fd = file_fd,
+        };
+        *out_dir = (struct apigen_Stream) {
+            .context  = file,
+            .read     = posix_input_read,
+            .map      = posix_input_map,
+            .identify = posix_input_identify,
+            .close    = posix_input_close,
+        };
+    }
     return true;
 }
 
@@ -231,11 +365,49 @@ static bool posix_dir_openDir(void * context, char const * file_name, struct api
         .context = (void*)subdir_fd,
         .openFile = posix_dir_openFile,
         .openDir = posix_dir_openDir,
+        .replaceFile = posix_dir_replaceFile,
         .close = posix_fd_close,
     };
     return true;
 }
 
+static bool posix_dir_replaceFile(void * context, char const * file_name, char const * data, size_t length)
+{
+    fd_t const dir_fd = (fd_t)context;
+
+    // The data is written to a temporary file that is then renamed over the target.
+    // The name must be unique between processes and threads that replace the same file:
+    static atomic_uint temp_counter = 0;
+
+    char temp_name[PATH_MAX];
+    int const temp_name_len = snprintf(temp_name, sizeof temp_name, "%s.%ld-%u.tmp", file_name, (long)getpid(), atomic_fetch_add(&temp_counter, 1));
+    if(temp_name_len < 0 || (size_t)temp_name_len >= sizeof temp_name) {
+        return false;
+    }
+
+    int const file_fd = openat(dir_fd, temp_name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if(file_fd == -1) {
+        return false;
+    }
+
+    bool ok = true;
+    size_t offset = 0;
+    while(ok && offset < length) {
+        ssize_t const len = write(file_fd, data + offset, length - offset);
+        ok = (len > 0);
+        if(ok) {
+            offset += (size_t)len;
+        }
+    }
+    ok = (close(file_fd) == 0) && ok;
+    ok = ok && (renameat(dir_fd, temp_name, dir_fd, file_name) == 0);
+
+    if(!ok) {
+        unlinkat(dir_fd, temp_name, 0);
+    }
+    return ok;
+}
+
 static void posix_fd_close(void * context)
 {
     fd_t const fd = (fd_t)context;
@@ -249,6 +421,7 @@ struct apigen_Directory apigen_io_cwd(void)
         .context = (void*)AT_FDCWD,
         .openFile = posix_dir_openFile,
         .openDir = posix_dir_openDir,
+        .replaceFile = posix_dir_replaceFile,
         .close = NULL, // CWD isn't closable
     };
 }
@@ -263,6 +436,14 @@ bool apigen_io_open_file_read(struct apigen_Directory parent, char const * path,
     return parent.openFile(parent.context, APIGEN_IO_INPUT, path, out_stream);
 }
 
+bool apigen_io_open_file_read_optional(struct apigen_Directory parent, char const * path, struct apigen_Stream * out_stream)
+{
+    if(parent.openFile == NULL) {
+        return false;
+    }
+    return parent.openFile(parent.context, APIGEN_IO_INPUT_OPTIONAL, path, out_stream);
+}
+
 bool apigen_io_open_file_write(struct apigen_Directory parent, char const * path, struct apigen_Stream * out_stream)
 {
     if(parent.openFile == NULL) {
@@ -279,13 +460,21 @@ bool apigen_io_open_dir(struct apigen_Directory parent, char const * path, struc
     return parent.openDir(parent.context, path, out_dir);
 }
 
+bool apigen_io_replace_file(struct apigen_Directory dir, char const * path, char const * data, size_t length)
+{
+    if(dir.replaceFile == NULL) {
+        return false;
+    }
+    return dir.replaceFile(dir.context, path, data, length);
+}
+
 void apigen_io_close_dir(struct apigen_Directory * dir)
 {
     APIGEN_NOT_NULL(dir);
     if(dir->close != NULL) {
         dir->close(dir->context);
     }
-    memset(dir, 0xAA, sizeof *dir);
+    APIGEN_POISON_FILL(dir, sizeof *dir);
 }
 
 
@@ -1,10 +1,29 @@
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS, MAP_NORESERVE, madvise
+
 #include "apigen.h"
 #include "apigen-internals.h"
 
 #include <stdalign.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if !defined(__WIN32__)
+#include <sys/mman.h>
+#endif
+
+#if APIGEN_MEMORY_POISON == APIGEN_MEMORY_POISON_ASAN
+#include <sanitizer/asan_interface.h>
+
+// Unused arena memory is marked as inaccessible, so overruns into chunk slack or
+// alignment padding are reported by AddressSanitizer:
+#define ARENA_POISON(_Ptr, _Size)   ASAN_POISON_MEMORY_REGION((_Ptr), (_Size))
+#define ARENA_UNPOISON(_Ptr, _Size) ASAN_UNPOISON_MEMORY_REGION((_Ptr), (_Size))
+#else
+#define ARENA_POISON(_Ptr, _Size)   ((void)(_Ptr), (void)(_Size))
+#define ARENA_UNPOISON(_Ptr, _Size) ((void)(_Ptr), (void)(_Size))
+#endif
+
 // implementation detail:
 extern void * (*apigen_memory_alloc_backend)(size_t);
 extern void (*apigen_memory_free_backend)(void *);
@@ -14,6 +33,11 @@ static size_t maxSize(size_t a, size_t b)
     return (a > b) ? a : b;
 }
 
+static size_t minSize(size_t a, size_t b)
+{
+    return (a < b) ? a : b;
+}
+
 static bool isAligned(uintptr_t addr, size_t const alignment)
 {
     APIGEN_ASSERT((alignment & (alignment - 1)) == 0);
@@ -34,29 +58,224 @@ static size_t alignSizeForward(size_t const original_size)
     return aligned_size;
 }
 
+/// Chunks are linked in creation order through `next`, and chunks that
+/// still have a usable tail are additionally linked through `next_partial`.
+/// The usable memory of a chunk directly follows its header.
+/// Aligned allocations grow from the start of the usable memory, packed
+/// allocations (strings) grow down from its end, so they never require padding.
 struct apigen_MemoryArenaChunk
 {
-    char *                           memory;
-    size_t                           size;
     struct apigen_MemoryArenaChunk * next;
+    struct apigen_MemoryArenaChunk * next_partial;
+    size_t                           size;   ///< usable bytes behind the header
+    size_t                           used;   ///< bytes handed out from the start of the usable memory
+    size_t                           packed; ///< bytes handed out from the end of the usable memory
 };
 
+/// Size of the first chunk, every following chunk is twice as large as its predecessor
+/// until `apigen_MemoryArena.max_chunk_size` is reached.
+static size_t const ARENA_INITIAL_CHUNK_SIZE = 1024;
+
+/// Default upper limit for the geometric chunk growth.
+static size_t const ARENA_DEFAULT_MAX_CHUNK_SIZE = 1024 * 1024;
+
+/// Chunks with a smaller tail than this are not worth to be remembered in the partial list.
+static size_t const ARENA_MIN_PARTIAL_TAIL = 64;
+
+/// Upper limit for the length of the partial list, which is searched on every allocation
+/// that does not fit into the last chunk. Only the largest tails are kept.
+/// Marks save the position of every listed tail, so rewinding can release allocations from them.
+static size_t const ARENA_MAX_PARTIAL_CHUNKS = APIGEN_MEMORY_ARENA_MAX_PARTIAL_CHUNKS;
+
+/// Reserved arenas commit their memory in steps of this size. This is a multiple of
+/// all common page sizes, including 2 MiB huge pages.
+static size_t const ARENA_RESERVE_COMMIT_STEP = 2 * 1024 * 1024;
+
+static char * chunk_memory(struct apigen_MemoryArenaChunk * chunk)
+{
+    return ((char *)chunk) + alignSizeForward(sizeof(struct apigen_MemoryArenaChunk));
+}
+
+static size_t chunk_remaining(struct apigen_MemoryArenaChunk const * chunk)
+{
+    APIGEN_ASSERT(chunk->used + chunk->packed <= chunk->size);
+    return chunk->size - chunk->used - chunk->packed;
+}
+
+/// Returns the chunk memory to the heap, unused chunk memory is poisoned for ASan and must be unpoisoned first.
+static void free_chunk(struct apigen_MemoryArenaChunk * chunk)
+{
+    ARENA_UNPOISON(chunk_memory(chunk), chunk->size);
+    apigen_free(chunk);
+}
+
+/// Poisons a region of chunk memory that was handed out before and is now unused again.
+static void release_region(char * region, size_t size)
+{
+    ARENA_UNPOISON(region, size); // alignment padding inside the region is still poisoned
+    APIGEN_POISON_FILL(region, size);
+    ARENA_POISON(region, size);
+}
+
 void * (*apigen_memory_alloc_backend)(size_t) = malloc;
 void (*apigen_memory_free_backend)(void *)    = free;
 
+// memory profiler:
+
+static _Thread_local enum apigen_MemoryTag current_memory_tag = APIGEN_MEMORY_TAG_OTHER;
+
+/// Heap statistics are only kept after `apigen_memory_enable_stats`, as every thread has to update them.
+static bool memory_stats_enabled = false;
+
+/// The shared counters of `apigen_MemoryTagStats`, heap memory may be released by another thread than the one that allocated it.
+struct SharedTagStats
+{
+    atomic_size_t heap_allocs;
+    atomic_size_t heap_current;
+    atomic_size_t heap_peak;
+    atomic_size_t arena_allocs;
+    atomic_size_t arena_requested;
+    atomic_size_t arena_padding;
+    atomic_size_t arena_chunks;
+};
+
+static struct SharedTagStats memory_tag_stats[APIGEN_MEMORY_TAG_COUNT];
+
+static atomic_size_t memory_heap_current;
+static atomic_size_t memory_heap_peak;
+
+/// Arena allocations are too frequent to share counters, so their statistics are counted per thread
+/// and only added to `memory_tag_stats` by `apigen_memory_flush_thread_stats`.
+static _Thread_local struct apigen_MemoryTagStats thread_tag_stats[APIGEN_MEMORY_TAG_COUNT];
+
+static void atomic_max_size(atomic_size_t * peak, size_t value)
+{
+    size_t current = atomic_load_explicit(peak, memory_order_relaxed);
+    while (current < value && !atomic_compare_exchange_weak_explicit(peak, &current, value, memory_order_relaxed, memory_order_relaxed)) {
+        // `current` was reloaded, try again
+    }
+}
+
+void apigen_memory_enable_stats(void)
+{
+    memory_stats_enabled = true;
+}
+
+enum apigen_MemoryTag apigen_memory_set_tag(enum apigen_MemoryTag tag)
+{
+    APIGEN_ASSERT(tag < APIGEN_MEMORY_TAG_COUNT);
+    enum apigen_MemoryTag const previous = current_memory_tag;
+    current_memory_tag                   = tag;
+    return previous;
+}
+
+char const * apigen_memory_tag_name(enum apigen_MemoryTag tag)
+{
+    switch (tag) {
+        case APIGEN_MEMORY_TAG_OTHER:       return "other";
+        case APIGEN_MEMORY_TAG_LEXER:       return "lexer";
+        case APIGEN_MEMORY_TAG_PARSER:      return "parser";
+        case APIGEN_MEMORY_TAG_ANALYZER:    return "analyzer";
+        case APIGEN_MEMORY_TAG_DIAGNOSTICS: return "diagnostics";
+        case APIGEN_MEMORY_TAG_BACKEND:     return "backend";
+        case APIGEN_MEMORY_TAG_COUNT:       break;
+    }
+    APIGEN_UNREACHABLE();
+}
+
+struct apigen_MemoryTagStats apigen_memory_get_stats(enum apigen_MemoryTag tag)
+{
+    APIGEN_ASSERT(tag < APIGEN_MEMORY_TAG_COUNT);
+
+    struct SharedTagStats * const shared = &memory_tag_stats[tag];
+
+    struct apigen_MemoryTagStats stats = {
+        .heap_allocs     = atomic_load_explicit(&shared->heap_allocs, memory_order_relaxed),
+        .heap_current    = atomic_load_explicit(&shared->heap_current, memory_order_relaxed),
+        .heap_peak       = atomic_load_explicit(&shared->heap_peak, memory_order_relaxed),
+        .arena_allocs    = atomic_load_explicit(&shared->arena_allocs, memory_order_relaxed),
+        .arena_requested = atomic_load_explicit(&shared->arena_requested, memory_order_relaxed),
+        .arena_padding   = atomic_load_explicit(&shared->arena_padding, memory_order_relaxed),
+        .arena_chunks    = atomic_load_explicit(&shared->arena_chunks, memory_order_relaxed),
+    };
+
+    struct apigen_MemoryTagStats const * const local = &thread_tag_stats[tag];
+    stats.arena_allocs += local->arena_allocs;
+    stats.arena_requested += local->arena_requested;
+    stats.arena_padding += local->arena_padding;
+    stats.arena_chunks += local->arena_chunks;
+    return stats;
+}
+
+void apigen_memory_flush_thread_stats(void)
+{
+    for (size_t i = 0; i < APIGEN_MEMORY_TAG_COUNT; i++) {
+        struct apigen_MemoryTagStats * const local = &thread_tag_stats[i];
+        atomic_fetch_add_explicit(&memory_tag_stats[i].arena_allocs, local->arena_allocs, memory_order_relaxed);
+        atomic_fetch_add_explicit(&memory_tag_stats[i].arena_requested, local->arena_requested, memory_order_relaxed);
+        atomic_fetch_add_explicit(&memory_tag_stats[i].arena_padding, local->arena_padding, memory_order_relaxed);
+        atomic_fetch_add_explicit(&memory_tag_stats[i].arena_chunks, local->arena_chunks, memory_order_relaxed);
+        *local = (struct apigen_MemoryTagStats){0};
+    }
+}
+
+/// Every heap allocation is prefixed with this header, so `apigen_free` can
+/// account the released bytes to the tag that allocated them.
+struct HeapAllocHeader
+{
+    size_t                size;
+    enum apigen_MemoryTag tag;
+    bool                  counted; ///< statistics were enabled when the memory was allocated
+};
+
 void * apigen_alloc(size_t size)
 {
-    void * ptr = apigen_memory_alloc_backend(size);
-    if (ptr == NULL)
+    size_t const header_size = alignSizeForward(sizeof(struct HeapAllocHeader));
+
+    char * const base = apigen_memory_alloc_backend(header_size + size);
+    if (base == NULL)
         apigen_panic("out of memory");
-    APIGEN_ASSERT(isAddrAligned(ptr, alignof(max_align_t)));
-    memset(ptr, 0xAA, size);
+    APIGEN_ASSERT(isAddrAligned(base, alignof(max_align_t)));
+
+    *(struct HeapAllocHeader *)base = (struct HeapAllocHeader){
+        .size    = size,
+        .tag     = current_memory_tag,
+        .counted = memory_stats_enabled,
+    };
+
+    if (memory_stats_enabled) {
+        struct SharedTagStats * const stats = &memory_tag_stats[current_memory_tag];
+        atomic_fetch_add_explicit(&stats->heap_allocs, 1, memory_order_relaxed);
+        atomic_max_size(&stats->heap_peak, atomic_fetch_add_explicit(&stats->heap_current, size, memory_order_relaxed) + size);
+        atomic_max_size(&memory_heap_peak, atomic_fetch_add_explicit(&memory_heap_current, size, memory_order_relaxed) + size);
+    }
+
+    void * const ptr = base + header_size;
+    APIGEN_POISON_FILL(ptr, size);
     return ptr;
 }
 
 void apigen_free(void * ptr)
 {
-    apigen_memory_free_backend(ptr);
+    if (ptr == NULL) {
+        return;
+    }
+
+    size_t const header_size = alignSizeForward(sizeof(struct HeapAllocHeader));
+
+    char * const                          base   = (char *)ptr - header_size;
+    struct HeapAllocHeader const * const header = (struct HeapAllocHeader const *)base;
+    APIGEN_ASSERT(header->tag < APIGEN_MEMORY_TAG_COUNT);
+
+    if (header->counted) {
+        size_t const previous = atomic_fetch_sub_explicit(&memory_tag_stats[header->tag].heap_current, header->size, memory_order_relaxed);
+        APIGEN_ASSERT(previous >= header->size);
+        atomic_fetch_sub_explicit(&memory_heap_current, header->size, memory_order_relaxed);
+    }
+
+    APIGEN_POISON_FILL(ptr, header->size);
+
+    apigen_memory_free_backend(base);
 }
 
 // arena APIs:
@@ -64,74 +283,391 @@ void apigen_free(void * ptr)
 void apigen_memory_arena_init(struct apigen_MemoryArena * arena)
 {
     *arena = (struct apigen_MemoryArena){
-        .first_chunk = NULL,
-        .last_chunk  = NULL,
-        .chunk_size  = 1024,
+        .first_chunk     = NULL,
+        .last_chunk      = NULL,
+        .partial_chunks  = NULL,
+        .chunk_size      = ARENA_INITIAL_CHUNK_SIZE,
+        .max_chunk_size  = ARENA_DEFAULT_MAX_CHUNK_SIZE,
+        .reserved_size   = 0,
+        .committed_front = 0,
+        .committed_back  = 0,
+        .adopted_chunks  = NULL,
     };
 }
 
-void apigen_memory_arena_deinit(struct apigen_MemoryArena * arena)
+#if !defined(__WIN32__)
+
+bool apigen_memory_arena_init_reserved(struct apigen_MemoryArena * arena, size_t reserve_size, bool use_huge_pages)
+{
+    APIGEN_NOT_NULL(arena);
+
+    size_t const header_size = alignSizeForward(sizeof(struct apigen_MemoryArenaChunk));
+
+    reserve_size = (reserve_size + ARENA_RESERVE_COMMIT_STEP - 1) & ~(ARENA_RESERVE_COMMIT_STEP - 1);
+    if (reserve_size < ARENA_RESERVE_COMMIT_STEP) {
+        return false;
+    }
+
+    void * const base = mmap(NULL, reserve_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+
+#if defined(MADV_HUGEPAGE)
+    if (use_huge_pages) {
+        // this is only a hint, so failure is not an error:
+        (void)madvise(base, reserve_size, MADV_HUGEPAGE);
+    }
+#else
+    (void)use_huge_pages;
+#endif
+
+    if (mprotect(base, ARENA_RESERVE_COMMIT_STEP, PROT_READ | PROT_WRITE) != 0) {
+        munmap(base, reserve_size);
+        return false;
+    }
+
+    // The whole reservation is a single chunk, so allocations are a contiguous bump
+    // and rewinding/resetting works without any special casing:
+    struct apigen_MemoryArenaChunk * const chunk = base;
+    *chunk                                       = (struct apigen_MemoryArenaChunk){
+        .next         = NULL,
+        .next_partial = NULL,
+        .size         = reserve_size - header_size,
+        .used         = 0,
+        .packed       = 0,
+    };
+    // only the committed part is poisoned here, the rest is poisoned when committed:
+    ARENA_POISON(chunk_memory(chunk), ARENA_RESERVE_COMMIT_STEP - header_size);
+
+    thread_tag_stats[current_memory_tag].arena_chunks += ARENA_RESERVE_COMMIT_STEP;
+
+    *arena = (struct apigen_MemoryArena){
+        .first_chunk     = chunk,
+        .last_chunk      = chunk,
+        .partial_chunks  = NULL,
+        .chunk_size      = 0,
+        .max_chunk_size  = 0,
+        .reserved_size   = reserve_size,
+        .committed_front = ARENA_RESERVE_COMMIT_STEP,
+        .committed_back  = 0,
+        .adopted_chunks  = NULL,
+    };
+
+    return true;
+}
+
+/// Makes sure that all memory handed out by the reservation of `arena` is readable and writable.
+static void reservation_commit(struct apigen_MemoryArena * arena)
+{
+    struct apigen_MemoryArenaChunk * const chunk = arena->first_chunk;
+
+    char * const base        = (char *)chunk;
+    size_t const header_size = alignSizeForward(sizeof(struct apigen_MemoryArenaChunk));
+    size_t const step_mask   = ARENA_RESERVE_COMMIT_STEP - 1;
+
+    size_t const required_front = (header_size + chunk->used + step_mask) & ~step_mask;
+    size_t const required_back  = (chunk->packed + step_mask) & ~step_mask;
+
+    if (required_front > arena->committed_front) {
+        size_t const new_front = minSize(required_front, arena->reserved_size - arena->committed_back);
+        if (new_front > arena->committed_front) {
+            if (mprotect(base + arena->committed_front, new_front - arena->committed_front, PROT_READ | PROT_WRITE) != 0) {
+                apigen_panic("out of memory");
+            }
+            ARENA_POISON(base + arena->committed_front, new_front - arena->committed_front);
+            thread_tag_stats[current_memory_tag].arena_chunks += new_front - arena->committed_front;
+            arena->committed_front = new_front;
+        }
+    }
+
+    if (required_back > arena->committed_back) {
+        size_t const new_back = minSize(required_back, arena->reserved_size - arena->committed_front);
+        if (new_back > arena->committed_back) {
+            if (mprotect(base + arena->reserved_size - new_back, new_back - arena->committed_back, PROT_READ | PROT_WRITE) != 0) {
+                apigen_panic("out of memory");
+            }
+            ARENA_POISON(base + arena->reserved_size - new_back, new_back - arena->committed_back);
+            thread_tag_stats[current_memory_tag].arena_chunks += new_back - arena->committed_back;
+            arena->committed_back = new_back;
+        }
+    }
+}
+
+#else
+
+bool apigen_memory_arena_init_reserved(struct apigen_MemoryArena * arena, size_t reserve_size, bool use_huge_pages)
+{
+    APIGEN_NOT_NULL(arena);
+    (void)reserve_size;
+    (void)use_huge_pages;
+    return false;
+}
+
+static void reservation_commit(struct apigen_MemoryArena * arena)
+{
+    (void)arena;
+    APIGEN_UNREACHABLE();
+}
+
+#endif
+
+static void free_chunk_list(struct apigen_MemoryArenaChunk * chunk)
 {
-    struct apigen_MemoryArenaChunk * chunk = arena->first_chunk;
     while (chunk) {
         struct apigen_MemoryArenaChunk * const to_be_deleted = chunk;
         chunk                                                = chunk->next;
-        apigen_free(to_be_deleted);
+        free_chunk(to_be_deleted);
     }
-    memset(arena, 0xAA, sizeof *arena);
 }
 
-void * apigen_memory_arena_alloc(struct apigen_MemoryArena * arena, size_t size)
+void apigen_memory_arena_deinit(struct apigen_MemoryArena * arena)
+{
+    free_chunk_list(arena->adopted_chunks);
+
+#if !defined(__WIN32__)
+    if (arena->reserved_size != 0) {
+        char * const base = (char *)arena->first_chunk;
+        ARENA_UNPOISON(base, arena->committed_front);
+        ARENA_UNPOISON(base + arena->reserved_size - arena->committed_back, arena->committed_back);
+        munmap(arena->first_chunk, arena->reserved_size);
+        APIGEN_POISON_FILL(arena, sizeof *arena);
+        return;
+    }
+#endif
+
+    free_chunk_list(arena->first_chunk);
+    free_chunk_list(arena->free_chunks);
+    APIGEN_POISON_FILL(arena, sizeof *arena);
+}
+
+void apigen_memory_arena_adopt(struct apigen_MemoryArena * arena, struct apigen_MemoryArena * other)
 {
     APIGEN_NOT_NULL(arena);
+    APIGEN_NOT_NULL(other);
+    APIGEN_ASSERT(arena != other);
+    APIGEN_ASSERT(other->reserved_size == 0);
+
+    // The chunks keep their contents, they are only moved into the list that is released on deinit:
+    struct apigen_MemoryArenaChunk * const lists[2] = { other->first_chunk, other->adopted_chunks };
+    for (size_t i = 0; i < 2; i++) {
+        struct apigen_MemoryArenaChunk * chunk = lists[i];
+        while (chunk) {
+            struct apigen_MemoryArenaChunk * const next = chunk->next;
+            chunk->next_partial   = NULL;
+            chunk->next           = arena->adopted_chunks;
+            arena->adopted_chunks = chunk;
+            chunk                 = next;
+        }
+    }
 
-    size_t const aligned_size = alignSizeForward(size);
+    // empty chunks have no contents that must stay alive:
+    free_chunk_list(other->free_chunks);
 
-    struct apigen_MemoryArenaChunk * chunk = arena->last_chunk;
+    APIGEN_POISON_FILL(other, sizeof *other);
+}
 
-    if (chunk == NULL || chunk->size < aligned_size) {
-        size_t const chunk_aligned_size = alignSizeForward(sizeof(struct apigen_MemoryArenaChunk));
+/// Tries to allocate `size` bytes from `chunk`. Returns `NULL` if the chunk is too small.
+/// An `alignment` of zero requests a packed allocation from the end of the chunk.
+/// On success, `padding` receives the number of bytes skipped for alignment.
+static void * chunk_try_alloc(struct apigen_MemoryArenaChunk * chunk, size_t size, size_t alignment, size_t * padding)
+{
+    *padding = 0;
+    if (alignment == 0) {
+        if (chunk_remaining(chunk) < size) {
+            return NULL;
+        }
+        chunk->packed += size;
+        return chunk_memory(chunk) + (chunk->size - chunk->packed);
+    }
 
-        size_t const new_chunk_size = maxSize(arena->chunk_size, aligned_size);
+    // chunk memory is aligned to max_align_t, so aligning the offset is sufficient:
+    size_t const offset = (chunk->used + alignment - 1) & ~(alignment - 1U);
+    if (offset > chunk->size - chunk->packed || (chunk->size - chunk->packed - offset) < size) {
+        return NULL;
+    }
+    *padding    = offset - chunk->used;
+    chunk->used = offset + size;
+
+    void * const alloc_ptr = chunk_memory(chunk) + offset;
+    APIGEN_ASSERT(isAddrAligned(alloc_ptr, alignment));
+    return alloc_ptr;
+}
 
-        APIGEN_ASSERT(new_chunk_size >= aligned_size);
+/// Remembers the tail of `chunk` in the partial list. If the list is full, the smallest
+/// tail is dropped, which may be the one of `chunk`.
+static void partial_chunks_add(struct apigen_MemoryArena * arena, struct apigen_MemoryArenaChunk * chunk)
+{
+    size_t const remaining = chunk_remaining(chunk);
+    if (remaining < ARENA_MIN_PARTIAL_TAIL) {
+        return;
+    }
 
-        chunk  = apigen_alloc(chunk_aligned_size + new_chunk_size);
-        *chunk = (struct apigen_MemoryArenaChunk){
-            .memory = ((char *)chunk) + chunk_aligned_size,
-            .size   = new_chunk_size,
-            .next   = NULL,
-        };
+    size_t                            count         = 0;
+    struct apigen_MemoryArenaChunk ** smallest_link = NULL;
+    for (struct apigen_MemoryArenaChunk ** link = &arena->partial_chunks; *link != NULL; link = &(*link)->next_partial) {
+        if (smallest_link == NULL || chunk_remaining(*link) < chunk_remaining(*smallest_link)) {
+            smallest_link = link;
+        }
+        count += 1;
+    }
 
-        APIGEN_ASSERT((void *)(chunk->memory - chunk_aligned_size) == (void *)chunk);
+    if (count >= ARENA_MAX_PARTIAL_CHUNKS) {
+        struct apigen_MemoryArenaChunk * const smallest = *smallest_link;
+        if (chunk_remaining(smallest) >= remaining) {
+            return;
+        }
+        *smallest_link         = smallest->next_partial;
+        smallest->next_partial = NULL;
+    }
 
-        if (arena->last_chunk == NULL) {
-            APIGEN_ASSERT(arena->first_chunk == NULL);
+    chunk->next_partial   = arena->partial_chunks;
+    arena->partial_chunks = chunk;
+}
 
-            arena->last_chunk  = chunk;
-            arena->first_chunk = chunk;
+/// Searches the list of partially used chunks for a tail that can hold the allocation.
+/// Chunks that become too small to be useful are dropped from the list.
+static void * partial_chunks_try_alloc(struct apigen_MemoryArena * arena, size_t size, size_t alignment, size_t * padding)
+{
+    struct apigen_MemoryArenaChunk ** link = &arena->partial_chunks;
+    while (*link != NULL) {
+        struct apigen_MemoryArenaChunk * const chunk = *link;
+
+        void * const alloc_ptr = chunk_try_alloc(chunk, size, alignment, padding);
+        if (alloc_ptr != NULL) {
+            if (chunk_remaining(chunk) < ARENA_MIN_PARTIAL_TAIL) {
+                *link               = chunk->next_partial;
+                chunk->next_partial = NULL;
+            }
+            return alloc_ptr;
         }
-        else {
-            APIGEN_ASSERT(arena->first_chunk != NULL);
-            arena->last_chunk->next = chunk;
-            arena->last_chunk       = chunk;
+        link = &chunk->next_partial;
+    }
+    return NULL;
+}
+
+/// Appends the empty `chunk` to the chunk list of `arena` and makes it the bump target.
+static void link_chunk(struct apigen_MemoryArena * arena, struct apigen_MemoryArenaChunk * chunk)
+{
+    struct apigen_MemoryArenaChunk * const previous = arena->last_chunk;
+    if (previous == NULL) {
+        APIGEN_ASSERT(arena->first_chunk == NULL);
+        arena->first_chunk = chunk;
+    }
+    else {
+        APIGEN_ASSERT(arena->first_chunk != NULL);
+        previous->next = chunk;
+
+        // Remember the tail of the retired chunk, so later small allocations can still use it:
+        partial_chunks_add(arena, previous);
+    }
+    arena->last_chunk = chunk;
+}
+
+/// Removes the first chunk from the free list that can hold `size` bytes, or returns `NULL`.
+static struct apigen_MemoryArenaChunk * free_chunks_take(struct apigen_MemoryArena * arena, size_t size)
+{
+    for (struct apigen_MemoryArenaChunk ** link = &arena->free_chunks; *link != NULL; link = &(*link)->next) {
+        struct apigen_MemoryArenaChunk * const chunk = *link;
+        if (chunk->size >= size) {
+            *link       = chunk->next;
+            chunk->next = NULL;
+            return chunk;
         }
     }
+    return NULL;
+}
+
+static struct apigen_MemoryArenaChunk * append_chunk(struct apigen_MemoryArena * arena, size_t size)
+{
+    size_t const header_size = alignSizeForward(sizeof(struct apigen_MemoryArenaChunk));
+
+    // Chunks from before a reset are reused first, they do not change the growth policy:
+    struct apigen_MemoryArenaChunk * chunk = free_chunks_take(arena, size);
+    if (chunk != NULL) {
+        link_chunk(arena, chunk);
+        return chunk;
+    }
+
+    // Only regular chunks grow the arena, a single large allocation gets a chunk of
+    // its own size and does not distort the growth policy:
+    size_t const new_chunk_size = maxSize(arena->chunk_size, alignSizeForward(size));
+    if (size <= arena->chunk_size && arena->chunk_size < arena->max_chunk_size) {
+        arena->chunk_size = maxSize(arena->chunk_size, minSize(2 * arena->chunk_size, arena->max_chunk_size));
+    }
 
-    void * const alloc_ptr = chunk->memory;
+    APIGEN_ASSERT(new_chunk_size >= size);
 
-    APIGEN_ASSERT(chunk->size >= aligned_size);
+    chunk = apigen_alloc(header_size + new_chunk_size);
+    thread_tag_stats[current_memory_tag].arena_chunks += header_size + new_chunk_size;
+    *chunk = (struct apigen_MemoryArenaChunk){
+        .next         = NULL,
+        .next_partial = NULL,
+        .size         = new_chunk_size,
+        .used         = 0,
+        .packed       = 0,
+    };
+    ARENA_POISON(chunk_memory(chunk), chunk->size);
+
+    link_chunk(arena, chunk);
+    return chunk;
+}
+
+static void * arena_alloc(struct apigen_MemoryArena * arena, size_t size, size_t alignment)
+{
+    APIGEN_NOT_NULL(arena);
+
+    size_t padding   = 0;
+    void * alloc_ptr = NULL;
+    if (arena->last_chunk != NULL) {
+        alloc_ptr = chunk_try_alloc(arena->last_chunk, size, alignment, &padding);
+    }
+    if (alloc_ptr == NULL) {
+        alloc_ptr = partial_chunks_try_alloc(arena, size, alignment, &padding);
+    }
+    if (alloc_ptr == NULL) {
+        if (arena->reserved_size != 0) {
+            apigen_panic("arena reservation exhausted");
+        }
 
-    chunk->memory += aligned_size;
-    chunk->size -= aligned_size;
+        struct apigen_MemoryArenaChunk * const chunk = append_chunk(arena, size);
+
+        alloc_ptr = chunk_try_alloc(chunk, size, alignment, &padding);
+        APIGEN_NOT_NULL(alloc_ptr);
+    }
+    else if (arena->reserved_size != 0) {
+        reservation_commit(arena);
+    }
 
-    APIGEN_ASSERT(isAddrAligned(alloc_ptr, alignof(max_align_t)));
+    struct apigen_MemoryTagStats * const stats = &thread_tag_stats[current_memory_tag];
+    stats->arena_allocs += 1;
+    stats->arena_requested += size;
+    stats->arena_padding += padding;
 
-    memset(alloc_ptr, 0xAA, aligned_size);
+    ARENA_UNPOISON(alloc_ptr, size);
+    APIGEN_POISON_FILL(alloc_ptr, size);
 
     return alloc_ptr;
 }
 
+void * apigen_memory_arena_alloc(struct apigen_MemoryArena * arena, size_t size)
+{
+    return arena_alloc(arena, size, alignof(max_align_t));
+}
+
+void * apigen_memory_arena_alloc_aligned(struct apigen_MemoryArena * arena, size_t size, size_t alignment)
+{
+    APIGEN_ASSERT(alignment > 0);
+    APIGEN_ASSERT((alignment & (alignment - 1)) == 0);
+    APIGEN_ASSERT(alignment <= alignof(max_align_t));
+    return arena_alloc(arena, size, alignment);
+}
+
+char * apigen_memory_arena_alloc_packed(struct apigen_MemoryArena * arena, size_t size)
+{
+    return arena_alloc(arena, size, 0);
+}
+
 char * apigen_memory_arena_dupestr(struct apigen_MemoryArena * arena, char const * str)
 {
     APIGEN_NOT_NULL(arena);
@@ -141,8 +677,239 @@ char * apigen_memory_arena_dupestr(struct apigen_MemoryArena * arena, char const
     }
 
     size_t len = strlen(str);
-    char * res = apigen_memory_arena_alloc(arena, len + 1);
+    char * res = apigen_memory_arena_alloc_packed(arena, len + 1);
     memcpy(res, str, len);
     res[len] = 0;
     return res;
 }
+
+/// Initial capacity of arrays grown with `apigen_memory_arena_grow_array`.
+static size_t const ARRAY_INITIAL_CAPACITY = 4;
+
+void * apigen_memory_arena_grow_array(struct apigen_MemoryArena * arena, void * items, size_t item_size, size_t alignment, size_t * capacity, size_t min_capacity)
+{
+    APIGEN_NOT_NULL(arena);
+    APIGEN_NOT_NULL(capacity);
+    APIGEN_ASSERT((items != NULL) || (*capacity == 0));
+
+    size_t const old_size     = *capacity * item_size;
+    size_t const new_capacity = maxSize((*capacity > 0) ? (2 * *capacity) : ARRAY_INITIAL_CAPACITY, min_capacity);
+    size_t const new_size     = new_capacity * item_size;
+
+    // If the array is the most recent allocation, we can just bump the chunk. Arrays allocated before
+    // the newest mark have to move, otherwise rewinding would cut off the grown part:
+    struct apigen_MemoryArenaChunk * const chunk        = arena->last_chunk;
+    bool const                             before_mark  = (chunk != NULL) && (chunk == arena->mark_chunk) && ((char *)items < chunk_memory(chunk) + arena->mark_used);
+    if (items != NULL && chunk != NULL && !before_mark && (char *)items + old_size == chunk_memory(chunk) + chunk->used && chunk_remaining(chunk) >= (new_size - old_size)) {
+        char * const grown_region = (char *)items + old_size;
+
+        chunk->used += new_size - old_size;
+        if (arena->reserved_size != 0) {
+            reservation_commit(arena);
+        }
+        ARENA_UNPOISON(grown_region, new_size - old_size);
+        APIGEN_POISON_FILL(grown_region, new_size - old_size);
+
+        thread_tag_stats[current_memory_tag].arena_requested += new_size - old_size;
+
+        *capacity = new_capacity;
+        return items;
+    }
+
+    void * const new_items = apigen_memory_arena_alloc_aligned(arena, new_size, alignment);
+    if (old_size > 0) {
+        memcpy(new_items, items, old_size);
+    }
+    *capacity = new_capacity;
+    return new_items;
+}
+
+struct apigen_MemoryArenaMark apigen_memory_arena_mark(struct apigen_MemoryArena * arena)
+{
+    APIGEN_NOT_NULL(arena);
+
+    struct apigen_MemoryArenaMark mark = {
+        .last = {
+            .chunk  = arena->last_chunk,
+            .used   = (arena->last_chunk != NULL) ? arena->last_chunk->used : 0,
+            .packed = (arena->last_chunk != NULL) ? arena->last_chunk->packed : 0,
+        },
+        .partial_count       = 0,
+        .chunk_size          = arena->chunk_size,
+        .previous_mark_chunk = arena->mark_chunk,
+        .previous_mark_used  = arena->mark_used,
+    };
+
+    // Allocations after the mark may still go into the tails of older chunks, so their positions are saved as well:
+    for (struct apigen_MemoryArenaChunk * chunk = arena->partial_chunks; chunk != NULL; chunk = chunk->next_partial) {
+        APIGEN_ASSERT(mark.partial_count < ARENA_MAX_PARTIAL_CHUNKS);
+        mark.partial[mark.partial_count] = (struct apigen_MemoryArenaChunkPosition){
+            .chunk  = chunk,
+            .used   = chunk->used,
+            .packed = chunk->packed,
+        };
+        mark.partial_count += 1;
+    }
+
+    arena->mark_chunk = mark.last.chunk;
+    arena->mark_used  = mark.last.used;
+
+    return mark;
+}
+
+/// Releases the allocations done in `position.chunk` since its position was saved.
+static void chunk_rewind(struct apigen_MemoryArenaChunkPosition position)
+{
+    struct apigen_MemoryArenaChunk * const chunk = position.chunk;
+    APIGEN_ASSERT(chunk->used >= position.used);
+    APIGEN_ASSERT(chunk->packed >= position.packed);
+
+    char * const memory = chunk_memory(chunk);
+    release_region(memory + position.used, chunk->used - position.used);
+    release_region(memory + chunk->size - chunk->packed, chunk->packed - position.packed);
+
+    chunk->used   = position.used;
+    chunk->packed = position.packed;
+}
+
+void apigen_memory_arena_rewind(struct apigen_MemoryArena * arena, struct apigen_MemoryArenaMark mark)
+{
+    APIGEN_NOT_NULL(arena);
+
+    struct apigen_MemoryArenaChunk * chunk = (mark.last.chunk != NULL) ? mark.last.chunk->next : arena->first_chunk;
+    while (chunk) {
+        struct apigen_MemoryArenaChunk * const to_be_deleted = chunk;
+        chunk                                                = chunk->next;
+        free_chunk(to_be_deleted);
+    }
+
+    if (mark.last.chunk != NULL) {
+        chunk_rewind(mark.last);
+        mark.last.chunk->next         = NULL;
+        mark.last.chunk->next_partial = NULL;
+    }
+    else {
+        arena->first_chunk = NULL;
+    }
+
+    // The partial list may have changed since the mark, so it is restored from the saved positions:
+    struct apigen_MemoryArenaChunk ** link = &arena->partial_chunks;
+    for (size_t i = 0; i < mark.partial_count; i++) {
+        chunk_rewind(mark.partial[i]);
+        *link = mark.partial[i].chunk;
+        link  = &mark.partial[i].chunk->next_partial;
+    }
+    *link = NULL;
+
+    arena->last_chunk = mark.last.chunk;
+    arena->chunk_size = mark.chunk_size;
+    arena->mark_chunk = mark.previous_mark_chunk;
+    arena->mark_used  = mark.previous_mark_used;
+}
+
+void apigen_memory_arena_keep(struct apigen_MemoryArena * arena, struct apigen_MemoryArenaMark mark)
+{
+    APIGEN_NOT_NULL(arena);
+
+    arena->mark_chunk = mark.previous_mark_chunk;
+    arena->mark_used  = mark.previous_mark_used;
+}
+
+void apigen_memory_arena_reset(struct apigen_MemoryArena * arena)
+{
+    APIGEN_NOT_NULL(arena);
+
+    // Keep the last chunk as the bump target, all others are moved to the free list in creation order,
+    // so they become bump targets again once the last chunk is full:
+    arena->partial_chunks = NULL;
+    arena->mark_chunk     = NULL;
+    arena->mark_used      = 0;
+
+    struct apigen_MemoryArenaChunk ** free_link = &arena->free_chunks;
+    while (*free_link != NULL) {
+        free_link = &(*free_link)->next;
+    }
+
+    struct apigen_MemoryArenaChunk * chunk = arena->first_chunk;
+    while (chunk != NULL) {
+        struct apigen_MemoryArenaChunk * const next = chunk->next;
+
+        release_region(chunk_memory(chunk), chunk->used);
+        release_region(chunk_memory(chunk) + chunk->size - chunk->packed, chunk->packed);
+        chunk->used         = 0;
+        chunk->packed       = 0;
+        chunk->next_partial = NULL;
+        if (chunk != arena->last_chunk) {
+            chunk->next = NULL;
+            *free_link  = chunk;
+            free_link   = &chunk->next;
+        }
+
+        chunk = next;
+    }
+    arena->first_chunk = arena->last_chunk;
+}
+
+void apigen_memory_render_report(struct apigen_Stream stream, struct apigen_MemoryArena const * arena)
+{
+    APIGEN_NOT_NULL(arena);
+
+    apigen_io_printf(stream, "%-12s %12s %12s %12s %12s %12s %12s\n", "tag", "heap allocs", "heap peak", "arena allocs", "requested", "padding", "chunk bytes");
+
+    struct apigen_MemoryTagStats total = {0};
+    for (size_t i = 0; i < APIGEN_MEMORY_TAG_COUNT; i++) {
+        struct apigen_MemoryTagStats const stats = apigen_memory_get_stats((enum apigen_MemoryTag)i);
+        apigen_io_printf(stream,
+            "%-12s %12zu %12zu %12zu %12zu %12zu %12zu\n",
+            apigen_memory_tag_name((enum apigen_MemoryTag)i),
+            stats.heap_allocs,
+            stats.heap_peak,
+            stats.arena_allocs,
+            stats.arena_requested,
+            stats.arena_padding,
+            stats.arena_chunks);
+
+        total.heap_allocs += stats.heap_allocs;
+        total.arena_allocs += stats.arena_allocs;
+        total.arena_requested += stats.arena_requested;
+        total.arena_padding += stats.arena_padding;
+        total.arena_chunks += stats.arena_chunks;
+    }
+    size_t const heap_peak = atomic_load_explicit(&memory_heap_peak, memory_order_relaxed);
+
+    apigen_io_printf(stream,
+        "%-12s %12zu %12zu %12zu %12zu %12zu %12zu\n",
+        "total",
+        total.heap_allocs,
+        heap_peak,
+        total.arena_allocs,
+        total.arena_requested,
+        total.arena_padding,
+        total.arena_chunks);
+
+    size_t chunk_count = 0;
+    size_t chunk_bytes = 0;
+    size_t slack_bytes = 0;
+    for (struct apigen_MemoryArenaChunk const * chunk = arena->first_chunk; chunk != NULL; chunk = chunk->next) {
+        chunk_count += 1;
+        chunk_bytes += chunk->size;
+        slack_bytes += chunk_remaining(chunk);
+    }
+    if (arena->reserved_size != 0) {
+        // only committed memory counts for reservations
+        size_t const header_size = alignSizeForward(sizeof(struct apigen_MemoryArenaChunk));
+        chunk_bytes              = arena->committed_front + arena->committed_back - header_size;
+        slack_bytes              = chunk_bytes - minSize(chunk_bytes, arena->first_chunk->used + arena->first_chunk->packed);
+    }
+    for (struct apigen_MemoryArenaChunk const * chunk = arena->free_chunks; chunk != NULL; chunk = chunk->next) {
+        chunk_count += 1;
+        chunk_bytes += chunk->size;
+        slack_bytes += chunk->size;
+    }
+    for (struct apigen_MemoryArenaChunk const * chunk = arena->adopted_chunks; chunk != NULL; chunk = chunk->next) {
+        chunk_count += 1;
+        chunk_bytes += chunk->size;
+        slack_bytes += chunk_remaining(chunk);
+    }
+    apigen_io_printf(stream, "arena: %zu chunks, %zu bytes, %zu bytes slack\n", chunk_count, chunk_bytes, slack_bytes);
+}
@@ -0,0 +1,451 @@
+// Hand-written replacement for the bison parser generated from parser.y.
+//
+// It accepts exactly the same language as parser.y and produces the same declarations, locations
+// and diagnostics. Every AST node is parsed directly into its final place in the arena, so nothing
+// is copied through a semantic value stack.
+//
+// The file is empty unless APIGEN_USE_RECURSIVE_DESCENT_PARSER is defined, so it can always be
+// compiled together with the bison parser.
+
+#ifdef APIGEN_USE_RECURSIVE_DESCENT_PARSER
+
+#include "apigen.h"
+#include "descent.h"
+#include "parser.h"
+
+#include <stdalign.h>
+
+#ifdef APIGEN_USE_HANDWRITTEN_LEXER
+#include "lexer.h"
+#else
+#define YY_DECL int apigen_parser_lex( \
+    YYSTYPE * yylval_param, \
+    YYLTYPE * yylloc_param , \
+    yyscan_t yyscanner, \
+    struct apigen_ParserState * parser_state \
+)
+#include "lexer.yy.h"
+extern YY_DECL;
+#endif
+
+/// Upper limit for nested types, same as the stack limit of the bison parser. Deeper nesting is reported
+/// as a syntax error instead of overflowing the stack.
+#define MAX_NESTING_DEPTH 10000
+
+/// Marks that the lookahead token was consumed and the next one has to be scanned first.
+#define NO_TOKEN (-2)
+
+struct Parser
+{
+    struct apigen_ParserState * state;
+    yyscan_t                    scanner;
+
+    int                          token; ///< kind of the lookahead token or `NO_TOKEN`
+    YYSTYPE                      value;
+    struct apigen_ParserLocation location;
+
+    uint32_t depth; ///< current nesting depth of types
+};
+
+APIGEN_DEFINE_ARRAY_OPERATORS(apigen_ParserEnumItemArray, struct apigen_ParserEnumItem, enum_item_array)
+APIGEN_DEFINE_ARRAY_OPERATORS(apigen_ParserFieldArray, struct apigen_ParserField, field_array)
+APIGEN_DEFINE_ARRAY_OPERATORS(apigen_ParserDeclarationArray, struct apigen_ParserDeclaration, declaration_array)
+
+/// Returns the kind of the lookahead token. Tokens are only scanned when they are needed, so the
+/// lexer runs in the same order relative to includes as with the bison parser.
+static int peek(struct Parser * parser)
+{
+    if(parser->token == NO_TOKEN) {
+        // Accounts all allocations done while scanning a token to the lexer:
+        enum apigen_MemoryTag const previous_tag = apigen_memory_set_tag(APIGEN_MEMORY_TAG_LEXER);
+        int const token = apigen_parser_lex(&parser->value, &parser->location, parser->scanner, parser->state);
+        apigen_memory_set_tag(previous_tag);
+
+        // bison treats the error result of the lexers as the end of the input:
+        parser->token = (token > 0) ? token : APIGEN_PARSER_EOF;
+    }
+    return parser->token;
+}
+
+/// Emits a syntax error at the lookahead token. Returns `false`, so the parse functions can return
+/// the result directly. Parsing stops at the first error, just like the bison parser does.
+static bool syntax_error(struct Parser * parser, char const * message)
+{
+    char const * file_name;
+    uint32_t     line, column;
+    apigen_parser_resolve_location(parser->state, parser->location, &file_name, &line, &column);
+
+    apigen_diagnostics_emit(
+        parser->state->diagnostics,
+        file_name,
+        line,
+        column,
+        apigen_error_syntax_error,
+        apigen_parser_get_text(parser->scanner),
+        message
+    );
+    return false;
+}
+
+/// Consumes the lookahead token if it is of `kind`.
+static bool accept(struct Parser * parser, int kind)
+{
+    if(peek(parser) != kind) {
+        return false;
+    }
+    parser->token = NO_TOKEN;
+    return true;
+}
+
+/// Consumes the lookahead token, which must be of `kind`, or emits a syntax error.
+/// The semantic value of the token stays in `parser->value` until the next token is scanned.
+static bool expect(struct Parser * parser, int kind)
+{
+    if(!accept(parser, kind)) {
+        return syntax_error(parser, "syntax error");
+    }
+    return true;
+}
+
+/// Consumes an identifier and stores it in `out`.
+static bool expect_identifier(struct Parser * parser, char const ** out)
+{
+    if(!expect(parser, IDENTIFIER)) {
+        return false;
+    }
+    *out = parser->value.identifier;
+    return true;
+}
+
+static struct apigen_ParserType * alloc_type(struct Parser * parser)
+{
+    return apigen_memory_arena_alloc_aligned(parser->state->ast_arena, sizeof(struct apigen_ParserType), alignof(struct apigen_ParserType));
+}
+
+/// Parses `docs?` and returns `NULL` if there is no doc comment.
+static char const * parse_docs(struct Parser * parser)
+{
+    struct apigen_ParserTextFragmentArray lines = { 0 };
+    while(accept(parser, DOCCOMMENT)) {
+        lines = apigen_parser_doc_lines_append(parser->state, lines, parser->value.plain_text);
+    }
+    return apigen_parser_join_doc_strings(parser->state, lines);
+}
+
+static bool parse_value(struct Parser * parser, struct apigen_Value * out)
+{
+    switch(peek(parser)) {
+        case NULLVAL:
+        case INTEGER:
+        case STRING:
+            accept(parser, parser->token);
+            *out = parser->value.value;
+            return true;
+
+        case MULTILINE_STRING: {
+            accept(parser, MULTILINE_STRING);
+            struct apigen_ParserTextFragmentArray lines = apigen_parser_fragment_list_init(parser->state, parser->value.value.value_str);
+            while(accept(parser, MULTILINE_STRING)) {
+                lines = apigen_parser_fragment_list_append(parser->state, lines, parser->value.value.value_str);
+            }
+            *out = apigen_parser_join_multiline_strs(parser->state, lines);
+            return true;
+        }
+
+        default:
+            return syntax_error(parser, "syntax error");
+    }
+}
+
+static bool parse_type(struct Parser * parser, struct apigen_ParserType * out);
+
+static bool parse_named_type(struct Parser * parser, struct apigen_ParserType * out)
+{
+    peek(parser);
+    *out = (struct apigen_ParserType) {
+        .location = parser->location,
+        .type     = apigen_parser_type_named,
+    };
+    return expect_identifier(parser, &out->named_data);
+}
+
+/// Parses `field (',' field)* ','?` into `out`, the list may also be empty.
+static bool parse_field_list(struct Parser * parser, struct apigen_ParserFieldArray * out)
+{
+    *out = (struct apigen_ParserFieldArray) { 0 };
+    while(peek(parser) == DOCCOMMENT || peek(parser) == IDENTIFIER) {
+        field_array_append(parser->state->ast_arena, out, (struct apigen_ParserField) { 0 });
+        struct apigen_ParserField * const field = &out->items[out->count - 1];
+
+        field->location      = parser->location;
+        field->documentation = parse_docs(parser);
+        if(!expect_identifier(parser, &field->identifier) || !expect(parser, ':') || !parse_type(parser, &field->type)) {
+            return false;
+        }
+
+        if(!accept(parser, ',')) {
+            break;
+        }
+    }
+    return true;
+}
+
+/// Parses `enum_item (',' enum_item)* ','?` into `out`, the list may also be empty.
+static bool parse_enum_items(struct Parser * parser, struct apigen_ParserEnumItemArray * out)
+{
+    *out = (struct apigen_ParserEnumItemArray) { 0 };
+    while(peek(parser) == DOCCOMMENT || peek(parser) == IDENTIFIER) {
+        enum_item_array_append(parser->state->ast_arena, out, (struct apigen_ParserEnumItem) { 0 });
+        struct apigen_ParserEnumItem * const item = &out->items[out->count - 1];
+
+        item->location      = parser->location;
+        item->documentation = parse_docs(parser);
+        item->value         = APIGEN_VALUE_NULL;
+        if(!expect_identifier(parser, &item->identifier)) {
+            return false;
+        }
+        if(accept(parser, '=') && !parse_value(parser, &item->value)) {
+            return false;
+        }
+
+        if(!accept(parser, ',')) {
+            break;
+        }
+    }
+    return true;
+}
+
+/// Parses `'(' field_list ')' type`. The location of a function type is the opening parenthesis.
+static bool parse_function_signature(struct Parser * parser, struct apigen_ParserType * out)
+{
+    peek(parser);
+    *out = (struct apigen_ParserType) {
+        .location = parser->location,
+        .type     = apigen_parser_type_function,
+    };
+    if(!expect(parser, '(') || !parse_field_list(parser, &out->function_data.parameters) || !expect(parser, ')')) {
+        return false;
+    }
+
+    out->function_data.return_type = alloc_type(parser);
+    return parse_type(parser, out->function_data.return_type);
+}
+
+/// Parses the remainder of a pointer type after the opening `'*'` or `'[' '*' (':' value)? ']'`.
+static bool parse_pointer_type(struct Parser * parser, struct apigen_ParserType * out)
+{
+    out->pointer_data.is_const        = accept(parser, KW_CONST);
+    out->pointer_data.underlying_type = alloc_type(parser);
+    return parse_type(parser, out->pointer_data.underlying_type);
+}
+
+/// Parses `'[' '*' (':' value)? ']'` after the opening bracket was consumed.
+static bool parse_many_pointer_type(struct Parser * parser, struct apigen_ParserType * out)
+{
+    if(!expect(parser, '*')) {
+        return false;
+    }
+    out->type                  = apigen_parser_type_ptr_to_many;
+    out->pointer_data.sentinel = APIGEN_VALUE_NULL;
+    if(accept(parser, ':')) {
+        out->type = apigen_parser_type_ptr_to_many_sentinelled;
+        if(!parse_value(parser, &out->pointer_data.sentinel)) {
+            return false;
+        }
+    }
+    return expect(parser, ']') && parse_pointer_type(parser, out);
+}
+
+/// Parses the body of `parse_type`, which tracks the nesting depth.
+static bool parse_type_inner(struct Parser * parser, struct apigen_ParserType * out)
+{
+    int const token = peek(parser);
+    *out = (struct apigen_ParserType) { .location = parser->location };
+
+    switch(token) {
+        case IDENTIFIER:
+            return parse_named_type(parser, out);
+
+        case KW_FN:
+            accept(parser, KW_FN);
+            return parse_function_signature(parser, out);
+
+        case KW_ENUM:
+            accept(parser, KW_ENUM);
+            out->type                      = apigen_parser_type_enum;
+            out->enum_data.underlying_type = NULL;
+            if(accept(parser, '(')) {
+                out->enum_data.underlying_type = alloc_type(parser);
+                if(!parse_named_type(parser, out->enum_data.underlying_type) || !expect(parser, ')')) {
+                    return false;
+                }
+            }
+            return expect(parser, '{') && parse_enum_items(parser, &out->enum_data.items) && expect(parser, '}');
+
+        case KW_UNION:
+        case KW_STRUCT:
+            accept(parser, token);
+            out->type = (token == KW_UNION) ? apigen_parser_type_union : apigen_parser_type_struct;
+            return expect(parser, '{') && parse_field_list(parser, &out->union_struct_fields) && expect(parser, '}');
+
+        case KW_OPAQUE:
+            accept(parser, KW_OPAQUE);
+            out->type = apigen_parser_type_opaque;
+            return expect(parser, '{') && expect(parser, '}');
+
+        case '*':
+            accept(parser, '*');
+            out->type                  = apigen_parser_type_ptr_to_one;
+            out->pointer_data.sentinel = APIGEN_VALUE_NULL;
+            return parse_pointer_type(parser, out);
+
+        case '?':
+            accept(parser, '?');
+            out->pointer_data.is_optional = true;
+            if(accept(parser, '*')) {
+                out->type                  = apigen_parser_type_ptr_to_one;
+                out->pointer_data.sentinel = APIGEN_VALUE_NULL;
+                return parse_pointer_type(parser, out);
+            }
+            return expect(parser, '[') && parse_many_pointer_type(parser, out);
+
+        case '[':
+            accept(parser, '[');
+            if(peek(parser) == '*') {
+                return parse_many_pointer_type(parser, out);
+            }
+            out->type = apigen_parser_type_array;
+            if(!parse_value(parser, &out->array_data.size) || !expect(parser, ']')) {
+                return false;
+            }
+            out->array_data.underlying_type = alloc_type(parser);
+            return parse_type(parser, out->array_data.underlying_type);
+
+        default:
+            return syntax_error(parser, "syntax error");
+    }
+}
+
+static bool parse_type(struct Parser * parser, struct apigen_ParserType * out)
+{
+    if(parser->depth >= MAX_NESTING_DEPTH) {
+        return syntax_error(parser, "types are nested too deeply");
+    }
+
+    parser->depth += 1;
+    bool const ok = parse_type_inner(parser, out);
+    parser->depth -= 1;
+    return ok;
+}
+
+static bool starts_declaration(int token)
+{
+    switch(token) {
+        case DOCCOMMENT:
+        case KW_CONST:
+        case KW_VAR:
+        case KW_TYPE:
+        case KW_CONSTEXPR:
+        case KW_FN:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// Parses a declaration without the terminating `';'`.
+static bool parse_declaration_body(struct Parser * parser, struct apigen_ParserDeclaration * out)
+{
+    int const keyword = peek(parser);
+    switch(keyword) {
+        case KW_CONST:
+        case KW_VAR:
+            accept(parser, keyword);
+            out->kind = (keyword == KW_CONST) ? apigen_parser_const_declaration : apigen_parser_var_declaration;
+            return expect_identifier(parser, &out->identifier) && expect(parser, ':') && parse_type(parser, &out->type);
+
+        case KW_TYPE:
+            accept(parser, KW_TYPE);
+            out->kind = apigen_parser_type_declaration;
+            return expect_identifier(parser, &out->identifier) && expect(parser, '=') && parse_type(parser, &out->type);
+
+        case KW_CONSTEXPR:
+            accept(parser, KW_CONSTEXPR);
+            out->kind = apigen_parser_constexpr_declaration;
+            return expect_identifier(parser, &out->identifier)
+                && expect(parser, ':')
+                && parse_type(parser, &out->type)
+                && expect(parser, '=')
+                && parse_value(parser, &out->initial_value);
+
+        case KW_FN:
+            accept(parser, KW_FN);
+            out->kind = apigen_parser_fn_declaration;
+            return expect_identifier(parser, &out->identifier) && parse_function_signature(parser, &out->type);
+
+        default:
+            return syntax_error(parser, "syntax error");
+    }
+}
+
+static bool parse_declaration(struct Parser * parser, struct apigen_ParserDeclaration * out)
+{
+    out->location      = parser->location;
+    out->documentation = parse_docs(parser);
+    return parse_declaration_body(parser, out) && expect(parser, ';');
+}
+
+static bool parse_file(struct Parser * parser)
+{
+    struct apigen_ParserDeclarationArray decls = { 0 };
+
+    // parser.y reports includes at the start of the declaration list, which is its first token:
+    peek(parser);
+    struct apigen_ParserLocation const list_location = parser->location;
+
+    while(true) {
+        int const token = peek(parser);
+        if(token == KW_INCLUDE) {
+            accept(parser, KW_INCLUDE);
+            if(!expect(parser, STRING)) {
+                return false;
+            }
+            char const * const include_path = parser->value.value.value_str;
+            if(!expect(parser, ';')) {
+                return false;
+            }
+            decls = apigen_parser_file_include(parser->state, list_location, decls, include_path);
+        }
+        else if(starts_declaration(token)) {
+            declaration_array_append(parser->state->ast_arena, &decls, (struct apigen_ParserDeclaration) { 0 });
+            if(!parse_declaration(parser, &decls.items[decls.count - 1])) {
+                return false;
+            }
+        }
+        else {
+            break;
+        }
+    }
+
+    // The bison parser completes the file before it notices stray tokens behind the last declaration,
+    // so the declarations are kept in that case:
+    parser->state->top_level_declarations = decls;
+    return expect(parser, APIGEN_PARSER_EOF);
+}
+
+int apigen_parser_parse(yyscan_t yyscanner, struct apigen_ParserState * parser_state)
+{
+    APIGEN_NOT_NULL(parser_state);
+    APIGEN_NOT_NULL(parser_state->diagnostics);
+
+    struct Parser parser = {
+        .state   = parser_state,
+        .scanner = yyscanner,
+        .token   = NO_TOKEN,
+        .depth   = 0,
+    };
+
+    return parse_file(&parser) ? 0 : 1;
+}
+
+#endif // APIGEN_USE_RECURSIVE_DESCENT_PARSER
@@ -0,0 +1,34 @@
+#pragma once
+
+// Interface of the recursive-descent parser in descent.c. It mirrors the parts of the bison-generated
+// parser.yy.h that are used by the lexers and parser.c, so both parsers are interchangeable at build time.
+
+#include "parser.h"
+
+typedef void * yyscan_t;
+
+/// Token kinds returned by the lexers. Numbered like the tokens bison generates from parser.y.
+enum apigen_parser_tokentype
+{
+    APIGEN_PARSER_EOF = 0,
+    STRING            = 258,
+    MULTILINE_STRING  = 259,
+    INTEGER           = 260,
+    NULLVAL           = 261,
+    IDENTIFIER        = 262,
+    DOCCOMMENT        = 263,
+    KW_CONST          = 264,
+    KW_VAR            = 265,
+    KW_TYPE           = 266,
+    KW_FN             = 267,
+    KW_ENUM           = 268,
+    KW_UNION          = 269,
+    KW_STRUCT         = 270,
+    KW_CONSTEXPR      = 271,
+    KW_OPAQUE         = 272,
+    KW_INCLUDE        = 273,
+};
+
+/// Parses the input of `yyscanner` into `parser_state->top_level_declarations`.
+/// Returns 0 on success, or 1 after emitting a syntax error.
+int apigen_parser_parse(yyscan_t yyscanner, struct apigen_ParserState * parser_state);
@@ -0,0 +1,684 @@
+// Hand-written replacement for the flex scanner generated from lexer.l.
+//
+// It recognizes exactly the same tokens as lexer.l (including the longest-match rules
+// of flex) and produces the same semantic values and locations. Whitespace, comment bodies
+// and identifiers are scanned with SSE2 or AVX2 if the CPU supports it.
+//
+// The file is empty unless APIGEN_USE_HANDWRITTEN_LEXER is defined, so it can always be
+// compiled together with the flex scanner.
+
+#ifdef APIGEN_USE_HANDWRITTEN_LEXER
+
+#include "apigen.h"
+#include "lexer.h"
+#include "parser.h"
+#ifdef APIGEN_USE_RECURSIVE_DESCENT_PARSER
+#include "descent.h"
+#else
+#include "parser.yy.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+/// Set to 0 to build the scanner without any vectorized code paths.
+#ifndef APIGEN_LEXER_SIMD
+#define APIGEN_LEXER_SIMD 1
+#endif
+
+#if APIGEN_LEXER_SIMD && defined(__SSE2__)
+#define LEXER_SSE2 1
+#include <emmintrin.h>
+#else
+#define LEXER_SSE2 0
+#endif
+
+#if APIGEN_LEXER_SIMD && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LEXER_AVX2 1
+#include <cpuid.h>
+#include <immintrin.h>
+#else
+#define LEXER_AVX2 0
+#endif
+
+/// The scanning primitives that are vectorized. All of them return a pointer in `[str, end]`.
+struct LexerKernels
+{
+    /// Returns the first character that cannot be part of an identifier.
+    char const * (*skip_identifier)(char const * str, char const * end);
+    /// Returns the first character that is not a space, carriage return or line feed.
+    char const * (*skip_whitespace)(char const * str, char const * end);
+    /// Returns the first line feed.
+    char const * (*find_line_end)(char const * str, char const * end);
+};
+
+struct Lexer
+{
+    struct apigen_ParserState * state;
+    struct LexerKernels const * kernels;
+
+    char *       source;      ///< input text, followed by two zero bytes
+    char const * cursor;
+    char const * end;
+    bool         loaded;      ///< `source` is valid
+    bool         owns_source; ///< `source` was read from `state->file` and is owned by the lexer
+
+    char const * token; ///< start of the most recently scanned token
+    size_t       token_length;
+
+    char * text; ///< zero-terminated copy of the current token, see `token_text()`
+    size_t text_capacity;
+};
+
+static inline bool is_identifier_start(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c == '_');
+}
+
+static inline bool is_identifier_char(char c)
+{
+    return is_identifier_start(c) || (c >= '0' && c <= '9');
+}
+
+static inline bool is_dec_digit(char c)
+{
+    return (c >= '0' && c <= '9') || (c == '_');
+}
+
+static inline bool is_hex_digit(char c)
+{
+    return is_dec_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static inline bool is_bin_digit(char c)
+{
+    return (c == '0') || (c == '1') || (c == '_');
+}
+
+static inline bool is_whitespace(char c)
+{
+    return (c == ' ') || (c == '\r') || (c == '\n');
+}
+
+static char const * skip_digits(char const * str, char const * end, bool (*is_digit)(char))
+{
+    while(str < end && is_digit(*str)) {
+        str += 1;
+    }
+    return str;
+}
+
+static char const * scalar_skip_identifier(char const * str, char const * end)
+{
+    while(str < end && is_identifier_char(*str)) {
+        str += 1;
+    }
+    return str;
+}
+
+static char const * scalar_skip_whitespace(char const * str, char const * end)
+{
+    while(str < end && is_whitespace(*str)) {
+        str += 1;
+    }
+    return str;
+}
+
+static char const * scalar_find_line_end(char const * str, char const * end)
+{
+    while(str < end && *str != '\n') {
+        str += 1;
+    }
+    return str;
+}
+
+#if !LEXER_SSE2
+static struct LexerKernels const scalar_kernels = {
+    .skip_identifier = scalar_skip_identifier,
+    .skip_whitespace = scalar_skip_whitespace,
+    .find_line_end   = scalar_find_line_end,
+};
+#endif
+
+#if LEXER_SSE2
+
+// The character classes use the usual trick for unsigned range checks with signed compares:
+// `c in [lo, lo + n)` is `(int8_t)(c + 128 - lo) < -128 + n`.
+
+static inline uint32_t sse2_identifier_mask(__m128i chunk)
+{
+    __m128i const lower = _mm_or_si128(chunk, _mm_set1_epi8(0x20));
+    __m128i const alpha = _mm_cmplt_epi8(_mm_add_epi8(lower, _mm_set1_epi8((char)(128 - 'a'))), _mm_set1_epi8((char)(-128 + 26)));
+    __m128i const digit = _mm_cmplt_epi8(_mm_add_epi8(chunk, _mm_set1_epi8((char)(128 - '0'))), _mm_set1_epi8((char)(-128 + 10)));
+    __m128i const under = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('_'));
+    return (uint32_t)_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(alpha, digit), under));
+}
+
+static char const * sse2_skip_identifier(char const * str, char const * end)
+{
+    while(end - str >= 16) {
+        __m128i const chunk = _mm_loadu_si128((__m128i const *)(void const *)str);
+        uint32_t const stop = ~sse2_identifier_mask(chunk) & 0xFFFFU;
+        if(stop != 0) {
+            return str + __builtin_ctz(stop);
+        }
+        str += 16;
+    }
+    return scalar_skip_identifier(str, end);
+}
+
+static char const * sse2_skip_whitespace(char const * str, char const * end)
+{
+    while(end - str >= 16) {
+        __m128i const chunk   = _mm_loadu_si128((__m128i const *)(void const *)str);
+        __m128i const newline = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n'));
+        __m128i const space   = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')));
+
+        uint32_t const stop = ~(uint32_t)_mm_movemask_epi8(_mm_or_si128(space, newline)) & 0xFFFFU;
+        if(stop != 0) {
+            return str + __builtin_ctz(stop);
+        }
+        str += 16;
+    }
+    return scalar_skip_whitespace(str, end);
+}
+
+static char const * sse2_find_line_end(char const * str, char const * end)
+{
+    while(end - str >= 16) {
+        __m128i const  chunk   = _mm_loadu_si128((__m128i const *)(void const *)str);
+        uint32_t const newline = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+        if(newline != 0) {
+            return str + __builtin_ctz(newline);
+        }
+        str += 16;
+    }
+    return scalar_find_line_end(str, end);
+}
+
+static struct LexerKernels const sse2_kernels = {
+    .skip_identifier = sse2_skip_identifier,
+    .skip_whitespace = sse2_skip_whitespace,
+    .find_line_end   = sse2_find_line_end,
+};
+
+#endif
+
+#if LEXER_AVX2
+
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+
+AVX2_FUNCTION static inline uint32_t avx2_identifier_mask(__m256i chunk)
+{
+    __m256i const lower = _mm256_or_si256(chunk, _mm256_set1_epi8(0x20));
+    __m256i const alpha = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(-128 + 26)), _mm256_add_epi8(lower, _mm256_set1_epi8((char)(128 - 'a'))));
+    __m256i const digit = _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(-128 + 10)), _mm256_add_epi8(chunk, _mm256_set1_epi8((char)(128 - '0'))));
+    __m256i const under = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('_'));
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(alpha, digit), under));
+}
+
+AVX2_FUNCTION static char const * avx2_skip_identifier(char const * str, char const * end)
+{
+    while(end - str >= 32) {
+        __m256i const  chunk = _mm256_loadu_si256((__m256i const *)(void const *)str);
+        uint32_t const stop  = ~avx2_identifier_mask(chunk);
+        if(stop != 0) {
+            return str + __builtin_ctz(stop);
+        }
+        str += 32;
+    }
+    return scalar_skip_identifier(str, end);
+}
+
+AVX2_FUNCTION static char const * avx2_skip_whitespace(char const * str, char const * end)
+{
+    while(end - str >= 32) {
+        __m256i const chunk   = _mm256_loadu_si256((__m256i const *)(void const *)str);
+        __m256i const newline = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n'));
+        __m256i const space   = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r')));
+
+        uint32_t const stop = ~(uint32_t)_mm256_movemask_epi8(_mm256_or_si256(space, newline));
+        if(stop != 0) {
+            return str + __builtin_ctz(stop);
+        }
+        str += 32;
+    }
+    return scalar_skip_whitespace(str, end);
+}
+
+AVX2_FUNCTION static char const * avx2_find_line_end(char const * str, char const * end)
+{
+    while(end - str >= 32) {
+        __m256i const  chunk   = _mm256_loadu_si256((__m256i const *)(void const *)str);
+        uint32_t const newline = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')));
+        if(newline != 0) {
+            return str + __builtin_ctz(newline);
+        }
+        str += 32;
+    }
+    return scalar_find_line_end(str, end);
+}
+
+static struct LexerKernels const avx2_kernels = {
+    .skip_identifier = avx2_skip_identifier,
+    .skip_whitespace = avx2_skip_whitespace,
+    .find_line_end   = avx2_find_line_end,
+};
+
+static bool cpu_supports_avx2(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    if((ecx & bit_OSXSAVE) == 0 || (ecx & bit_AVX) == 0) {
+        return false;
+    }
+
+    // The operating system must preserve the SSE and AVX register state:
+    uint32_t xcr0_low, xcr0_high;
+    __asm__("xgetbv" : "=a"(xcr0_low), "=d"(xcr0_high) : "c"(0));
+    (void)xcr0_high;
+    if((xcr0_low & 0x6) != 0x6) {
+        return false;
+    }
+
+    if(!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    return (ebx & bit_AVX2) != 0;
+}
+
+#endif
+
+static struct LexerKernels const * select_kernels(void)
+{
+#if LEXER_AVX2
+    if(cpu_supports_avx2()) {
+        return &avx2_kernels;
+    }
+#endif
+#if LEXER_SSE2
+    return &sse2_kernels;
+#else
+    return &scalar_kernels;
+#endif
+}
+
+int apigen_parser_lex_init_extra(struct apigen_ParserState * state, yyscan_t * out_scanner)
+{
+    APIGEN_NOT_NULL(state);
+    APIGEN_NOT_NULL(out_scanner);
+
+    struct Lexer * const lexer = apigen_alloc(sizeof(struct Lexer));
+    *lexer = (struct Lexer) {
+        .state   = state,
+        .kernels = select_kernels(),
+    };
+
+    *out_scanner = lexer;
+    return 0;
+}
+
+int apigen_parser_lex_destroy(yyscan_t scanner)
+{
+    struct Lexer * const lexer = scanner;
+    APIGEN_NOT_NULL(lexer);
+
+    if(lexer->owns_source) {
+        apigen_free(lexer->source);
+    }
+    if(lexer->text != NULL) {
+        apigen_free(lexer->text);
+    }
+    apigen_free(lexer);
+    return 0;
+}
+
+YY_BUFFER_STATE apigen_parser__scan_buffer(char * base, size_t size, yyscan_t scanner)
+{
+    struct Lexer * const lexer = scanner;
+    APIGEN_NOT_NULL(lexer);
+    APIGEN_NOT_NULL(base);
+    APIGEN_ASSERT(size >= 2);
+    APIGEN_ASSERT(base[size - 2] == 0 && base[size - 1] == 0);
+    APIGEN_ASSERT(!lexer->loaded);
+
+    lexer->source = base;
+    lexer->cursor = base;
+    lexer->end    = base + size - 2;
+    lexer->loaded = true;
+
+    return lexer;
+}
+
+/// Reads the whole input stream into memory. Used for streams that can't be mapped.
+static void load_stream(struct Lexer * lexer)
+{
+    size_t capacity = 64 * 1024;
+    size_t length   = 0;
+    char * source   = apigen_alloc(capacity);
+
+    while(true) {
+        if(capacity - length < 4096 + 2) {
+            char * const grown = apigen_alloc(2 * capacity);
+            memcpy(grown, source, length);
+            apigen_free(source);
+            source = grown;
+            capacity *= 2;
+        }
+        size_t const count = apigen_io_read(lexer->state->file, source + length, capacity - length - 2);
+        if(count == 0) {
+            break;
+        }
+        length += count;
+    }
+    source[length + 0] = 0;
+    source[length + 1] = 0;
+
+    apigen_parser_scan_lines(lexer->state, source, length);
+
+    lexer->source      = source;
+    lexer->cursor      = source;
+    lexer->end         = source + length;
+    lexer->loaded      = true;
+    lexer->owns_source = true;
+}
+
+/// Returns a zero-terminated copy of the current token.
+static char const * token_text(struct Lexer * lexer)
+{
+    if(lexer->token_length + 1 > lexer->text_capacity) {
+        if(lexer->text != NULL) {
+            apigen_free(lexer->text);
+        }
+        lexer->text_capacity = 2 * (lexer->token_length + 1);
+        if(lexer->text_capacity < 256) {
+            lexer->text_capacity = 256;
+        }
+        lexer->text = apigen_alloc(lexer->text_capacity);
+    }
+    if(lexer->token_length > 0) {
+        memcpy(lexer->text, lexer->token, lexer->token_length);
+    }
+    lexer->text[lexer->token_length] = 0;
+    return lexer->text;
+}
+
+char * apigen_parser_get_text(yyscan_t scanner)
+{
+    struct Lexer * const lexer = scanner;
+    APIGEN_NOT_NULL(lexer);
+    return (char *)token_text(lexer);
+}
+
+static int classify_identifier(char const * str, size_t length)
+{
+    switch(length) {
+        case 2:
+            if(memcmp(str, "fn", 2) == 0) return KW_FN;
+            break;
+        case 3:
+            if(memcmp(str, "var", 3) == 0) return KW_VAR;
+            break;
+        case 4:
+            if(memcmp(str, "type", 4) == 0) return KW_TYPE;
+            if(memcmp(str, "enum", 4) == 0) return KW_ENUM;
+            if(memcmp(str, "null", 4) == 0) return NULLVAL;
+            break;
+        case 5:
+            if(memcmp(str, "const", 5) == 0) return KW_CONST;
+            if(memcmp(str, "union", 5) == 0) return KW_UNION;
+            break;
+        case 6:
+            if(memcmp(str, "struct", 6) == 0) return KW_STRUCT;
+            if(memcmp(str, "opaque", 6) == 0) return KW_OPAQUE;
+            break;
+        case 7:
+            if(memcmp(str, "include", 7) == 0) return KW_INCLUDE;
+            break;
+        case 9:
+            if(memcmp(str, "constexpr", 9) == 0) return KW_CONSTEXPR;
+            break;
+        default:
+            break;
+    }
+    return IDENTIFIER;
+}
+
+/// Returns the end of the string literal starting at `str`, or `NULL` if it is not terminated on the same line.
+static char const * scan_string_literal(char const * str, char const * end)
+{
+    APIGEN_ASSERT(*str == '"');
+    str += 1;
+    while(str < end) {
+        switch(*str) {
+            case '"':
+                return str + 1;
+            case '\n':
+                return NULL;
+            case '\\':
+                if(str + 1 == end || str[1] == '\n') {
+                    return NULL;
+                }
+                str += 2;
+                break;
+            default:
+                str += 1;
+                break;
+        }
+    }
+    return NULL;
+}
+
+/// Scans an integer literal with an optional `prefix_length` characters (the sign) in front.
+/// Returns the end of the literal and the base it is written in.
+static char const * scan_integer(char const * str, char const * end, size_t prefix_length, uint8_t * out_base)
+{
+    char const * const digits = str + prefix_length;
+    if(digits[0] == '0' && digits[1] == 'x' && is_hex_digit(digits[2])) {
+        *out_base = 16;
+        return skip_digits(digits + 2, end, is_hex_digit);
+    }
+    if(digits[0] == '0' && digits[1] == 'b' && is_bin_digit(digits[2])) {
+        *out_base = 2;
+        return skip_digits(digits + 2, end, is_bin_digit);
+    }
+    *out_base = 10;
+    return skip_digits(digits, end, is_dec_digit);
+}
+
+int apigen_parser_lex(YYSTYPE * value, YYLTYPE * location, yyscan_t scanner, struct apigen_ParserState * parser_state)
+{
+    struct Lexer * const lexer = scanner;
+    APIGEN_NOT_NULL(lexer);
+    APIGEN_NOT_NULL(value);
+    APIGEN_NOT_NULL(location);
+    APIGEN_NOT_NULL(parser_state);
+
+    if(!lexer->loaded) {
+        load_stream(lexer);
+    }
+
+    struct LexerKernels const * const kernels = lexer->kernels;
+    char const * const                end     = lexer->end;
+    char const *                      cursor  = lexer->cursor;
+
+    // Skip whitespace and comments. flex reports them as individual tokens, so the location
+    // of the last one is remembered for the end of file:
+    char const * skipped = NULL;
+    while(cursor < end) {
+        if(is_whitespace(*cursor)) {
+            cursor  = kernels->skip_whitespace(cursor, end);
+            skipped = cursor - 1; // every whitespace character is a token of its own
+        }
+        else if(cursor[0] == '/' && cursor[1] == '/' && cursor[2] != '/') {
+            skipped = cursor;
+            cursor  = kernels->find_line_end(cursor + 2, end);
+        }
+        else {
+            break;
+        }
+    }
+
+    if(cursor == end) {
+        lexer->cursor       = cursor;
+        lexer->token        = cursor;
+        lexer->token_length = 0;
+
+        if(skipped != NULL) {
+            location->source = parser_state->source_index;
+            location->offset = (uint32_t)(skipped - lexer->source);
+        }
+        return 0;
+    }
+
+    location->source = parser_state->source_index;
+    location->offset = (uint32_t)(cursor - lexer->source);
+
+    char const * const start = cursor;
+    char const *       token_end;
+    int                token;
+    uint8_t            base = 10;
+
+    switch(*start) {
+        case '/': // comments were already skipped, so this is either a doc comment or an error
+            if(start[1] != '/') {
+                goto unexpected_char;
+            }
+            token_end = kernels->find_line_end(start + 3, end);
+            token     = DOCCOMMENT;
+            break;
+
+        case '"':
+            token_end = scan_string_literal(start, end);
+            if(token_end == NULL) {
+                goto unexpected_char;
+            }
+            token = STRING;
+            break;
+
+        case '\\':
+            if(start[1] != '\\') {
+                goto unexpected_char;
+            }
+            token_end = kernels->find_line_end(start + 2, end);
+            token     = MULTILINE_STRING;
+            break;
+
+        case '@': {
+            // `@"[^"]+"`, which may span multiple lines:
+            if(start[1] != '"' || start[2] == '"') {
+                goto unexpected_char;
+            }
+            char const * const closing = (start + 2 < end) ? memchr(start + 2, '"', (size_t)(end - start - 2)) : NULL;
+            if(closing == NULL) {
+                goto unexpected_char;
+            }
+            token_end = closing + 1;
+            token     = IDENTIFIER;
+            break;
+        }
+
+        case '*':
+        case '[':
+        case ']':
+        case '(':
+        case ')':
+        case '{':
+        case '}':
+        case '=':
+        case ';':
+        case ',':
+        case ':':
+        case '?':
+            token_end = start + 1;
+            token     = *start;
+            break;
+
+        case '-':
+            if(!is_dec_digit(start[1])) {
+                goto unexpected_char;
+            }
+            token_end = scan_integer(start, end, 1, &base);
+            token     = INTEGER;
+            break;
+
+        default:
+            if(*start >= '0' && *start <= '9') {
+                token_end = scan_integer(start, end, 0, &base);
+                token     = INTEGER;
+            }
+            else if(is_identifier_start(*start)) {
+                token_end = kernels->skip_identifier(start + 1, end);
+                token     = classify_identifier(start, (size_t)(token_end - start));
+
+                // `[0-9_]+` is listed before the identifier rule, so it wins when both match the same text:
+                if(*start == '_' && skip_digits(start, token_end, is_dec_digit) == token_end) {
+                    base  = 10;
+                    token = INTEGER;
+                }
+            }
+            else {
+                goto unexpected_char;
+            }
+            break;
+    }
+
+    lexer->cursor       = token_end;
+    lexer->token        = start;
+    lexer->token_length = (size_t)(token_end - start);
+
+    switch(token) {
+        case DOCCOMMENT:
+            value->plain_text = parser_state->skip_documentation ? NULL : apigen_parser_create_doc_string(parser_state, token_text(lexer));
+            break;
+
+        case STRING:
+            value->value = apigen_parser_conv_regular_str(parser_state, token_text(lexer));
+            break;
+
+        case MULTILINE_STRING:
+            value->value = apigen_parser_conv_multiline_str(parser_state, token_text(lexer));
+            break;
+
+        case IDENTIFIER:
+            if(*start == '@') {
+                value->identifier = apigen_parser_conv_at_ident(parser_state, token_text(lexer));
+            }
+            else {
+                value->identifier = apigen_string_pool_intern_len(parser_state->strings, start, lexer->token_length);
+            }
+            break;
+
+        case NULLVAL:
+            value->value = (struct apigen_Value) { .type = apigen_value_null };
+            break;
+
+        case INTEGER: {
+            char const * const text   = token_text(lexer);
+            size_t const       prefix = (base == 10) ? 0 : 2;
+            if(*start == '-') {
+                value->value = (struct apigen_Value) { .type = apigen_value_sint, .value_sint = apigen_parse_sint(text + 1 + prefix, base) };
+            }
+            else {
+                value->value = (struct apigen_Value) { .type = apigen_value_uint, .value_uint = apigen_parse_uint(text + prefix, base) };
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+
+    return token;
+
+unexpected_char:
+    lexer->cursor       = start + 1;
+    lexer->token        = start;
+    lexer->token_length = 1;
+    printf("unexpected char: '%s'", token_text(lexer));
+    return -1;
+}
+
+#endif // APIGEN_USE_HANDWRITTEN_LEXER
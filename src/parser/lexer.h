@@ -0,0 +1,25 @@
+#pragma once
+
+// Interface of the hand-written lexer in lexer.c. It mirrors the subset of the reentrant
+// flex API that is used by the parser, so both scanners are interchangeable at build time.
+
+#include "parser.h"
+
+#include <stddef.h>
+
+typedef void * yyscan_t;
+
+/// The hand-written lexer only has a single input buffer, which is owned by the scanner.
+typedef void * YY_BUFFER_STATE;
+
+int  apigen_parser_lex_init_extra(struct apigen_ParserState * state, yyscan_t * out_scanner);
+int  apigen_parser_lex_destroy(yyscan_t scanner);
+
+/// Lets the scanner read from `base` instead of pulling the input from `state->file`.
+/// The last two of the `size` bytes must be zero, as required by flex.
+YY_BUFFER_STATE apigen_parser__scan_buffer(char * base, size_t size, yyscan_t scanner);
+
+/// Returns the text of the most recently scanned token.
+char * apigen_parser_get_text(yyscan_t scanner);
+
+int apigen_parser_lex(YYSTYPE * value, YYLTYPE * location, yyscan_t scanner, struct apigen_ParserState * parser_state);
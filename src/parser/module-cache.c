@@ -0,0 +1,553 @@
+#include "parser.h"
+#include "apigen.h"
+
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+// The module cache keeps the parsed declarations of included files between runs, so unchanged
+// files are neither lexed nor parsed again.
+//
+// An image is a copy of the AST of one file, where every pointer is replaced by the byte offset of
+// its target inside the image. Loading copies the image into the arena with a single allocation and
+// turns the offsets back into pointers. Includes of the file are stored as placeholder declarations
+// and are resolved by the caller, so every included file gets its own image.
+//
+// Images use the native struct layout and are only valid for the build that wrote them. They are
+// named after a hash of the source text, the parser options and the offsets of all encoded fields.
+
+/// Must be incremented whenever the image format changes. Changes of the AST structs are detected by the key.
+#define MODULE_IMAGE_VERSION 1
+
+static char const MODULE_IMAGE_MAGIC[8] = "APIGENM";
+
+struct ModuleImageHeader
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t key;               ///< same as in the file name
+    uint64_t source_length;     ///< length of the source text, guards against hash collisions
+    uint64_t image_size;        ///< size of the whole image, including this header
+    uint64_t declarations;      ///< offset of the declaration array
+    uint64_t declaration_count;
+};
+
+static uint64_t hash_bytes(uint64_t hash, void const * data, size_t length)
+{
+    // FNV-1a
+    unsigned char const * const bytes = data;
+    for(size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 0x00000100000001B3ULL;
+    }
+    return hash;
+}
+
+uint64_t apigen_parser_module_key(struct apigen_ParserState const * state, char const * text, size_t length)
+{
+    APIGEN_NOT_NULL(state);
+    APIGEN_NOT_NULL(text);
+
+    // Offsets of all encoded fields, so any change of the AST layout invalidates the images:
+    size_t const layout[] = {
+        MODULE_IMAGE_VERSION,
+        sizeof(void *),
+        sizeof(struct ModuleImageHeader),
+        sizeof(struct apigen_Value),
+        offsetof(struct apigen_Value, type),
+        offsetof(struct apigen_Value, value_str),
+        apigen_value_str,
+        sizeof(struct apigen_ParserLocation),
+        sizeof(struct apigen_ParserType),
+        offsetof(struct apigen_ParserType, location),
+        offsetof(struct apigen_ParserType, type),
+        offsetof(struct apigen_ParserType, enum_data.underlying_type),
+        offsetof(struct apigen_ParserType, enum_data.items.items),
+        offsetof(struct apigen_ParserType, enum_data.items.count),
+        offsetof(struct apigen_ParserType, union_struct_fields.items),
+        offsetof(struct apigen_ParserType, union_struct_fields.count),
+        offsetof(struct apigen_ParserType, named_data),
+        offsetof(struct apigen_ParserType, array_data.underlying_type),
+        offsetof(struct apigen_ParserType, array_data.size),
+        offsetof(struct apigen_ParserType, pointer_data.underlying_type),
+        offsetof(struct apigen_ParserType, pointer_data.is_const),
+        offsetof(struct apigen_ParserType, pointer_data.is_optional),
+        offsetof(struct apigen_ParserType, pointer_data.sentinel),
+        offsetof(struct apigen_ParserType, function_data.return_type),
+        offsetof(struct apigen_ParserType, function_data.parameters),
+        apigen_parser_type_opaque,
+        sizeof(struct apigen_ParserField),
+        offsetof(struct apigen_ParserField, documentation),
+        offsetof(struct apigen_ParserField, identifier),
+        offsetof(struct apigen_ParserField, type),
+        offsetof(struct apigen_ParserField, location),
+        sizeof(struct apigen_ParserEnumItem),
+        offsetof(struct apigen_ParserEnumItem, documentation),
+        offsetof(struct apigen_ParserEnumItem, identifier),
+        offsetof(struct apigen_ParserEnumItem, value),
+        offsetof(struct apigen_ParserEnumItem, location),
+        sizeof(struct apigen_ParserDeclaration),
+        offsetof(struct apigen_ParserDeclaration, kind),
+        offsetof(struct apigen_ParserDeclaration, documentation),
+        offsetof(struct apigen_ParserDeclaration, identifier),
+        offsetof(struct apigen_ParserDeclaration, type),
+        offsetof(struct apigen_ParserDeclaration, initial_value),
+        offsetof(struct apigen_ParserDeclaration, location),
+        offsetof(struct apigen_ParserDeclaration, include_path),
+        apigen_parser_include_declaration,
+        state->skip_documentation,
+    };
+    char const * const line_feed = (state->line_feed != NULL) ? state->line_feed : "\n"; // is baked into multiline strings
+
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    hash          = hash_bytes(hash, layout, sizeof layout);
+    hash          = hash_bytes(hash, line_feed, strlen(line_feed) + 1);
+    hash          = hash_bytes(hash, text, length);
+    return hash;
+}
+
+static void module_file_name(char * buffer, size_t buffer_size, uint64_t key)
+{
+    int const length = snprintf(buffer, buffer_size, "%016llx.apim", (unsigned long long)key);
+    APIGEN_ASSERT(length > 0 && (size_t)length < buffer_size);
+}
+
+// writing images:
+
+APIGEN_DECLARE_ARRAY(ModuleImageBytes, char);
+APIGEN_DEFINE_ARRAY_OPERATORS(ModuleImageBytes, char, image_bytes)
+
+struct ImageWriter
+{
+    struct apigen_MemoryArena * arena;
+    struct ModuleImageBytes     bytes;
+};
+
+/// Appends `size` bytes aligned to `alignment` and returns their offset.
+static uintptr_t write_bytes(struct ImageWriter * writer, void const * data, size_t size, size_t alignment)
+{
+    while((writer->bytes.count & (alignment - 1)) != 0) {
+        image_bytes_append(writer->arena, &writer->bytes, 0);
+    }
+    uintptr_t const offset = writer->bytes.count;
+    image_bytes_append_all(writer->arena, &writer->bytes, data, size);
+    return offset;
+}
+
+/// Offsets are stored in the pointer fields. They are never zero, as the header comes first, so `NULL` stays `NULL`.
+#define ENCODE_OFFSET(_Type, _Offset) ((_Type)(_Offset))
+
+static char const * write_string(struct ImageWriter * writer, char const * str)
+{
+    if(str == NULL) {
+        return NULL;
+    }
+    return ENCODE_OFFSET(char const *, write_bytes(writer, str, strlen(str) + 1, 1));
+}
+
+static struct apigen_Value write_value(struct ImageWriter * writer, struct apigen_Value value)
+{
+    if(value.type == apigen_value_str) {
+        value.value_str = write_string(writer, value.value_str);
+    }
+    return value;
+}
+
+static struct apigen_ParserType write_type(struct ImageWriter * writer, struct apigen_ParserType type);
+
+static struct apigen_ParserType * write_type_ptr(struct ImageWriter * writer, struct apigen_ParserType const * type)
+{
+    if(type == NULL) {
+        return NULL;
+    }
+    struct apigen_ParserType const encoded = write_type(writer, *type);
+    return ENCODE_OFFSET(struct apigen_ParserType *, write_bytes(writer, &encoded, sizeof encoded, alignof(struct apigen_ParserType)));
+}
+
+static struct apigen_ParserFieldArray write_fields(struct ImageWriter * writer, struct apigen_ParserFieldArray fields)
+{
+    // all fields must be written before the array itself, as the array must be contiguous:
+    struct apigen_ParserField * const encoded = apigen_memory_arena_alloc_aligned(writer->arena, fields.count * sizeof(struct apigen_ParserField), alignof(struct apigen_ParserField));
+    for(size_t i = 0; i < fields.count; i++) {
+        encoded[i]               = fields.items[i];
+        encoded[i].documentation = write_string(writer, fields.items[i].documentation);
+        encoded[i].identifier    = write_string(writer, fields.items[i].identifier);
+        encoded[i].type          = write_type(writer, fields.items[i].type);
+    }
+    return (struct apigen_ParserFieldArray) {
+        .items    = (fields.count > 0) ? ENCODE_OFFSET(struct apigen_ParserField *, write_bytes(writer, encoded, fields.count * sizeof(struct apigen_ParserField), alignof(struct apigen_ParserField))) : NULL,
+        .count    = fields.count,
+        .capacity = fields.count,
+    };
+}
+
+static struct apigen_ParserEnumItemArray write_enum_items(struct ImageWriter * writer, struct apigen_ParserEnumItemArray items)
+{
+    struct apigen_ParserEnumItem * const encoded = apigen_memory_arena_alloc_aligned(writer->arena, items.count * sizeof(struct apigen_ParserEnumItem), alignof(struct apigen_ParserEnumItem));
+    for(size_t i = 0; i < items.count; i++) {
+        encoded[i]               = items.items[i];
+        encoded[i].documentation = write_string(writer, items.items[i].documentation);
+        encoded[i].identifier    = write_string(writer, items.items[i].identifier);
+        encoded[i].value         = write_value(writer, items.items[i].value);
+    }
+    return (struct apigen_ParserEnumItemArray) {
+        .items    = (items.count > 0) ? ENCODE_OFFSET(struct apigen_ParserEnumItem *, write_bytes(writer, encoded, items.count * sizeof(struct apigen_ParserEnumItem), alignof(struct apigen_ParserEnumItem))) : NULL,
+        .count    = items.count,
+        .capacity = items.count,
+    };
+}
+
+static struct apigen_ParserType write_type(struct ImageWriter * writer, struct apigen_ParserType type)
+{
+    switch(type.type) {
+        case apigen_parser_type_named:
+            type.named_data = write_string(writer, type.named_data);
+            break;
+
+        case apigen_parser_type_enum:
+            type.enum_data.underlying_type = write_type_ptr(writer, type.enum_data.underlying_type);
+            type.enum_data.items           = write_enum_items(writer, type.enum_data.items);
+            break;
+
+        case apigen_parser_type_struct:
+        case apigen_parser_type_union:
+            type.union_struct_fields = write_fields(writer, type.union_struct_fields);
+            break;
+
+        case apigen_parser_type_array:
+            type.array_data.underlying_type = write_type_ptr(writer, type.array_data.underlying_type);
+            type.array_data.size            = write_value(writer, type.array_data.size);
+            break;
+
+        case apigen_parser_type_ptr_to_one:
+        case apigen_parser_type_ptr_to_many:
+        case apigen_parser_type_ptr_to_many_sentinelled:
+            type.pointer_data.underlying_type = write_type_ptr(writer, type.pointer_data.underlying_type);
+            type.pointer_data.sentinel        = write_value(writer, type.pointer_data.sentinel);
+            break;
+
+        case apigen_parser_type_function:
+            type.function_data.return_type = write_type_ptr(writer, type.function_data.return_type);
+            type.function_data.parameters  = write_fields(writer, type.function_data.parameters);
+            break;
+
+        case apigen_parser_type_opaque:
+            break;
+    }
+    return type;
+}
+
+void apigen_parser_store_module(struct apigen_ParserState * state, uint64_t key, size_t source_length, struct apigen_ParserDeclarationArray decls)
+{
+    APIGEN_NOT_NULL(state);
+    APIGEN_NOT_NULL(state->module_cache);
+
+    // the image is only needed until it is written:
+    struct apigen_MemoryArenaMark const mark = apigen_memory_arena_mark(state->ast_arena);
+
+    struct ImageWriter writer = {
+        .arena = state->ast_arena,
+        .bytes = { 0 },
+    };
+
+    struct ModuleImageHeader header = {
+        .version       = MODULE_IMAGE_VERSION,
+        .key           = key,
+        .source_length = source_length,
+    };
+    memcpy(header.magic, MODULE_IMAGE_MAGIC, sizeof header.magic);
+    (void)write_bytes(&writer, &header, sizeof header, alignof(struct ModuleImageHeader));
+
+    struct apigen_ParserDeclaration * const encoded = apigen_memory_arena_alloc_aligned(state->ast_arena, decls.count * sizeof(struct apigen_ParserDeclaration), alignof(struct apigen_ParserDeclaration));
+    for(size_t i = 0; i < decls.count; i++) {
+        struct apigen_ParserDeclaration const * const decl = &decls.items[i];
+        encoded[i] = (struct apigen_ParserDeclaration) {
+            .kind          = decl->kind,
+            .documentation = write_string(&writer, decl->documentation),
+            .identifier    = write_string(&writer, decl->identifier),
+            .type          = write_type(&writer, decl->type),
+            .initial_value = write_value(&writer, decl->initial_value),
+            .location      = decl->location,
+            .include_path  = write_string(&writer, decl->include_path),
+        };
+    }
+    header.declarations      = write_bytes(&writer, encoded, decls.count * sizeof(struct apigen_ParserDeclaration), alignof(struct apigen_ParserDeclaration));
+    header.declaration_count = decls.count;
+
+    // all strings are terminated inside the image, even if it is corrupted:
+    image_bytes_append(writer.arena, &writer.bytes, 0);
+
+    header.image_size = writer.bytes.count;
+    memcpy(writer.bytes.items, &header, sizeof header);
+
+    char file_name[32];
+    module_file_name(file_name, sizeof file_name, key);
+
+    // a failure only means that the next run has to parse the file again:
+    (void)apigen_io_replace_file(*state->module_cache, file_name, writer.bytes.items, writer.bytes.count);
+
+    apigen_memory_arena_rewind(state->ast_arena, mark);
+}
+
+// loading images:
+
+APIGEN_DECLARE_ARRAY(IdentifierSlotArray, char const **);
+APIGEN_DEFINE_ARRAY_OPERATORS(IdentifierSlotArray, char const **, identifier_slot_array)
+
+struct ImageReader
+{
+    struct apigen_ParserState * state;
+    char *                      base;
+    size_t                      size;
+    uint32_t                    source; ///< all locations are moved into this source
+    bool                        ok;     ///< cleared when an offset points outside of the image
+
+    struct apigen_MemoryArena * scratch_arena; ///< stores `identifiers`
+    struct IdentifierSlotArray  identifiers;   ///< decoded identifier fields, only interned once the whole image is valid
+};
+
+/// Turns the offset stored in `encoded` back into a pointer to `count` objects of `size` bytes.
+static void * read_offset(struct ImageReader * reader, void const * encoded, size_t count, size_t size, size_t alignment)
+{
+    uintptr_t const offset = (uintptr_t)encoded;
+    if(offset == 0) {
+        return NULL;
+    }
+    if(offset >= reader->size || (offset & (alignment - 1)) != 0 || count > (reader->size - offset) / size) {
+        reader->ok = false;
+        return NULL;
+    }
+    return reader->base + offset;
+}
+
+/// Like `read_offset`, but the objects must end before `parent_offset`, where the object that refers to them starts.
+/// The writer always stores children before their parents, so a valid image never refers back to a node that is
+/// currently decoded, and reading a corrupted one cannot recurse endlessly.
+static void * read_child_offset(struct ImageReader * reader, void const * encoded, size_t count, size_t size, size_t alignment, uintptr_t parent_offset)
+{
+    void * const objects = read_offset(reader, encoded, count, size, alignment);
+    if(objects != NULL && (uintptr_t)encoded + count * size > parent_offset) {
+        reader->ok = false;
+        return NULL;
+    }
+    return objects;
+}
+
+static char const * read_string(struct ImageReader * reader, char const * encoded)
+{
+    return read_offset(reader, encoded, 1, 1, 1);
+}
+
+static void read_identifier(struct ImageReader * reader, char const ** identifier)
+{
+    *identifier = read_string(reader, *identifier);
+
+    // the analyzer compares identifiers by address, so they are interned after the image was accepted:
+    if(*identifier != NULL) {
+        identifier_slot_array_append(reader->scratch_arena, &reader->identifiers, identifier);
+    }
+}
+
+static void read_value(struct ImageReader * reader, struct apigen_Value * value)
+{
+    if(value->type == apigen_value_str) {
+        value->value_str = read_string(reader, value->value_str);
+    }
+}
+
+static void read_type(struct ImageReader * reader, struct apigen_ParserType * type, uintptr_t parent_offset);
+
+static struct apigen_ParserType * read_type_ptr(struct ImageReader * reader, struct apigen_ParserType * encoded, uintptr_t parent_offset)
+{
+    struct apigen_ParserType * const type = read_child_offset(reader, encoded, 1, sizeof(struct apigen_ParserType), alignof(struct apigen_ParserType), parent_offset);
+    if(type != NULL) {
+        read_type(reader, type, (uintptr_t)encoded);
+    }
+    return type;
+}
+
+static void read_fields(struct ImageReader * reader, struct apigen_ParserFieldArray * fields, uintptr_t parent_offset)
+{
+    uintptr_t const array_offset = (uintptr_t)fields->items;
+
+    fields->items = read_child_offset(reader, fields->items, fields->count, sizeof(struct apigen_ParserField), alignof(struct apigen_ParserField), parent_offset);
+    if(fields->items == NULL) {
+        fields->count = 0;
+    }
+    for(size_t i = 0; reader->ok && i < fields->count; i++) {
+        struct apigen_ParserField * const field = &fields->items[i];
+        field->documentation                    = read_string(reader, field->documentation);
+        field->location.source                  = reader->source;
+        read_identifier(reader, &field->identifier);
+        read_type(reader, &field->type, array_offset);
+    }
+}
+
+static void read_enum_items(struct ImageReader * reader, struct apigen_ParserEnumItemArray * items, uintptr_t parent_offset)
+{
+    items->items = read_child_offset(reader, items->items, items->count, sizeof(struct apigen_ParserEnumItem), alignof(struct apigen_ParserEnumItem), parent_offset);
+    if(items->items == NULL) {
+        items->count = 0;
+    }
+    for(size_t i = 0; reader->ok && i < items->count; i++) {
+        struct apigen_ParserEnumItem * const item = &items->items[i];
+        item->documentation                       = read_string(reader, item->documentation);
+        item->location.source                     = reader->source;
+        read_identifier(reader, &item->identifier);
+        read_value(reader, &item->value);
+    }
+}
+
+/// Decodes `type`, which is stored inside of the object at `parent_offset`.
+static void read_type(struct ImageReader * reader, struct apigen_ParserType * type, uintptr_t parent_offset)
+{
+    type->location.source = reader->source;
+    switch(type->type) {
+        case apigen_parser_type_named:
+            read_identifier(reader, &type->named_data);
+            return;
+
+        case apigen_parser_type_enum:
+            type->enum_data.underlying_type = read_type_ptr(reader, type->enum_data.underlying_type, parent_offset);
+            read_enum_items(reader, &type->enum_data.items, parent_offset);
+            return;
+
+        case apigen_parser_type_struct:
+        case apigen_parser_type_union:
+            read_fields(reader, &type->union_struct_fields, parent_offset);
+            return;
+
+        case apigen_parser_type_array:
+            type->array_data.underlying_type = read_type_ptr(reader, type->array_data.underlying_type, parent_offset);
+            read_value(reader, &type->array_data.size);
+            return;
+
+        case apigen_parser_type_ptr_to_one:
+        case apigen_parser_type_ptr_to_many:
+        case apigen_parser_type_ptr_to_many_sentinelled:
+            type->pointer_data.underlying_type = read_type_ptr(reader, type->pointer_data.underlying_type, parent_offset);
+            read_value(reader, &type->pointer_data.sentinel);
+            return;
+
+        case apigen_parser_type_function:
+            type->function_data.return_type = read_type_ptr(reader, type->function_data.return_type, parent_offset);
+            read_fields(reader, &type->function_data.parameters, parent_offset);
+            return;
+
+        case apigen_parser_type_opaque:
+            return;
+    }
+    reader->ok = false; // unknown type id
+}
+
+bool apigen_parser_load_module(struct apigen_ParserState * state, uint64_t key, size_t source_length, struct apigen_ParserDeclarationArray * out_decls)
+{
+    APIGEN_NOT_NULL(state);
+    APIGEN_NOT_NULL(state->module_cache);
+    APIGEN_NOT_NULL(out_decls);
+
+    char file_name[32];
+    module_file_name(file_name, sizeof file_name, key);
+
+    struct apigen_Stream file;
+    if(!apigen_io_open_file_read_optional(*state->module_cache, file_name, &file)) {
+        return false;
+    }
+
+    size_t             image_size;
+    char const * const image = apigen_io_map(file, &image_size);
+
+    struct ModuleImageHeader header;
+    bool valid = (image != NULL) && (image_size >= sizeof header);
+    if(valid) {
+        memcpy(&header, image, sizeof header);
+        valid = (memcmp(header.magic, MODULE_IMAGE_MAGIC, sizeof header.magic) == 0)
+             && (header.version == MODULE_IMAGE_VERSION)
+             && (header.key == key)
+             && (header.source_length == source_length)
+             && (header.image_size == image_size)
+             && (image[image_size - 1] == 0);
+    }
+    if(!valid) {
+        apigen_io_close(&file);
+        return false;
+    }
+
+    // a rejected image is released again, nothing else is allocated from the arena until then:
+    struct apigen_MemoryArenaMark const mark = apigen_memory_arena_mark(state->ast_arena);
+
+    struct apigen_MemoryArena scratch_arena;
+    apigen_memory_arena_init(&scratch_arena);
+
+    struct ImageReader reader = {
+        .state  = state,
+        .base   = NULL,
+        .size   = image_size,
+        .source = state->source_index,
+        .ok     = true,
+
+        .scratch_arena = &scratch_arena,
+        .identifiers   = { 0 },
+    };
+
+    // The image is copied, so the AST does not depend on the lifetime of the mapping:
+    reader.base = apigen_memory_arena_alloc(state->ast_arena, image_size);
+    memcpy(reader.base, image, image_size);
+    apigen_io_close(&file);
+
+    struct apigen_ParserDeclarationArray decls = {
+        .count    = (size_t)header.declaration_count,
+        .capacity = (size_t)header.declaration_count,
+        .items    = read_offset(&reader, ENCODE_OFFSET(void const *, (uintptr_t)header.declarations), (size_t)header.declaration_count, sizeof(struct apigen_ParserDeclaration), alignof(struct apigen_ParserDeclaration)),
+    };
+    if(decls.items == NULL) {
+        decls.count = 0;
+    }
+    for(size_t i = 0; reader.ok && i < decls.count; i++) {
+        struct apigen_ParserDeclaration * const decl = &decls.items[i];
+        if(decl->kind > apigen_parser_include_declaration) {
+            reader.ok = false;
+            break;
+        }
+        decl->documentation                         = read_string(&reader, decl->documentation);
+        decl->include_path                          = read_string(&reader, decl->include_path);
+        decl->location.source                       = reader.source;
+        decl->associated_type                       = NULL;
+        read_identifier(&reader, &decl->identifier);
+        read_type(&reader, &decl->type, (uintptr_t)header.declarations);
+        read_value(&reader, &decl->initial_value);
+
+        // the parser never creates these, but the analyzer relies on them:
+        if(decl->kind == apigen_parser_include_declaration) {
+            if(decl->include_path == NULL) {
+                reader.ok = false;
+            }
+        }
+        else if(decl->identifier == NULL) {
+            reader.ok = false;
+        }
+    }
+
+    if(reader.ok) {
+        for(size_t i = 0; i < reader.identifiers.count; i++) {
+            char const ** const identifier = reader.identifiers.items[i];
+            *identifier = apigen_string_pool_intern(state->strings, *identifier);
+        }
+        apigen_memory_arena_keep(state->ast_arena, mark);
+    }
+    else {
+        // Corrupted images are treated like missing ones and are replaced after parsing.
+        apigen_memory_arena_rewind(state->ast_arena, mark);
+    }
+
+    apigen_memory_arena_deinit(&scratch_arena);
+
+    if(!reader.ok) {
+        return false;
+    }
+
+    *out_decls = decls;
+    return true;
+}
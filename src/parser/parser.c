@@ -1,37 +1,289 @@
 #include "parser.h"
 #include "apigen.h"
 
+#include <pthread.h>
+#include <stdalign.h>
+#include <string.h>
+
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wreserved-macro-identifier" // is generated by flex/bison
+#ifdef APIGEN_USE_HANDWRITTEN_LEXER
+#include "lexer.h"
+#else
 #include "lexer.yy.h"
+#endif
+#ifdef APIGEN_USE_RECURSIVE_DESCENT_PARSER
+#include "descent.h"
+#else
 #include "parser.yy.h"
+#endif
 #pragma clang diagnostic pop
 
-struct apigen_ParserDeclaration EMPTY_DOCUMENT_SENTINEL;
+/// Lets the scanner work directly on the memory-mapped input file, if the
+/// stream supports it. Otherwise, the scanner will pull the input through `YY_INPUT`.
+static void scan_mapped_input(struct apigen_ParserState * state, yyscan_t scanner)
+{
+    size_t length;
+    char * const source = apigen_io_map(state->file, &length);
+    if(source != NULL) {
+        apigen_parser_scan_lines(state, source, length);
+
+        // flex requires two terminating zero bytes, which are provided by apigen_io_map():
+        apigen_parser__scan_buffer(source, length + 2, scanner);
+    }
+}
+
+/// Parses `state->file` into `state->top_level_declarations` and returns the result of the parser.
+static int run_parser(struct apigen_ParserState * state)
+{
+    yyscan_t scanner;
+    apigen_parser_lex_init_extra (state, &scanner);
+    scan_mapped_input(state, scanner);
+
+    int const result = apigen_parser_parse(scanner, state);
+
+    apigen_parser_lex_destroy(scanner);
+
+    return result;
+}
+
+APIGEN_DEFINE_ARRAY_OPERATORS(apigen_ParserLineStartArray, uint32_t, line_start_array)
+APIGEN_DEFINE_ARRAY_OPERATORS(apigen_ParserSourceArray, struct apigen_ParserSource, source_array)
+
+/// A slot is empty if `used` is not set.
+struct ParserFileMapSlot
+{
+    struct apigen_FileId file_id;
+    size_t               index;
+    bool                 used;
+};
+
+/// Maps file ids to indices, implemented as an open addressing hash table.
+struct apigen_ParserFileMap
+{
+    struct apigen_MemoryArena * arena;
+    struct ParserFileMapSlot *  slots;
+    size_t                      slot_count; ///< always a power of two
+    size_t                      count;
+};
+
+/// Number of slots of a fresh map.
+static size_t const FILE_MAP_INITIAL_SLOTS = 16;
+
+static size_t hash_file_id(struct apigen_FileId file_id)
+{
+    // inodes are mostly sequential, so they are mixed with a multiplicative hash:
+    uint64_t const hash = (file_id.inode ^ (file_id.device * 0x9E3779B97F4A7C15ULL)) * 0xBF58476D1CE4E5B9ULL;
+    return (size_t)(hash ^ (hash >> 32));
+}
+
+static struct ParserFileMapSlot * alloc_file_map_slots(struct apigen_MemoryArena * arena, size_t slot_count)
+{
+    struct ParserFileMapSlot * const slots = apigen_memory_arena_alloc_aligned(arena, slot_count * sizeof(struct ParserFileMapSlot), alignof(struct ParserFileMapSlot));
+    memset(slots, 0, slot_count * sizeof(struct ParserFileMapSlot));
+    return slots;
+}
+
+/// Returns the slot that contains `file_id`, or the empty slot where it belongs.
+static struct ParserFileMapSlot * find_file_map_slot(struct ParserFileMapSlot * slots, size_t slot_count, struct apigen_FileId file_id)
+{
+    size_t const mask = slot_count - 1;
+
+    size_t index = hash_file_id(file_id) & mask;
+    while(true) {
+        struct ParserFileMapSlot * const slot = &slots[index];
+        if(!slot->used || (slot->file_id.device == file_id.device && slot->file_id.inode == file_id.inode)) {
+            return slot;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+static struct apigen_ParserFileMap * create_file_map(struct apigen_MemoryArena * arena)
+{
+    struct apigen_ParserFileMap * const map = apigen_memory_arena_alloc_aligned(arena, sizeof(struct apigen_ParserFileMap), alignof(struct apigen_ParserFileMap));
+    *map = (struct apigen_ParserFileMap) {
+        .arena      = arena,
+        .slots      = alloc_file_map_slots(arena, FILE_MAP_INITIAL_SLOTS),
+        .slot_count = FILE_MAP_INITIAL_SLOTS,
+        .count      = 0,
+    };
+    return map;
+}
+
+/// Returns `true` and stores the index of `file_id` in `out_index` if the map contains it.
+static bool file_map_find(struct apigen_ParserFileMap const * map, struct apigen_FileId file_id, size_t * out_index)
+{
+    struct ParserFileMapSlot const * const slot = find_file_map_slot(map->slots, map->slot_count, file_id);
+    if(slot->used) {
+        *out_index = slot->index;
+    }
+    return slot->used;
+}
+
+/// Adds `file_id`, which must not be in the map yet.
+static void file_map_insert(struct apigen_ParserFileMap * map, struct apigen_FileId file_id, size_t index)
+{
+    // keep the load factor below 3/4:
+    if(4 * (map->count + 1) > 3 * map->slot_count) {
+        size_t const                     new_slot_count = 2 * map->slot_count;
+        struct ParserFileMapSlot * const new_slots      = alloc_file_map_slots(map->arena, new_slot_count);
+        for(size_t i = 0; i < map->slot_count; i++) {
+            if(map->slots[i].used) {
+                *find_file_map_slot(new_slots, new_slot_count, map->slots[i].file_id) = map->slots[i];
+            }
+        }
+        map->slots      = new_slots;
+        map->slot_count = new_slot_count;
+    }
+
+    struct ParserFileMapSlot * const slot = find_file_map_slot(map->slots, map->slot_count, file_id);
+    APIGEN_ASSERT(!slot->used);
+    *slot = (struct ParserFileMapSlot) {
+        .file_id = file_id,
+        .index   = index,
+        .used    = true,
+    };
+    map->count += 1;
+}
+
+/// Appends `source` to the sources of `state`.
+static void append_source(struct apigen_ParserState * state, struct apigen_ParserSource source)
+{
+    APIGEN_ASSERT(state->sources->count < UINT32_MAX);
+    if(source.has_file_id) {
+        file_map_insert(state->source_ids, source.file_id, state->sources->count);
+    }
+    source_array_append(state->ast_arena, state->sources, source);
+}
+
+bool apigen_parser_begin_source(struct apigen_ParserState * state, char const * file_name)
+{
+    APIGEN_NOT_NULL(state);
+    APIGEN_NOT_NULL(state->sources);
+    APIGEN_NOT_NULL(state->source_ids);
+
+    struct apigen_ParserSource source = {
+        .file_name = file_name,
+    };
+    source.has_file_id = apigen_io_identify(state->file, &source.file_id);
+
+    size_t other_index;
+    if(source.has_file_id && file_map_find(state->source_ids, source.file_id, &other_index)) {
+        return false;
+    }
+
+    line_start_array_append(state->ast_arena, &source.line_starts, 0);
+
+    state->source_index = (uint32_t)state->sources->count;
+    state->offset       = 0;
+    append_source(state, source);
+    return true;
+}
+
+void apigen_parser_scan_lines(struct apigen_ParserState * state, char const * text, size_t length)
+{
+    APIGEN_NOT_NULL(state);
+    APIGEN_NOT_NULL(text);
+    APIGEN_ASSERT(state->source_index < state->sources->count);
+
+    struct apigen_ParserSource * const source = &state->sources->items[state->source_index];
+    APIGEN_ASSERT(length <= UINT32_MAX - source->length); // offsets are 32 bit
+
+    // memchr() is vectorized by the C library:
+    char const * const end  = text + length;
+    char const *       iter = text;
+    while(iter < end) {
+        char const * const line_feed = memchr(iter, '\n', (size_t)(end - iter));
+        if(line_feed == NULL) {
+            break;
+        }
+        iter = line_feed + 1;
+        line_start_array_append(state->ast_arena, &source->line_starts, source->length + (uint32_t)(iter - text));
+    }
+    source->length += (uint32_t)length;
+}
+
+void apigen_parser_resolve_location(struct apigen_ParserState const * state, struct apigen_ParserLocation location, char const ** out_file_name, uint32_t * out_line, uint32_t * out_column)
+{
+    APIGEN_NOT_NULL(state);
+    APIGEN_NOT_NULL(state->sources);
+    APIGEN_NOT_NULL(out_file_name);
+    APIGEN_NOT_NULL(out_line);
+    APIGEN_NOT_NULL(out_column);
+    APIGEN_ASSERT(location.source < state->sources->count);
+
+    struct apigen_ParserSource const * const source = &state->sources->items[location.source];
+    uint32_t const * const line_starts = source->line_starts.items;
+    APIGEN_ASSERT(source->line_starts.count > 0);
+
+    // find the last line starting at or before the offset:
+    size_t lo = 0;
+    size_t hi = source->line_starts.count;
+    while(hi - lo > 1) {
+        size_t const mid = lo + (hi - lo) / 2;
+        if(line_starts[mid] <= location.offset) {
+            lo = mid;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    *out_file_name = source->file_name;
+    *out_line      = (uint32_t)lo;
+    *out_column    = location.offset - line_starts[lo];
+}
+
+static bool parse_with_include_workers(struct apigen_ParserState * state);
 
 bool apigen_parse(struct apigen_ParserState * state)
 {
     APIGEN_NOT_NULL(state);
 
-    APIGEN_ASSERT(state->top_level_declarations == NULL);
+    APIGEN_ASSERT(state->top_level_declarations.count == 0);
+
+    if(state->strings == NULL) {
+        // identifiers are referenced by the analyzed document, so they must outlive the AST:
+        struct apigen_MemoryArena * const strings_arena = (state->document_arena != NULL) ? state->document_arena : state->ast_arena;
+        state->strings = apigen_memory_arena_alloc_aligned(strings_arena, sizeof(struct apigen_StringPool), alignof(struct apigen_StringPool));
+        apigen_string_pool_init(state->strings, strings_arena);
+    }
+    if(state->sources == NULL) {
+        state->sources = apigen_memory_arena_alloc_aligned(state->ast_arena, sizeof(struct apigen_ParserSourceArray), alignof(struct apigen_ParserSourceArray));
+        *state->sources = (struct apigen_ParserSourceArray) { 0 };
+    }
+    if(state->source_ids == NULL) {
+        state->source_ids = create_file_map(state->ast_arena);
+        for(size_t i = 0; i < state->sources->count; i++) {
+            if(state->sources->items[i].has_file_id) {
+                file_map_insert(state->source_ids, state->sources->items[i].file_id, i);
+            }
+        }
+    }
+
+    if(state->jobs > 1) {
+        enum apigen_MemoryTag const previous_tag = apigen_memory_set_tag(APIGEN_MEMORY_TAG_PARSER);
+        bool const ok = parse_with_include_workers(state);
+        apigen_memory_set_tag(previous_tag);
+        return ok;
+    }
+
+    bool const is_new_source = apigen_parser_begin_source(state, state->file_name);
+    APIGEN_ASSERT(is_new_source); // sources are only shared with includes
 
     {
-        yyscan_t scanner;
-        apigen_parser_lex_init_extra (state, &scanner);
+        enum apigen_MemoryTag const previous_tag = apigen_memory_set_tag(APIGEN_MEMORY_TAG_PARSER);
 
-        int const lex_result = apigen_parser_parse(scanner, state);
+        int const lex_result = run_parser(state);
 
-        apigen_parser_lex_destroy(scanner);
+        apigen_memory_set_tag(previous_tag);
 
         if (lex_result != 0) {
             return false;
         }
     }
 
-    if(state->top_level_declarations == &EMPTY_DOCUMENT_SENTINEL) {
-        state->top_level_declarations = NULL;
-    }
-
     return true;
 }
 
@@ -104,40 +356,641 @@ static void split_include_path(char const * include_path, size_t * name_head)
     }
 }
 
-struct apigen_ParserDeclaration * apigen_parser_file_include(
+APIGEN_DEFINE_ARRAY_OPERATORS(apigen_ParserEnumItemArray, struct apigen_ParserEnumItem, enum_item_array)
+APIGEN_DEFINE_ARRAY_OPERATORS(apigen_ParserFieldArray, struct apigen_ParserField, field_array)
+APIGEN_DEFINE_ARRAY_OPERATORS(apigen_ParserDeclarationArray, struct apigen_ParserDeclaration, declaration_array)
+APIGEN_DEFINE_ARRAY_OPERATORS(apigen_ParserTextFragmentArray, char const *, fragment_array)
+
+/// Adds the placeholder for an include directive, it is later replaced by the declarations of the included file.
+static void append_include_placeholder(struct apigen_ParserState * state, struct apigen_ParserDeclarationArray * decls, struct apigen_ParserLocation location, char const * include_path)
+{
+    declaration_array_append(state->ast_arena, decls, (struct apigen_ParserDeclaration) {
+        .kind         = apigen_parser_include_declaration,
+        .location     = location,
+        .include_path = include_path,
+    });
+}
+
+/// Replaces all include placeholders in `decls` by including the file in place, or by queuing it for an include worker.
+static struct apigen_ParserDeclarationArray expand_includes(struct apigen_ParserState * state, struct apigen_ParserDeclarationArray decls)
+{
+    struct apigen_ParserDeclarationArray result = { 0 };
+    for(size_t i = 0; i < decls.count; i++) {
+        struct apigen_ParserDeclaration const * const decl = &decls.items[i];
+        if(decl->kind == apigen_parser_include_declaration) {
+            result = apigen_parser_file_include(state, decl->location, result, decl->include_path);
+        }
+        else {
+            declaration_array_append(state->ast_arena, &result, *decl);
+        }
+    }
+    return result;
+}
+
+/// Parses `state->file` with all includes kept as placeholders, or loads the same result from the module cache.
+/// Files that had to be parsed are added to the cache.
+static bool parse_module(struct apigen_ParserState * state, struct apigen_ParserDeclarationArray * out_decls)
+{
+    APIGEN_NOT_NULL(state->module_cache);
+    APIGEN_ASSERT(!state->keep_includes);
+
+    size_t             length;
+    char const * const text = apigen_io_map(state->file, &length);
+
+    uint64_t key = 0;
+    if(text != NULL) {
+        key = apigen_parser_module_key(state, text, length);
+        if(apigen_parser_load_module(state, key, length, out_decls)) {
+            // diagnostics still need the line starts:
+            apigen_parser_scan_lines(state, text, length);
+            return true;
+        }
+    }
+
+    state->keep_includes = true;
+    int const lex_result = run_parser(state);
+    state->keep_includes = false;
+
+    if(lex_result != 0) {
+        return false;
+    }
+
+    *out_decls = state->top_level_declarations;
+    if(text != NULL) {
+        apigen_parser_store_module(state, key, length, *out_decls);
+    }
+    return true;
+}
+
+// Parallel include parsing:
+//
+// With `apigen_ParserState.jobs` set, every file is parsed by a job on a pool of worker threads.
+// When a worker encounters an include, the file is only queued as a new job, and a placeholder
+// declaration is put into the AST. Each job owns its arena, string pool, diagnostics and sources,
+// so workers never share mutable state except for the queue itself.
+// Once all jobs are done, the results are copied into the root state by walking the placeholders
+// in source order. This yields the same declarations and diagnostics as parsing the includes in place.
+
+APIGEN_DECLARE_ARRAY(IncludeJobArray, struct apigen_ParserIncludeJob *);
+APIGEN_DEFINE_ARRAY_OPERATORS(IncludeJobArray, struct apigen_ParserIncludeJob *, include_job_array)
+
+/// An include directive that was deferred to a job.
+struct IncludeSite
+{
+    struct apigen_ParserIncludeJob * job;
+    char const *                     include_path;     ///< the include path as written, stored in the arena of the including file
+    struct apigen_ParserLocation     location;         ///< location of the directive in the including file
+    size_t                           diagnostic_count; ///< number of diagnostics the including file had emitted before the directive
+};
+
+APIGEN_DECLARE_ARRAY(IncludeSiteArray, struct IncludeSite);
+APIGEN_DEFINE_ARRAY_OPERATORS(IncludeSiteArray, struct IncludeSite, include_site_array)
+
+struct IncludeQueue
+{
+    pthread_mutex_t lock;
+    pthread_cond_t  wakeup; ///< signalled when a job is queued or the last job is done
+
+    struct apigen_Directory     source_dir; ///< directory of the root file, all job paths are relative to it
+    char const *                line_feed;
+    struct apigen_Directory const * module_cache;
+    bool                        skip_documentation;
+    struct apigen_MemoryArena * arena; ///< stores the jobs, must only be used while holding `lock`
+
+    struct apigen_ParserIncludeJob * root;    ///< the only job that is not opened by the workers
+    struct IncludeJobArray           jobs;    ///< all files in order of discovery
+    struct apigen_ParserFileMap *    job_ids; ///< maps file ids to the index of their job in `jobs`
+    size_t                 next_job;     ///< index of the first job that was not taken by a worker yet
+    size_t                 busy_workers; ///< number of workers that currently parse a file
+};
+
+struct apigen_ParserIncludeJob
+{
+    struct IncludeQueue * queue;
+
+    char const *         path;      ///< path of the file relative to `queue->source_dir`
+    char const *         file_name; ///< the include path of whichever directive queued the job first, only used while parsing
+    struct apigen_Stream file;      ///< the stream of the root file, workers open all other files by `path`
+    bool                 has_file_id;
+    struct apigen_FileId file_id;
+
+    struct apigen_MemoryArena            arena;
+    struct apigen_StringPool             strings;
+    struct apigen_Diagnostics            diagnostics;
+    struct apigen_ParserSourceArray      sources;
+    struct apigen_ParserDeclarationArray declarations;
+    struct IncludeSiteArray              includes; ///< the directive of each include placeholder in `declarations`
+
+    bool ok;       ///< the file was parsed without syntax errors
+    bool missing;  ///< the file was removed after it was queued, it is reported at the include directives
+    bool imported; ///< the results were already copied into the root state
+};
+
+/// Appends a new job to `queue`. `file_id` is `NULL` if the file cannot be identified. The queue lock must be held.
+static struct apigen_ParserIncludeJob * create_include_job(struct IncludeQueue * queue, char const * path, char const * file_name, struct apigen_FileId const * file_id)
+{
+    struct apigen_ParserIncludeJob * const job = apigen_memory_arena_alloc_aligned(queue->arena, sizeof(struct apigen_ParserIncludeJob), alignof(struct apigen_ParserIncludeJob));
+    *job = (struct apigen_ParserIncludeJob) {
+        .queue = queue,
+        .file  = apigen_io_null,
+    };
+    apigen_memory_arena_init(&job->arena);
+    apigen_string_pool_init(&job->strings, &job->arena);
+    apigen_diagnostics_init(&job->diagnostics, &job->arena);
+
+    // the job must not refer to the arena of the including file, as that is released first:
+    job->path      = apigen_memory_arena_dupestr(&job->arena, path);
+    job->file_name = apigen_memory_arena_dupestr(&job->arena, file_name);
+
+    if(file_id != NULL) {
+        job->has_file_id = true;
+        job->file_id     = *file_id;
+        file_map_insert(queue->job_ids, *file_id, queue->jobs.count);
+    }
+
+    include_job_array_append(queue->arena, &queue->jobs, job);
+    return job;
+}
+
+/// Returns the job that parses the file with `file_id`, or `NULL`. The queue lock must be held.
+static struct apigen_ParserIncludeJob * find_include_job(struct IncludeQueue const * queue, struct apigen_FileId file_id)
+{
+    size_t index;
+    return file_map_find(queue->job_ids, file_id, &index) ? queue->jobs.items[index] : NULL;
+}
+
+/// Queues the file at `include_path` for parsing and adds a placeholder for its declarations to `previous_decls`.
+static struct apigen_ParserDeclarationArray defer_include(
+    struct apigen_ParserState * state,
+    struct apigen_ParserLocation location,
+    struct apigen_ParserDeclarationArray previous_decls,
+    char const * include_path
+)
+{
+    struct apigen_ParserIncludeJob * const includer = state->include_job;
+    struct IncludeQueue * const            queue    = includer->queue;
+
+    // Paths are kept relative to the root directory, so pending jobs do not hold any directory handles:
+    char const * const dir_end        = strrchr(includer->path, '/');
+    size_t const       dir_length     = (dir_end != NULL) ? (size_t)(dir_end - includer->path + 1) : 0;
+    size_t const       include_length = strlen(include_path);
+
+    char * const path = apigen_memory_arena_alloc_packed(state->ast_arena, dir_length + include_length + 1);
+    memcpy(path, includer->path, dir_length);
+    memcpy(path + dir_length, include_path, include_length + 1);
+
+    // The file is only opened here to report missing files at the include site
+    // and to detect files that are already queued:
+    struct apigen_Stream file;
+    if(!apigen_io_open_file_read(queue->source_dir, path, &file)) {
+        char const * location_file_name;
+        uint32_t     location_line, location_column;
+        apigen_parser_resolve_location(state, location, &location_file_name, &location_line, &location_column);
+
+        apigen_diagnostics_emit(
+            state->diagnostics,
+            location_file_name,
+            location_line,
+            location_column,
+            apigen_error_missing_include_file,
+            include_path
+        );
+        return previous_decls; // continue lexing, but emit error
+    }
+    struct apigen_FileId file_id;
+    bool const           has_file_id = apigen_io_identify(file, &file_id);
+    apigen_io_close(&file);
+
+    pthread_mutex_lock(&queue->lock);
+    struct apigen_ParserIncludeJob * job = has_file_id ? find_include_job(queue, file_id) : NULL;
+    if(job == NULL) {
+        job = create_include_job(queue, path, include_path, has_file_id ? &file_id : NULL);
+        pthread_cond_signal(&queue->wakeup);
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    include_site_array_append(state->ast_arena, &includer->includes, (struct IncludeSite) {
+        .job              = job,
+        .include_path     = include_path,
+        .location         = location,
+        .diagnostic_count = state->diagnostics->items.count,
+    });
+
+    append_include_placeholder(state, &previous_decls, location, include_path);
+    return previous_decls;
+}
+
+static void parse_include_job(struct apigen_ParserIncludeJob * job)
+{
+    struct IncludeQueue const * const queue = job->queue;
+
+    struct apigen_ParserState state = {
+        .source_dir = queue->source_dir,
+
+        .file      = job->file,
+        .file_name = job->file_name,
+
+        .ast_arena = &job->arena,
+        .line_feed = queue->line_feed,
+
+        .skip_documentation = queue->skip_documentation,
+
+        .diagnostics  = &job->diagnostics,
+        .strings      = &job->strings,
+        .sources      = &job->sources,
+        .source_ids   = create_file_map(&job->arena),
+        .module_cache = queue->module_cache,
+        .include_job  = job,
+
+        .top_level_declarations = { 0 },
+    };
+
+    bool const owns_file = (job != queue->root);
+    if(owns_file && !apigen_io_open_file_read(queue->source_dir, job->path, &state.file)) {
+        job->missing = true;
+        return;
+    }
+
+    bool const is_new_source = apigen_parser_begin_source(&state, job->file_name);
+    APIGEN_ASSERT(is_new_source); // every job has its own sources
+
+    // the root file is never cached, only included files are:
+    if(owns_file && state.module_cache != NULL) {
+        struct apigen_ParserDeclarationArray decls;
+        job->ok = parse_module(&state, &decls);
+        if(job->ok) {
+            state.top_level_declarations = expand_includes(&state, decls);
+        }
+    }
+    else {
+        job->ok = (run_parser(&state) == 0);
+    }
+
+    if(owns_file) {
+        apigen_io_close(&state.file);
+    }
+
+    job->declarations = state.top_level_declarations;
+}
+
+/// Parses queued jobs until all jobs are done.
+static void run_include_worker(struct IncludeQueue * queue)
+{
+    pthread_mutex_lock(&queue->lock);
+    while(true) {
+        if(queue->next_job < queue->jobs.count) {
+            struct apigen_ParserIncludeJob * const job = queue->jobs.items[queue->next_job];
+            queue->next_job += 1;
+            queue->busy_workers += 1;
+            pthread_mutex_unlock(&queue->lock);
+
+            parse_include_job(job);
+
+            pthread_mutex_lock(&queue->lock);
+            queue->busy_workers -= 1;
+            if(queue->busy_workers == 0 && queue->next_job == queue->jobs.count) {
+                pthread_cond_broadcast(&queue->wakeup);
+            }
+        }
+        else if(queue->busy_workers == 0) {
+            // nothing is queued, and no running job can queue more:
+            break;
+        }
+        else {
+            pthread_cond_wait(&queue->wakeup, &queue->lock);
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static void * include_worker_thread(void * queue)
+{
+    apigen_memory_set_tag(APIGEN_MEMORY_TAG_PARSER);
+    run_include_worker(queue);
+    apigen_memory_flush_thread_stats();
+    return NULL;
+}
+
+static char const * import_string(struct apigen_ParserState * state, char const * str)
+{
+    return apigen_memory_arena_dupestr(state->ast_arena, str);
+}
+
+static char const * import_identifier(struct apigen_ParserState * state, char const * identifier)
+{
+    // all identifiers must come from the same pool, as the analyzer compares them by address:
+    return (identifier != NULL) ? apigen_string_pool_intern(state->strings, identifier) : NULL;
+}
+
+static struct apigen_Value import_value(struct apigen_ParserState * state, struct apigen_Value value)
+{
+    if(value.type == apigen_value_str) {
+        value.value_str = import_string(state, value.value_str);
+    }
+    return value;
+}
+
+static struct apigen_ParserType import_type(struct apigen_ParserState * state, uint32_t source, struct apigen_ParserType type);
+
+static struct apigen_ParserType * import_type_ptr(struct apigen_ParserState * state, uint32_t source, struct apigen_ParserType const * type)
+{
+    return (type != NULL) ? apigen_parser_heapify_type(state, import_type(state, source, *type)) : NULL;
+}
+
+static struct apigen_ParserFieldArray import_fields(struct apigen_ParserState * state, uint32_t source, struct apigen_ParserFieldArray fields)
+{
+    struct apigen_ParserFieldArray result = { 0 };
+    for(size_t i = 0; i < fields.count; i++) {
+        struct apigen_ParserField const * const field = &fields.items[i];
+        field_array_append(state->ast_arena, &result, (struct apigen_ParserField) {
+            .documentation = import_string(state, field->documentation),
+            .identifier    = import_identifier(state, field->identifier),
+            .type          = import_type(state, source, field->type),
+            .location      = { .source = source, .offset = field->location.offset },
+        });
+    }
+    return result;
+}
+
+/// Copies `type` from the arena of a job into the root state, `source` is the index of the job's file in the root state.
+static struct apigen_ParserType import_type(struct apigen_ParserState * state, uint32_t source, struct apigen_ParserType type)
+{
+    type.location.source = source;
+    switch(type.type) {
+        case apigen_parser_type_named:
+            type.named_data = import_identifier(state, type.named_data);
+            break;
+
+        case apigen_parser_type_enum: {
+            struct apigen_ParserEnumItemArray const items = type.enum_data.items;
+
+            type.enum_data.underlying_type = import_type_ptr(state, source, type.enum_data.underlying_type);
+            type.enum_data.items           = (struct apigen_ParserEnumItemArray) { 0 };
+            for(size_t i = 0; i < items.count; i++) {
+                struct apigen_ParserEnumItem const * const item = &items.items[i];
+                enum_item_array_append(state->ast_arena, &type.enum_data.items, (struct apigen_ParserEnumItem) {
+                    .documentation = import_string(state, item->documentation),
+                    .identifier    = import_identifier(state, item->identifier),
+                    .value         = import_value(state, item->value),
+                    .location      = { .source = source, .offset = item->location.offset },
+                });
+            }
+            break;
+        }
+
+        case apigen_parser_type_struct:
+        case apigen_parser_type_union:
+            type.union_struct_fields = import_fields(state, source, type.union_struct_fields);
+            break;
+
+        case apigen_parser_type_array:
+            type.array_data.underlying_type = import_type_ptr(state, source, type.array_data.underlying_type);
+            type.array_data.size            = import_value(state, type.array_data.size);
+            break;
+
+        case apigen_parser_type_ptr_to_one:
+        case apigen_parser_type_ptr_to_many:
+        case apigen_parser_type_ptr_to_many_sentinelled:
+            type.pointer_data.underlying_type = import_type_ptr(state, source, type.pointer_data.underlying_type);
+            type.pointer_data.sentinel        = import_value(state, type.pointer_data.sentinel);
+            break;
+
+        case apigen_parser_type_function:
+            type.function_data.return_type = import_type_ptr(state, source, type.function_data.return_type);
+            type.function_data.parameters  = import_fields(state, source, type.function_data.parameters);
+            break;
+
+        case apigen_parser_type_opaque:
+            break;
+    }
+    return type;
+}
+
+static void release_include_job(struct apigen_ParserIncludeJob * job)
+{
+    apigen_diagnostics_deinit(&job->diagnostics);
+    apigen_memory_arena_deinit(&job->arena);
+}
+
+/// Copies the diagnostics of `job` up to `count` into `state`, `merged_count` is the number of already copied ones.
+/// All diagnostics of a job are in its own file, which is reported as `file_name`.
+static void merge_job_diagnostics(struct apigen_ParserState * state, struct apigen_ParserIncludeJob const * job, char const * file_name, size_t * merged_count, size_t count)
+{
+    apigen_diagnostics_merge_range(state->diagnostics, &job->diagnostics, *merged_count, count - *merged_count, file_name);
+    *merged_count = count;
+}
+
+static void import_include_job(struct apigen_ParserState * state, struct apigen_ParserIncludeJob * job, char const * file_name, struct apigen_ParserDeclarationArray * out_decls);
+
+/// Imports the file included by `site`, which is a directive of the file that was imported as `includer_source`.
+static void import_include_site(struct apigen_ParserState * state, uint32_t includer_source, struct IncludeSite const * site, struct apigen_ParserDeclarationArray * out_decls)
+{
+    struct apigen_ParserIncludeJob * const included = site->job;
+
+    if(included->missing) {
+        // reported at every directive, just like a file that is missing right away:
+        char const * location_file_name;
+        uint32_t     location_line, location_column;
+        apigen_parser_resolve_location(state, (struct apigen_ParserLocation) { .source = includer_source, .offset = site->location.offset }, &location_file_name, &location_line, &location_column);
+
+        apigen_diagnostics_emit(
+            state->diagnostics,
+            location_file_name,
+            location_line,
+            location_column,
+            apigen_error_missing_include_file,
+            site->include_path
+        );
+        if(!included->imported) {
+            included->imported = true;
+            release_include_job(included);
+        }
+        return;
+    }
+
+    if(!included->imported) {
+        import_include_job(state, included, site->include_path, out_decls);
+    }
+}
+
+/// Copies the results of `job` into `state`, and replaces its include placeholders with the declarations
+/// of the included files. Declarations are appended to `out_decls`, or dropped if it is `NULL`.
+/// Files that were already imported are skipped, just like `apigen_parser_begin_source` skips them.
+/// The file is named `file_name`, which is the first directive in source order that includes it, like
+/// with parsing the includes in place. The diagnostics are split at the include directives, so the
+/// diagnostics of the included files appear in between.
+static void import_include_job(struct apigen_ParserState * state, struct apigen_ParserIncludeJob * job, char const * file_name, struct apigen_ParserDeclarationArray * out_decls)
+{
+    APIGEN_ASSERT(!job->imported);
+    job->imported = true;
+
+    uint32_t const source = (uint32_t)state->sources->count;
+    if(job->sources.count > 0) {
+        APIGEN_ASSERT(job->sources.count == 1);
+        APIGEN_ASSERT(state->sources->count < UINT32_MAX);
+        struct apigen_ParserSource const * const job_source = &job->sources.items[0];
+
+        struct apigen_ParserSource imported = {
+            .file_name   = import_string(state, file_name),
+            .file_id     = job_source->file_id,
+            .has_file_id = job_source->has_file_id,
+            .length      = job_source->length,
+        };
+        line_start_array_append_all(state->ast_arena, &imported.line_starts, job_source->line_starts.items, job_source->line_starts.count);
+        append_source(state, imported);
+    }
+
+    // A file with syntax errors contributes no declarations, so `includes` is walked on its own
+    // afterwards. Its includes are still imported to keep their diagnostics and include-once semantics.
+    struct apigen_ParserDeclarationArray * const decls = job->ok ? out_decls : NULL;
+
+    size_t merged_diagnostics = 0;
+    size_t include_index      = 0;
+    for(size_t i = 0; i < job->declarations.count; i++) {
+        struct apigen_ParserDeclaration const * const decl = &job->declarations.items[i];
+
+        if(decl->kind == apigen_parser_include_declaration) {
+            APIGEN_ASSERT(include_index < job->includes.count);
+            struct IncludeSite const * const site = &job->includes.items[include_index];
+            include_index += 1;
+
+            merge_job_diagnostics(state, job, file_name, &merged_diagnostics, site->diagnostic_count);
+            import_include_site(state, source, site, decls);
+        }
+        else if(decls != NULL) {
+            declaration_array_append(state->ast_arena, decls, (struct apigen_ParserDeclaration) {
+                .kind          = decl->kind,
+                .documentation = import_string(state, decl->documentation),
+                .identifier    = import_identifier(state, decl->identifier),
+                .type          = import_type(state, source, decl->type),
+                .initial_value = import_value(state, decl->initial_value),
+                .location      = { .source = source, .offset = decl->location.offset },
+            });
+        }
+    }
+    APIGEN_ASSERT(!job->ok || include_index == job->includes.count);
+
+    for(; include_index < job->includes.count; include_index++) {
+        struct IncludeSite const * const site = &job->includes.items[include_index];
+        merge_job_diagnostics(state, job, file_name, &merged_diagnostics, site->diagnostic_count);
+        import_include_site(state, source, site, NULL);
+    }
+    merge_job_diagnostics(state, job, file_name, &merged_diagnostics, job->diagnostics.items.count);
+
+    // everything is copied now, so the memory can be reused for the following imports:
+    release_include_job(job);
+}
+
+static bool parse_with_include_workers(struct apigen_ParserState * state)
+{
+    APIGEN_ASSERT(state->jobs > 1);
+    APIGEN_ASSERT(state->sources->count == 0); // sources are only shared with includes
+
+    struct IncludeQueue queue = {
+        .source_dir   = state->source_dir,
+        .line_feed    = state->line_feed,
+        .module_cache = state->module_cache,
+        .arena        = state->ast_arena,
+
+        .skip_documentation = state->skip_documentation,
+
+        .jobs         = { 0 },
+        .job_ids      = create_file_map(state->ast_arena),
+    };
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.wakeup, NULL);
+
+    struct apigen_FileId                   root_file_id;
+    bool const                             root_has_file_id = apigen_io_identify(state->file, &root_file_id);
+    struct apigen_ParserIncludeJob * const root             = create_include_job(&queue, "", state->file_name, root_has_file_id ? &root_file_id : NULL);
+    root->file = state->file;
+    queue.root = root;
+
+    // The calling thread is a worker as well:
+    size_t const thread_count = (size_t)state->jobs - 1;
+    pthread_t * const threads = apigen_alloc(thread_count * sizeof(pthread_t));
+    size_t started_threads = 0;
+    while(started_threads < thread_count) {
+        if(pthread_create(&threads[started_threads], NULL, include_worker_thread, &queue) != 0) {
+            break; // continue with the threads we got
+        }
+        started_threads += 1;
+    }
+
+    run_include_worker(&queue);
+
+    for(size_t i = 0; i < started_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    apigen_free(threads);
+
+    pthread_cond_destroy(&queue.wakeup);
+    pthread_mutex_destroy(&queue.lock);
+
+    state->top_level_declarations = (struct apigen_ParserDeclarationArray) { 0 };
+    import_include_job(state, root, state->file_name, &state->top_level_declarations);
+
+    for(size_t i = 0; i < queue.jobs.count; i++) {
+        APIGEN_ASSERT(queue.jobs.items[i]->imported); // every job is reachable from the root
+    }
+
+    return root->ok;
+}
+
+struct apigen_ParserDeclarationArray apigen_parser_file_include(
     struct apigen_ParserState * outer_state, 
     struct apigen_ParserLocation location, 
-    struct apigen_ParserDeclaration * previous_decls,
+    struct apigen_ParserDeclarationArray previous_decls,
     char const * include_path
 )
 {
     APIGEN_NOT_NULL(outer_state);
     APIGEN_NOT_NULL(include_path);
 
+    if(outer_state->keep_includes) {
+        // validated and resolved later by `expand_includes`:
+        append_include_placeholder(outer_state, &previous_decls, location, include_path);
+        return previous_decls;
+    }
+
+    char const * location_file_name;
+    uint32_t     location_line, location_column;
+    apigen_parser_resolve_location(outer_state, location, &location_file_name, &location_line, &location_column);
+
     if(!validate_include_path(include_path)) {
         apigen_diagnostics_emit(
             outer_state->diagnostics, 
-            outer_state->file_name,
-            location.first_line,
-            location.first_column,
+            location_file_name,
+            location_line,
+            location_column,
             apigen_error_invalid_include_path, 
             include_path
         );
         return previous_decls; // continue lexing, but emit error
     }
 
+    if(outer_state->include_job != NULL) {
+        return defer_include(outer_state, location, previous_decls, include_path);
+    }
+
     struct apigen_ParserState inner_state = {
         .source_dir = {0},
 
         .file      = {0},
-        .file_name = 0, 
+        .file_name = include_path, 
 
         .ast_arena = outer_state->ast_arena,
         .line_feed = outer_state->line_feed,
+
+        .skip_documentation = outer_state->skip_documentation,
         
-        .diagnostics = outer_state->diagnostics,
+        .diagnostics  = outer_state->diagnostics,
+        .strings      = outer_state->strings,
+        .sources      = outer_state->sources,
+        .source_ids   = outer_state->source_ids,
+        .module_cache = outer_state->module_cache,
         
-        .top_level_declarations = NULL,
+        .top_level_declarations = { 0 },
     };
 
     size_t filename_offset;
@@ -162,9 +1015,9 @@ struct apigen_ParserDeclaration * apigen_parser_file_include(
     if(!dir_ok || !apigen_io_open_file_read(inner_state.source_dir, include_file_name, &inner_state.file)) {
         apigen_diagnostics_emit(
             outer_state->diagnostics, 
-            outer_state->file_name,
-            location.first_line,
-            location.first_column,
+            location_file_name,
+            location_line,
+            location_column,
             apigen_error_missing_include_file,
             include_path
         );
@@ -172,42 +1025,42 @@ struct apigen_ParserDeclaration * apigen_parser_file_include(
     }
 
     
-    yyscan_t scanner;
-    apigen_parser_lex_init_extra (&inner_state, &scanner);
-
-    int const lex_result = apigen_parser_parse(scanner, &inner_state);
+    if(!apigen_parser_begin_source(&inner_state, include_path)) {
+        // Every file is only parsed once. Including it again would only duplicate its
+        // declarations, and skipping it also breaks include cycles:
+        apigen_io_close(&inner_state.file);
+        apigen_io_close_dir(&inner_state.source_dir);
+        return previous_decls;
+    }
 
-    apigen_parser_lex_destroy(scanner);
+    bool parsed;
+    if(inner_state.module_cache != NULL) {
+        struct apigen_ParserDeclarationArray decls;
+        parsed = parse_module(&inner_state, &decls);
+        if(parsed) {
+            inner_state.top_level_declarations = expand_includes(&inner_state, decls);
+        }
+    }
+    else {
+        parsed = (run_parser(&inner_state) == 0);
+    }
 
     apigen_io_close(&inner_state.file); 
     apigen_io_close_dir(&inner_state.source_dir); 
 
-    if (lex_result != 0) {
+    if (!parsed) {
         return previous_decls;
     }
     
     
-    if(inner_state.top_level_declarations == &EMPTY_DOCUMENT_SENTINEL) {
-        return previous_decls; // list was empty, we can safely return the same as before
-    }
-    else {
-        APIGEN_ASSERT(inner_state.top_level_declarations != NULL);
-        
-        
-        if(previous_decls != NULL) {
-            struct apigen_ParserDeclaration * tail = previous_decls;
-            while(tail->next != NULL) {
-                tail = tail->next;
-            }
-            // Attach parsed items to tail:
-            tail->next = inner_state.top_level_declarations;
-            return previous_decls;
-        }
-        else {
-            // We are now HEAD of the list
-            return inner_state.top_level_declarations;
-        }
+    if(previous_decls.count == 0) {
+        // We are now the start of the list
+        return inner_state.top_level_declarations;
     }
+
+    // Attach parsed items to the end:
+    declaration_array_append_all(outer_state->ast_arena, &previous_decls, inner_state.top_level_declarations.items, inner_state.top_level_declarations.count);
+    return previous_decls;
 }
 
 
@@ -238,7 +1091,7 @@ struct apigen_Value apigen_parser_conv_regular_str(struct apigen_ParserState * s
         }
     }
 
-    char * const converted = apigen_memory_arena_alloc(state->ast_arena, converted_length + 1);
+    char * const converted = apigen_memory_arena_alloc_packed(state->ast_arena, converted_length + 1);
 
     {
         size_t src = 1;
@@ -285,28 +1138,49 @@ struct apigen_Value apigen_parser_conv_multiline_str(struct apigen_ParserState *
     return (struct apigen_Value){.type = apigen_value_str, .value_str = converted};
 }
 
-struct apigen_Value apigen_parser_concat_multiline_strs(struct apigen_ParserState * state, struct apigen_Value str1, struct apigen_Value str2)
+/// Joins all `fragments` with `separator` into a single string. Every fragment is copied exactly once.
+static char const * join_fragments(struct apigen_MemoryArena * arena, struct apigen_ParserTextFragmentArray fragments, char const * separator)
 {
-    APIGEN_NOT_NULL(state);
-    APIGEN_ASSERT(str1.type == apigen_value_str);
-    APIGEN_ASSERT(str2.type == apigen_value_str);
+    APIGEN_NOT_NULL(arena);
+    APIGEN_NOT_NULL(separator);
+    APIGEN_ASSERT(fragments.count > 0);
 
-    char const * const line_feed = (state->line_feed != NULL) ? state->line_feed : "\n";
+    if(fragments.count == 1) {
+        return fragments.items[0];
+    }
+
+    size_t const separator_len = strlen(separator);
+
+    size_t total_len = separator_len * (fragments.count - 1);
+    for(size_t i = 0; i < fragments.count; i++) {
+        total_len += strlen(fragments.items[i]);
+    }
+
+    char * const output_string = apigen_memory_arena_alloc_packed(arena, total_len + 1);
 
-    size_t const lf_len   = strlen(line_feed);
-    size_t const str1_len = strlen(str1.value_str);
-    size_t const str2_len = strlen(str2.value_str);
+    char * iter = output_string;
+    for(size_t i = 0; i < fragments.count; i++) {
+        if(i > 0) {
+            memcpy(iter, separator, separator_len);
+            iter += separator_len;
+        }
+        size_t const len = strlen(fragments.items[i]);
+        memcpy(iter, fragments.items[i], len);
+        iter += len;
+    }
+    APIGEN_ASSERT(iter == output_string + total_len);
+    *iter = 0;
 
-    size_t const total_len = lf_len + str1_len + str2_len + 1;
+    return output_string;
+}
 
-    char * const output_string = apigen_memory_arena_alloc(state->ast_arena, total_len);
+struct apigen_Value apigen_parser_join_multiline_strs(struct apigen_ParserState * state, struct apigen_ParserTextFragmentArray lines)
+{
+    APIGEN_NOT_NULL(state);
 
-    memcpy(output_string, str1.value_str, str1_len);
-    memcpy(output_string + str1_len, line_feed, lf_len);
-    memcpy(output_string + str1_len + lf_len, str2.value_str, str2_len);
-    output_string[total_len] = 0;
+    char const * const line_feed = (state->line_feed != NULL) ? state->line_feed : "\n";
 
-    return (struct apigen_Value){.type = apigen_value_str, .value_str = output_string};
+    return (struct apigen_Value){.type = apigen_value_str, .value_str = join_fragments(state->ast_arena, lines, line_feed)};
 }
 
 char const * apigen_parser_create_doc_string(struct apigen_ParserState * state, char const * str1)
@@ -332,7 +1206,7 @@ char const * apigen_parser_create_doc_string(struct apigen_ParserState * state,
         return "";
     }
 
-    char * const output_string = apigen_memory_arena_alloc(state->ast_arena, len + 1);
+    char * const output_string = apigen_memory_arena_alloc_packed(state->ast_arena, len + 1);
     memcpy(output_string, text, len);
     output_string[len] = 0;
 
@@ -340,74 +1214,55 @@ char const * apigen_parser_create_doc_string(struct apigen_ParserState * state,
 
 }
 
-char const * apigen_parser_concat_doc_strings(struct apigen_ParserState * state, char const * str1, char const * str2)
+struct apigen_ParserTextFragmentArray apigen_parser_doc_lines_append(struct apigen_ParserState * state, struct apigen_ParserTextFragmentArray lines, char const * line)
 {
     APIGEN_NOT_NULL(state);
-    APIGEN_NOT_NULL(str1);
-    APIGEN_NOT_NULL(str2);
-
-    char const * const line_feed = "\n"; // doc strings always are separated by a single "\n"
-
-    size_t const lf_len   = strlen(line_feed);
-    size_t const str1_len = strlen(str1);
-    size_t const str2_len = strlen(str2);
 
-    size_t const total_len = lf_len + str1_len + str2_len;
-
-    char * const output_string = apigen_memory_arena_alloc(state->ast_arena, total_len + 1);
+    // the lexers pass NULL for skipped doc comments, those don't need any memory:
+    if(line != NULL) {
+        fragment_array_append(state->ast_arena, &lines, line);
+    }
+    return lines;
+}
 
-    memcpy(output_string, str1, str1_len);
-    memcpy(output_string + str1_len, line_feed, lf_len);
-    memcpy(output_string + str1_len + lf_len, str2, str2_len);
-    output_string[total_len] = 0;
+char const * apigen_parser_join_doc_strings(struct apigen_ParserState * state, struct apigen_ParserTextFragmentArray lines)
+{
+    APIGEN_NOT_NULL(state);
 
-    return output_string;
+    if(lines.count == 0) {
+        return NULL;
+    }
+    return join_fragments(state->ast_arena, lines, "\n"); // doc strings always are separated by a single "\n"
 }
 
-#define DEFINE_LIST_OPERATORS(_ListItem, _Prefix)                                                     \
-    _ListItem * _Prefix##_init(struct apigen_ParserState * state, _ListItem item)                     \
-    {                                                                                                 \
-        APIGEN_NOT_NULL(state);                                                                       \
-                                                                                                      \
-        _ListItem * first = apigen_memory_arena_alloc(state->ast_arena, sizeof(_ListItem));           \
-        *first            = item;                                                                     \
-        first->next       = NULL;                                                                     \
-                                                                                                      \
-        return first;                                                                                 \
-    }                                                                                                 \
-                                                                                                      \
-    _ListItem * _Prefix##_append(struct apigen_ParserState * state, _ListItem * list, _ListItem item) \
-    {                                                                                                 \
-        APIGEN_NOT_NULL(state);                                                                       \
-                                                                                                      \
-        _ListItem * new_item = apigen_memory_arena_alloc(state->ast_arena, sizeof(_ListItem));        \
-        *new_item            = item;                                                                  \
-        new_item->next       = NULL;                                                                  \
-                                                                                                      \
-        if (list == NULL) {                                                                           \
-            return new_item;                                                                          \
-        }                                                                                             \
-                                                                                                      \
-        _ListItem * iter = list;                                                                      \
-        while (iter->next != NULL) {                                                                  \
-            iter = iter->next;                                                                        \
-        }                                                                                             \
-                                                                                                      \
-        APIGEN_ASSERT(iter->next == NULL);                                                            \
-                                                                                                      \
-        iter->next = new_item;                                                                        \
-        return list;                                                                                  \
-    }
-
-DEFINE_LIST_OPERATORS(struct apigen_ParserEnumItem, apigen_parser_enum_item_list)
-DEFINE_LIST_OPERATORS(struct apigen_ParserField, apigen_parser_field_list)
-DEFINE_LIST_OPERATORS(struct apigen_ParserDeclaration, apigen_parser_file)
+#define DEFINE_LIST_OPERATORS(_Array, _ListItem, _ArrayPrefix, _Prefix)                                   \
+    struct _Array _Prefix##_init(struct apigen_ParserState * state, _ListItem item)                       \
+    {                                                                                                     \
+        APIGEN_NOT_NULL(state);                                                                           \
+                                                                                                          \
+        struct _Array list = {0};                                                                         \
+        _ArrayPrefix##_append(state->ast_arena, &list, item);                                             \
+        return list;                                                                                      \
+    }                                                                                                     \
+                                                                                                          \
+    struct _Array _Prefix##_append(struct apigen_ParserState * state, struct _Array list, _ListItem item) \
+    {                                                                                                     \
+        APIGEN_NOT_NULL(state);                                                                           \
+                                                                                                          \
+        _ArrayPrefix##_append(state->ast_arena, &list, item);                                             \
+        return list;                                                                                      \
+    }
+
+DEFINE_LIST_OPERATORS(apigen_ParserEnumItemArray, struct apigen_ParserEnumItem, enum_item_array, apigen_parser_enum_item_list)
+DEFINE_LIST_OPERATORS(apigen_ParserFieldArray, struct apigen_ParserField, field_array, apigen_parser_field_list)
+DEFINE_LIST_OPERATORS(apigen_ParserDeclarationArray, struct apigen_ParserDeclaration, declaration_array, apigen_parser_file)
+DEFINE_LIST_OPERATORS(apigen_ParserTextFragmentArray, char const *, fragment_array, apigen_parser_fragment_list)
 
 struct apigen_ParserType * apigen_parser_heapify_type(struct apigen_ParserState * state, struct apigen_ParserType type)
 {
     APIGEN_NOT_NULL(state);
 
-    struct apigen_ParserType * heapified = apigen_memory_arena_alloc(state->ast_arena, sizeof(struct apigen_ParserType));
+    struct apigen_ParserType * heapified = apigen_memory_arena_alloc_aligned(state->ast_arena, sizeof(struct apigen_ParserType), alignof(struct apigen_ParserType));
     *heapified                           = type;
     return heapified;
 }
@@ -428,5 +1283,5 @@ char const * apigen_parser_conv_at_ident(struct apigen_ParserState * state, char
     // can just apply the same conversion rules:
     struct apigen_Value converted_name = apigen_parser_conv_regular_str(state, at_identifier + 1);
     APIGEN_ASSERT(converted_name.type == apigen_value_str);
-    return converted_name.value_str;
+    return apigen_string_pool_intern(state->strings, converted_name.value_str);
 }
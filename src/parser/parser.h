@@ -3,12 +3,11 @@
 #include "apigen.h"
 #include <stdint.h>
 
+/// Start of a token or syntax element. Use `apigen_parser_resolve_location` to get the line and column.
 struct apigen_ParserLocation
 {
-    uint32_t first_line;
-    uint32_t first_column;
-    uint32_t last_line;
-    uint32_t last_column;
+    uint32_t source; ///< index into `apigen_ParserState.sources`
+    uint32_t offset; ///< byte offset into the source
 };
 
 #define APIGEN_VALUE_NULL ((struct apigen_Value){.type = apigen_value_null})
@@ -16,6 +15,12 @@ struct apigen_ParserLocation
 struct apigen_ParserEnumItem;
 struct apigen_ParserField;
 
+APIGEN_DECLARE_ARRAY(apigen_ParserEnumItemArray, struct apigen_ParserEnumItem);
+APIGEN_DECLARE_ARRAY(apigen_ParserFieldArray, struct apigen_ParserField);
+
+/// Lines of a doc comment or multiline string, joined once the whole sequence is parsed.
+APIGEN_DECLARE_ARRAY(apigen_ParserTextFragmentArray, char const *);
+
 enum apigen_ParserTypeId
 {
     apigen_parser_type_named,
@@ -38,11 +43,11 @@ struct apigen_ParserType
     {
         struct
         {
-            struct apigen_ParserType *     underlying_type;
-            struct apigen_ParserEnumItem * items;
+            struct apigen_ParserType *        underlying_type;
+            struct apigen_ParserEnumItemArray items;
         } enum_data;
-        struct apigen_ParserField * union_struct_fields;
-        char const *                named_data;
+        struct apigen_ParserFieldArray union_struct_fields;
+        char const *                   named_data;
         struct
         {
             struct apigen_ParserType * underlying_type;
@@ -57,8 +62,8 @@ struct apigen_ParserType
         } pointer_data;
         struct
         {
-            struct apigen_ParserType *  return_type;
-            struct apigen_ParserField * parameters;
+            struct apigen_ParserType *     return_type;
+            struct apigen_ParserFieldArray parameters;
         } function_data;
     };
 };
@@ -68,7 +73,6 @@ struct apigen_ParserEnumItem
     char const *                   documentation;
     char const *                   identifier;
     struct apigen_Value            value;
-    struct apigen_ParserEnumItem * next;
     struct apigen_ParserLocation   location;
 };
 
@@ -77,7 +81,6 @@ struct apigen_ParserField
     char const *                 documentation;
     char const *                 identifier;
     struct apigen_ParserType     type;
-    struct apigen_ParserField *  next;
     struct apigen_ParserLocation location;
 };
 
@@ -101,48 +104,70 @@ struct apigen_ParserDeclaration
     struct apigen_ParserLocation      location;
     char const *                      include_path;
 
-    struct apigen_ParserDeclaration * next;
-
     struct apigen_Type * associated_type;
 };
 
 union apigen_ParserAstNode
 {
-    struct apigen_Value               value;
-    char const *                      identifier;
-    char const *                      plain_text;
-    struct apigen_ParserEnumItem      enum_item;
-    struct apigen_ParserEnumItem *    enum_item_list;
-    struct apigen_ParserField         field;
-    struct apigen_ParserField *       field_list;
-    struct apigen_ParserType          type;
-    struct apigen_ParserDeclaration   declaration;
-    struct apigen_ParserDeclaration * file;
+    struct apigen_Value                   value;
+    char const *                          identifier;
+    char const *                          plain_text;
+    struct apigen_ParserTextFragmentArray fragments;
+    struct apigen_ParserEnumItem          enum_item;
+    struct apigen_ParserEnumItemArray     enum_item_list;
+    struct apigen_ParserField             field;
+    struct apigen_ParserFieldArray        field_list;
+    struct apigen_ParserType              type;
+    struct apigen_ParserDeclaration       declaration;
+    struct apigen_ParserDeclarationArray  file;
 };
 
 typedef struct apigen_ParserLocation YYLTYPE;
 typedef union apigen_ParserAstNode   YYSTYPE;
 
-// This value is a sentinel value returned by apigen_parser_parse to signal an empty file:
-extern struct apigen_ParserDeclaration EMPTY_DOCUMENT_SENTINEL;
+/// Appends `state->file` to the sources of `state` and makes it the current one.
+/// Returns `false` and changes nothing if the same file was read before.
+bool apigen_parser_begin_source(struct apigen_ParserState * state, char const * file_name);
+
+/// Records the line breaks of the next `length` bytes of the current source.
+/// Lexers must pass all input to this function, in order.
+void apigen_parser_scan_lines(struct apigen_ParserState * state, char const * text, size_t length);
+
+/// Translates `location` into the file name and the zero-based line and column used for diagnostics.
+void apigen_parser_resolve_location(struct apigen_ParserState const * state, struct apigen_ParserLocation location, char const ** out_file_name, uint32_t * out_line, uint32_t * out_column);
 
 struct apigen_Value apigen_parser_conv_regular_str(struct apigen_ParserState * state, char const * literal);
 struct apigen_Value apigen_parser_conv_multiline_str(struct apigen_ParserState * state, char const * literal);
-struct apigen_Value apigen_parser_concat_multiline_strs(struct apigen_ParserState * state, struct apigen_Value str1, struct apigen_Value str2);
+struct apigen_Value apigen_parser_join_multiline_strs(struct apigen_ParserState * state, struct apigen_ParserTextFragmentArray lines);
 
 char const * apigen_parser_create_doc_string(struct apigen_ParserState * state, char const * str1);
-char const * apigen_parser_concat_doc_strings(struct apigen_ParserState * state, char const * str1, char const * str2);
+struct apigen_ParserTextFragmentArray apigen_parser_doc_lines_append(struct apigen_ParserState * state, struct apigen_ParserTextFragmentArray lines, char const * line);
+/// Returns `NULL` if all lines were skipped.
+char const * apigen_parser_join_doc_strings(struct apigen_ParserState * state, struct apigen_ParserTextFragmentArray lines);
+
+struct apigen_ParserTextFragmentArray apigen_parser_fragment_list_init(struct apigen_ParserState * state, char const * item);
+struct apigen_ParserTextFragmentArray apigen_parser_fragment_list_append(struct apigen_ParserState * state, struct apigen_ParserTextFragmentArray list, char const * item);
+
+struct apigen_ParserEnumItemArray apigen_parser_enum_item_list_init(struct apigen_ParserState * state, struct apigen_ParserEnumItem item);
+struct apigen_ParserEnumItemArray apigen_parser_enum_item_list_append(struct apigen_ParserState * state, struct apigen_ParserEnumItemArray list, struct apigen_ParserEnumItem item);
+
+struct apigen_ParserFieldArray apigen_parser_field_list_init(struct apigen_ParserState * state, struct apigen_ParserField item);
+struct apigen_ParserFieldArray apigen_parser_field_list_append(struct apigen_ParserState * state, struct apigen_ParserFieldArray list, struct apigen_ParserField item);
+
+struct apigen_ParserDeclarationArray apigen_parser_file_init(struct apigen_ParserState * state, struct apigen_ParserDeclaration item);
+struct apigen_ParserDeclarationArray apigen_parser_file_append(struct apigen_ParserState * state, struct apigen_ParserDeclarationArray list, struct apigen_ParserDeclaration item);
 
-struct apigen_ParserEnumItem * apigen_parser_enum_item_list_init(struct apigen_ParserState * state, struct apigen_ParserEnumItem item);
-struct apigen_ParserEnumItem * apigen_parser_enum_item_list_append(struct apigen_ParserState * state, struct apigen_ParserEnumItem * list, struct apigen_ParserEnumItem item);
+/// Hashes the source text and all parser settings that influence the AST, the result identifies the module cache entry of the text.
+uint64_t apigen_parser_module_key(struct apigen_ParserState const * state, char const * text, size_t length);
 
-struct apigen_ParserField * apigen_parser_field_list_init(struct apigen_ParserState * state, struct apigen_ParserField item);
-struct apigen_ParserField * apigen_parser_field_list_append(struct apigen_ParserState * state, struct apigen_ParserField * list, struct apigen_ParserField item);
+/// Loads the declarations of the current source from `state->module_cache`. Includes are returned as placeholder declarations.
+/// Returns `false` if the cache has no valid entry for `key`.
+bool apigen_parser_load_module(struct apigen_ParserState * state, uint64_t key, size_t source_length, struct apigen_ParserDeclarationArray * out_decls);
 
-struct apigen_ParserDeclaration * apigen_parser_file_init(struct apigen_ParserState * state, struct apigen_ParserDeclaration item);
-struct apigen_ParserDeclaration * apigen_parser_file_append(struct apigen_ParserState * state, struct apigen_ParserDeclaration * list, struct apigen_ParserDeclaration item);
+/// Stores `decls` in `state->module_cache`, all includes must be placeholder declarations.
+void apigen_parser_store_module(struct apigen_ParserState * state, uint64_t key, size_t source_length, struct apigen_ParserDeclarationArray decls);
 
-struct apigen_ParserDeclaration * apigen_parser_file_include(struct apigen_ParserState * state, struct apigen_ParserLocation location, struct apigen_ParserDeclaration * list, char const * file_path);
+struct apigen_ParserDeclarationArray apigen_parser_file_include(struct apigen_ParserState * state, struct apigen_ParserLocation location, struct apigen_ParserDeclarationArray list, char const * file_path);
 
 char const * apigen_parser_conv_at_ident(struct apigen_ParserState * state, char const * at_identifier);
 
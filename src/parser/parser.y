@@ -13,7 +13,11 @@ typedef void * yyscan_t;
 )
 extern YY_DECL;
 
+#ifdef APIGEN_USE_HANDWRITTEN_LEXER
+#include "parser/lexer.h"
+#else
 #include "lexer.yy.h"
+#endif
 
 int yyerror(
     struct apigen_ParserLocation const * location,
@@ -22,9 +26,19 @@ int yyerror(
     char const * err_string
 );
 
+// Locations only store where a syntax element starts, which is the start of its first symbol.
+// Empty rules inherit the location of the preceding symbol:
+#define YYLLOC_DEFAULT(Current, Rhs, N) \
+    do { (Current) = YYRHSLOC(Rhs, (N) ? 1 : 0); } while(0)
+
 #define strdup(_X) \
     apigen_memory_arena_dupestr(parser_state->ast_arena, _X)
 
+// Accounts all allocations done while scanning a token to the lexer:
+static int tagged_yylex(YYSTYPE * yylval_param, YYLTYPE * yylloc_param, yyscan_t yyscanner, struct apigen_ParserState * parser_state);
+#undef yylex
+#define yylex tagged_yylex
+
 %}
 
 %locations
@@ -59,17 +73,19 @@ int yyerror(
 %token KW_INCLUDE
 
 %type <plain_text> docs
+%type <fragments>  doc_lines        // returns array of doc comment lines
 %type <value> value
 %type <value> multiline_str
+%type <fragments>  multiline_lines  // returns array of multiline string lines
 
 
 %type <enum_item>      enum_item
-%type <enum_item_list> enum_items       // returns linked-list to enum_item
-%type <enum_item_list> enum_items_inner // returns linked-list to enum_item
+%type <enum_item_list> enum_items       // returns array of enum_item
+%type <enum_item_list> enum_items_inner // returns array of enum_item
 
 %type <field>      field
-%type <field_list> field_list           // returns linked-list to field
-%type <field_list> field_list_inner     // returns linked-list to field
+%type <field_list> field_list           // returns array of field
+%type <field_list> field_list_inner     // returns array of field
 
 %type <type> type
 %type <type> primitive_type
@@ -86,12 +102,12 @@ int yyerror(
 
 file:
     declaration_list { parser_state->top_level_declarations = $1; }
-|                    { parser_state->top_level_declarations = &EMPTY_DOCUMENT_SENTINEL; }
+|                    { parser_state->top_level_declarations = (struct apigen_ParserDeclarationArray) { 0 }; }
 ;
 
 declaration_list:
     declaration                   { $$ = apigen_parser_file_init(parser_state,    $1); }
-|   include_file                  { $$ = apigen_parser_file_include(parser_state, yyloc, NULL, ($1).value_str); }
+|   include_file                  { $$ = apigen_parser_file_include(parser_state, yyloc, (struct apigen_ParserDeclarationArray) { 0 }, ($1).value_str); }
 |   declaration_list declaration  { $$ = apigen_parser_file_append(parser_state,  $1,    $2); }
 |   declaration_list include_file { $$ = apigen_parser_file_include(parser_state, yyloc, $1,   ($2).value_str); }
 ;
@@ -153,7 +169,7 @@ named_type: IDENTIFIER { $$ = (struct apigen_ParserType) { .location = yyloc, .t
 field_list:
     field_list_inner      { $$ = $1; }
 |   field_list_inner ','  { $$ = $1; }
-|                         { $$ = NULL; }
+|                         { $$ = (struct apigen_ParserFieldArray) { 0 }; }
 ; 
 
 field_list_inner:
@@ -169,7 +185,7 @@ field:
 enum_items:
     enum_items_inner      { $$ = $1; }
 |   enum_items_inner ','  { $$ = $1; }
-|                         { $$ = NULL; }
+|                         { $$ = (struct apigen_ParserEnumItemArray) { 0 }; }
 ;
 
 enum_items_inner:
@@ -184,8 +200,12 @@ enum_item:
 |        IDENTIFIER '=' value  { $$ = (struct apigen_ParserEnumItem) { .location = yyloc, .documentation = NULL, .identifier = $1, .value = $3 }; }
 ;
 
-docs: DOCCOMMENT
-|     DOCCOMMENT docs { $$ = apigen_parser_concat_doc_strings(parser_state, $1, $2); } 
+docs: doc_lines { $$ = apigen_parser_join_doc_strings(parser_state, $1); }
+;
+
+doc_lines:
+    DOCCOMMENT            { $$ = apigen_parser_doc_lines_append(parser_state, (struct apigen_ParserTextFragmentArray) { 0 }, $1); }
+|   doc_lines DOCCOMMENT  { $$ = apigen_parser_doc_lines_append(parser_state, $1, $2); }
 ;
 
 value: 
@@ -195,9 +215,12 @@ value:
 |   multiline_str
 ;
 
-multiline_str:
-    MULTILINE_STRING
-|   MULTILINE_STRING multiline_str { $$ = apigen_parser_concat_multiline_strs(parser_state, $1, $2); }
+multiline_str: multiline_lines { $$ = apigen_parser_join_multiline_strs(parser_state, $1); }
+;
+
+multiline_lines:
+    MULTILINE_STRING                  { $$ = apigen_parser_fragment_list_init(parser_state, ($1).value_str); }
+|   multiline_lines MULTILINE_STRING  { $$ = apigen_parser_fragment_list_append(parser_state, $1, ($2).value_str); }
 ;
 
 %%
@@ -205,6 +228,16 @@ multiline_str:
 #include <stdio.h>
 #include <stdlib.h>
 
+#undef yylex
+
+static int tagged_yylex(YYSTYPE * yylval_param, YYLTYPE * yylloc_param, yyscan_t yyscanner, struct apigen_ParserState * parser_state)
+{
+    enum apigen_MemoryTag const previous_tag = apigen_memory_set_tag(APIGEN_MEMORY_TAG_LEXER);
+    int const token = apigen_parser_lex(yylval_param, yylloc_param, yyscanner, parser_state);
+    apigen_memory_set_tag(previous_tag);
+    return token;
+}
+
 int yyerror(struct apigen_ParserLocation const * location, yyscan_t scanner, struct apigen_ParserState * parser_state, char const * err)
 {
     APIGEN_NOT_NULL(location);
@@ -212,11 +245,15 @@ int yyerror(struct apigen_ParserLocation const * location, yyscan_t scanner, str
     APIGEN_NOT_NULL(parser_state->diagnostics);
     APIGEN_NOT_NULL(err);
 
+    char const * file_name;
+    uint32_t     line, column;
+    apigen_parser_resolve_location(parser_state, *location, &file_name, &line, &column);
+
     apigen_diagnostics_emit(
         parser_state->diagnostics,
-        parser_state->file_name,
-        location->first_line,
-        location->first_column,
+        file_name,
+        line,
+        column,
         apigen_error_syntax_error,
         apigen_parser_get_text(scanner),
         err
@@ -0,0 +1,133 @@
+#include "apigen.h"
+
+#include <stdalign.h>
+#include <string.h>
+
+/// A slot is empty if `string` is `NULL`.
+struct apigen_StringPoolSlot
+{
+    uint32_t     hash;
+    uint32_t     length;
+    char const * string;
+};
+
+/// Number of slots of a fresh pool.
+static size_t const STRING_POOL_INITIAL_SLOTS = 256;
+
+/// FNV-1a, good enough for short identifiers.
+static uint32_t hash_string(char const * str, size_t len)
+{
+    uint32_t hash = 0x811c9dc5U;
+    for(size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)str[i];
+        hash *= 0x01000193U;
+    }
+    return hash;
+}
+
+static struct apigen_StringPoolSlot * alloc_slots(struct apigen_MemoryArena * arena, size_t slot_count)
+{
+    struct apigen_StringPoolSlot * const slots = apigen_memory_arena_alloc_aligned(arena, slot_count * sizeof(struct apigen_StringPoolSlot), alignof(struct apigen_StringPoolSlot));
+    memset(slots, 0, slot_count * sizeof(struct apigen_StringPoolSlot));
+    return slots;
+}
+
+/// Returns the slot that contains the string, or the empty slot where it belongs.
+static struct apigen_StringPoolSlot * find_slot(struct apigen_StringPoolSlot * slots, size_t slot_count, uint32_t hash, char const * str, size_t len)
+{
+    size_t const mask = slot_count - 1;
+
+    size_t index = (size_t)hash & mask;
+    while(true) {
+        struct apigen_StringPoolSlot * const slot = &slots[index];
+        if(slot->string == NULL) {
+            return slot;
+        }
+        if(slot->hash == hash && slot->length == len && memcmp(slot->string, str, len) == 0) {
+            return slot;
+        }
+        index = (index + 1) & mask;
+    }
+}
+
+/// Doubles the number of slots. The old table stays in the arena, but the
+/// sum of all abandoned tables is never larger than the current one.
+static void grow_slots(struct apigen_StringPool * pool)
+{
+    size_t const new_slot_count = 2 * pool->slot_count;
+
+    struct apigen_StringPoolSlot * const new_slots = alloc_slots(pool->arena, new_slot_count);
+    for(size_t i = 0; i < pool->slot_count; i++) {
+        struct apigen_StringPoolSlot const slot = pool->slots[i];
+        if(slot.string != NULL) {
+            *find_slot(new_slots, new_slot_count, slot.hash, slot.string, slot.length) = slot;
+        }
+    }
+
+    pool->slots      = new_slots;
+    pool->slot_count = new_slot_count;
+}
+
+void apigen_string_pool_init(struct apigen_StringPool * pool, struct apigen_MemoryArena * arena)
+{
+    APIGEN_NOT_NULL(pool);
+    APIGEN_NOT_NULL(arena);
+
+    *pool = (struct apigen_StringPool) {
+        .arena      = arena,
+        .slots      = alloc_slots(arena, STRING_POOL_INITIAL_SLOTS),
+        .slot_count = STRING_POOL_INITIAL_SLOTS,
+        .count      = 0,
+    };
+}
+
+char const * apigen_string_pool_intern_len(struct apigen_StringPool * pool, char const * str, size_t len)
+{
+    APIGEN_NOT_NULL(pool);
+    APIGEN_NOT_NULL(str);
+
+    APIGEN_ASSERT(len <= UINT32_MAX);
+
+    uint32_t const hash = hash_string(str, len);
+
+    struct apigen_StringPoolSlot * slot = find_slot(pool->slots, pool->slot_count, hash, str, len);
+    if(slot->string != NULL) {
+        return slot->string;
+    }
+
+    // keep the load factor below 3/4:
+    if(4 * (pool->count + 1) > 3 * pool->slot_count) {
+        grow_slots(pool);
+        slot = find_slot(pool->slots, pool->slot_count, hash, str, len);
+        APIGEN_ASSERT(slot->string == NULL);
+    }
+
+    char * const copy = apigen_memory_arena_alloc_packed(pool->arena, len + 1);
+    memcpy(copy, str, len);
+    copy[len] = 0;
+
+    *slot = (struct apigen_StringPoolSlot) {
+        .hash   = hash,
+        .length = (uint32_t)len,
+        .string = copy,
+    };
+    pool->count += 1;
+
+    return copy;
+}
+
+char const * apigen_string_pool_intern(struct apigen_StringPool * pool, char const * str)
+{
+    APIGEN_NOT_NULL(str);
+    return apigen_string_pool_intern_len(pool, str, strlen(str));
+}
+
+char const * apigen_string_pool_find(struct apigen_StringPool const * pool, char const * str)
+{
+    APIGEN_NOT_NULL(pool);
+    APIGEN_NOT_NULL(str);
+
+    size_t const len = strlen(str);
+    struct apigen_StringPoolSlot const * const slot = find_slot(pool->slots, pool->slot_count, hash_string(str, len), str, len);
+    return slot->string;
+}
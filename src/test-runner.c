@@ -2,12 +2,20 @@
 #include "apigen-internals.h"
 
 #include <ctype.h>
+#include <stdalign.h>
 #include <stdlib.h>
 
+/// An expected diagnostic, written as `code` or `code@file_name` in the test file.
+struct Expectation
+{
+    enum apigen_DiagnosticCode code;
+    char const *               file_name; ///< the file the diagnostic must be reported in, or `NULL` for any file
+};
+
 struct CodeArray
 {
-    size_t                       len;
-    enum apigen_DiagnosticCode * ptr;
+    size_t               len;
+    struct Expectation * ptr;
 };
 
 static char * str_trim(char * string)
@@ -47,7 +55,7 @@ static struct CodeArray parse_expectations_from_file(struct apigen_MemoryArena *
 
     static const size_t max_expected_items = 64;
     struct CodeArray    result             = {
-                       .ptr = apigen_memory_arena_alloc(arena, max_expected_items * sizeof(enum apigen_DiagnosticCode)),
+                       .ptr = apigen_memory_arena_alloc_aligned(arena, max_expected_items * sizeof(struct Expectation), alignof(struct Expectation)),
                        .len = 0,
     };
 
@@ -68,12 +76,16 @@ static struct CodeArray parse_expectations_from_file(struct apigen_MemoryArena *
 
             char * item = str_trim(list);
             if (*item != 0) {
-                long const expected_code = strtol(item, NULL, 10);
-                if (expected_code != 0) {
+                char *     code_end;
+                long const expected_code = strtol(item, &code_end, 10);
+                if (expected_code != 0 && (*code_end == 0 || (*code_end == '@' && code_end[1] != 0))) {
                     if (result.len >= max_expected_items) {
                         apigen_panic("please adjust max_expected_items to successfully run this test!");
                     }
-                    result.ptr[result.len] = (enum apigen_DiagnosticCode)expected_code;
+                    result.ptr[result.len] = (struct Expectation) {
+                        .code      = (enum apigen_DiagnosticCode)expected_code,
+                        .file_name = (*code_end == '@') ? apigen_memory_arena_dupestr(arena, code_end + 1) : NULL,
+                    };
                     result.len += 1;
                 }
                 else {
@@ -87,13 +99,56 @@ static struct CodeArray parse_expectations_from_file(struct apigen_MemoryArena *
         }
     }
 
-    (void)arena;
-
     APIGEN_ASSERT(fseek(file, SEEK_SET, 0) == 0); // revert to start of file
 
     return result;
 }
 
+/// Runs the parser or analyzer on the already opened input and checks the expected diagnostics.
+static int run_test(
+    struct apigen_ParserState * const state,
+    struct apigen_Diagnostics * const diagnostics,
+    struct CliOptions const * const   options,
+    struct CodeArray const            expectations)
+{
+    bool ok = apigen_parse(state);
+
+    if (ok && (options->test_mode >= TEST_MODE_ANALYZER)) {
+        struct apigen_Document document;
+        ok = apigen_analyze(state, &document);
+    }
+
+    if (expectations.len > 0) {
+        bool expectations_met = true;
+
+        for (size_t i = 0; i < expectations.len; i++) {
+            struct Expectation const expectation = expectations.ptr[i];
+
+            if (!apigen_diagnostics_remove_one_in(diagnostics, expectation.code, expectation.file_name)) {
+                if (expectation.file_name != NULL) {
+                    fprintf(stderr, "error: expected diagnostic code %d in %s, but it was not present!\n", expectation.code, expectation.file_name);
+                }
+                else {
+                    fprintf(stderr, "error: expected diagnostic code %d, but it was not present!\n", expectation.code);
+                }
+                expectations_met = false;
+            }
+        }
+
+        if (apigen_diagnostics_has_any(diagnostics)) {
+            // got unexpected diagnostics, test failed
+            fprintf(stderr, "error: unexpected diagnostics are present!\n");
+            return false;
+        }
+
+        // all diagnostics are as expected, we successfully ran the test
+        return expectations_met ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    else {
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+}
+
 int apigen_test_runner(
     struct apigen_MemoryArena * const arena,
     struct apigen_Diagnostics * const diagnostics,
@@ -121,41 +176,27 @@ int apigen_test_runner(
         .ast_arena   = arena,
         .line_feed   = "\r\n",
         .diagnostics = diagnostics,
+        .jobs        = options->jobs,
+
+        .skip_documentation = options->no_docs,
     };
 
     if(!apigen_open_input_from_cwd(&state, options->positionals[0])) {
         return EXIT_FAILURE;
     }
 
-    bool ok = apigen_parse(&state);
-
-    if (ok && (options->test_mode >= TEST_MODE_ANALYZER)) {
-        struct apigen_Document document;
-        ok = apigen_analyze(&state, &document);
+    struct apigen_Directory module_cache;
+    if(!apigen_open_module_cache_from_cwd(&state, options->module_cache, &module_cache)) {
+        return EXIT_FAILURE;
     }
 
-    if (expectations.len > 0) {
-        bool expectations_met = true;
-
-        for (size_t i = 0; i < expectations.len; i++) {
-            enum apigen_DiagnosticCode const code = expectations.ptr[i];
+    int const result = run_test(&state, diagnostics, options, expectations);
 
-            if (!apigen_diagnostics_remove_one(diagnostics, code)) {
-                fprintf(stderr, "error: expected diagnostic code %d, but it was not present!\n", code);
-                expectations_met = false;
-            }
-        }
-
-        if (apigen_diagnostics_has_any(diagnostics)) {
-            // got unexpected diagnostics, test failed
-            fprintf(stderr, "error: unexpected diagnostics are present!\n");
-            return false;
-        }
-
-        // all diagnostics are as expected, we successfully ran the test
-        return expectations_met ? EXIT_SUCCESS : EXIT_FAILURE;
-    }
-    else {
-        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    apigen_io_close(&state.file);
+    apigen_io_close_dir(&state.source_dir);
+    if(state.module_cache != NULL) {
+        apigen_io_close_dir(&module_cache);
     }
+
+    return result;
 }
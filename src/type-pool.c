@@ -1,5 +1,7 @@
 #include "apigen.h"
 
+#include <pthread.h>
+#include <stdalign.h>
 #include <string.h>
 
 struct apigen_Type const apigen_type_void        = { .id = apigen_typeid_void };
@@ -31,69 +33,158 @@ struct apigen_Type const apigen_type_f64         = { .id = apigen_typeid_f64 };
 
 
 /// Pool nodes contain a name <-> value association, stored
-/// in a linked list.
+/// in an open addressing hash table. A slot is empty if `name` is `NULL`.
 struct apigen_TypePoolNamedType
 {
-    struct apigen_TypePoolNamedType * next;
-
     char const * name;
     struct apigen_Type const * type;
 };
 
-/// The cache contains a linked list of just
+/// The cache contains a hash table of pointers to just
 /// "type values". This is used for deduplicating types.
+/// Entries are allocated individually, so interned types have a stable address.
 struct apigen_TypePoolCache
 {
-    struct apigen_TypePoolCache * next;
-
+    uint64_t           hash; ///< structural hash of `interned_type`
     struct apigen_Type interned_type;
 };
 
+/// A part of a shared intern cache, see `apigen_type_pool_enable_sharing`.
+/// Types are assigned to shards by the upper bits of their structural hash.
+struct apigen_TypePoolShard
+{
+    pthread_mutex_t lock; ///< guards the table, entries are allocated from the arena of the inserting thread
+
+    struct apigen_TypePoolCache ** cache;
+    size_t                         cache_slots; ///< always a power of two
+    size_t                         cache_count;
+};
+
+/// Number of shards of a shared intern cache, as a power of two.
+#define TYPE_POOL_SHARD_BITS 6
+#define TYPE_POOL_SHARD_COUNT (1U << TYPE_POOL_SHARD_BITS)
+
+/// Number of slots of the intern cache after the first insertion.
+static size_t const CACHE_INITIAL_SLOTS = 64;
+
+/// Number of slots of the named type table after the first registration.
+static size_t const NAMED_TYPES_INITIAL_SLOTS = 64;
+
+struct BuiltinTypeName
+{
+    char const * name;
+    struct apigen_Type const * type;
+};
+
+/// Perfect hash table of all builtin type names, indexed by `hash_builtin_name`.
+static struct BuiltinTypeName const builtin_type_names[64] = {
+    [ 0] = { "c_char",      &apigen_type_char },
+    [ 1] = { "isize",       &apigen_type_isize },
+    [ 2] = { "c_longlong",  &apigen_type_c_longlong },
+    [ 3] = { "u32",         &apigen_type_u32 },
+    [ 5] = { "i8",          &apigen_type_i8 },
+    [ 7] = { "void",        &apigen_type_void },
+    [ 9] = { "bool",        &apigen_type_bool },
+    [10] = { "c_int",       &apigen_type_c_int },
+    [13] = { "usize",       &apigen_type_usize },
+    [16] = { "f64",         &apigen_type_f64 },
+    [17] = { "u8",          &apigen_type_u8 },
+    [19] = { "i64",         &apigen_type_i64 },
+    [20] = { "c_ichar",     &apigen_type_ichar },
+    [24] = { "c_short",     &apigen_type_c_short },
+    [31] = { "u64",         &apigen_type_u64 },
+    [33] = { "anyopaque",   &apigen_type_anyopaque },
+    [37] = { "c_ulong",     &apigen_type_c_ulong },
+    [42] = { "c_long",      &apigen_type_c_long },
+    [44] = { "c_uint",      &apigen_type_c_uint },
+    [47] = { "i16",         &apigen_type_i16 },
+    [48] = { "c_uchar",     &apigen_type_uchar },
+    [52] = { "f32",         &apigen_type_f32 },
+    [55] = { "i32",         &apigen_type_i32 },
+    [56] = { "c_ushort",    &apigen_type_c_ushort },
+    [59] = { "u16",         &apigen_type_u16 },
+    [61] = { "c_ulonglong", &apigen_type_c_ulonglong },
+};
+
+static size_t hash_builtin_name(char const * name, size_t len)
+{
+    APIGEN_ASSERT(len >= 2);
+    unsigned char const * const str = (unsigned char const *)name;
+    return (str[0] + str[len - 1] + 6 * len + 13U * str[(len > 2) ? 2 : 1]) & 63U;
+}
+
+static struct apigen_Type const * lookup_builtin_type(char const * type_name)
+{
+    size_t const len = strlen(type_name);
+    if(len < 2) {
+        return NULL;
+    }
+    struct BuiltinTypeName const * const entry = &builtin_type_names[hash_builtin_name(type_name, len)];
+    if(entry->name == NULL || !apigen_streq(entry->name, type_name)) {
+        return NULL;
+    }
+    return entry->type;
+}
+
+/// Names are interned, so the address of the name is a sufficient key.
+static size_t hash_interned_name(char const * name)
+{
+    uint64_t const hash = (uint64_t)(uintptr_t)name * 0x9E3779B97F4A7C15ULL;
+    return (size_t)(hash >> 32);
+}
+
+/// Returns the slot that contains `interned_name`, or the empty slot where it belongs.
+static struct apigen_TypePoolNamedType * find_named_type_slot(struct apigen_TypePoolNamedType * slots, size_t slot_count, char const * interned_name)
+{
+    size_t const mask = slot_count - 1;
+
+    size_t index = hash_interned_name(interned_name) & mask;
+    while(slots[index].name != NULL && slots[index].name != interned_name) {
+        index = (index + 1) & mask;
+    }
+    return &slots[index];
+}
+
+/// Allocates a table with twice the size (or the initial one) and moves all entries over.
+static void grow_named_types(struct apigen_TypePool * pool)
+{
+    size_t const new_slot_count = (pool->named_type_slots > 0) ? (2 * pool->named_type_slots) : NAMED_TYPES_INITIAL_SLOTS;
+
+    struct apigen_TypePoolNamedType * const new_slots = apigen_memory_arena_alloc_aligned(pool->arena, new_slot_count * sizeof(struct apigen_TypePoolNamedType), alignof(struct apigen_TypePoolNamedType));
+    memset(new_slots, 0, new_slot_count * sizeof(struct apigen_TypePoolNamedType));
+
+    for(size_t i = 0; i < pool->named_type_slots; i++) {
+        struct apigen_TypePoolNamedType const entry = pool->named_types[i];
+        if(entry.name != NULL) {
+            *find_named_type_slot(new_slots, new_slot_count, entry.name) = entry;
+        }
+    }
+
+    pool->named_types      = new_slots;
+    pool->named_type_slots = new_slot_count;
+}
+
 struct apigen_Type const * apigen_lookup_type(struct apigen_TypePool const * pool, char const * type_name)
 {
     APIGEN_NOT_NULL(pool);
     APIGEN_NOT_NULL(type_name);
 
-    // first, do some stupid name matching:
-    if(apigen_streq(type_name, "void"))        return &apigen_type_void;
-    if(apigen_streq(type_name, "anyopaque"))   return &apigen_type_anyopaque;
-    if(apigen_streq(type_name, "bool"))        return &apigen_type_bool;
-    if(apigen_streq(type_name, "c_uchar"))     return &apigen_type_uchar;
-    if(apigen_streq(type_name, "c_ichar"))     return &apigen_type_ichar;
-    if(apigen_streq(type_name, "c_char"))      return &apigen_type_char;
-    if(apigen_streq(type_name, "u8"))          return &apigen_type_u8;
-    if(apigen_streq(type_name, "u16"))         return &apigen_type_u16;
-    if(apigen_streq(type_name, "u32"))         return &apigen_type_u32;
-    if(apigen_streq(type_name, "u64"))         return &apigen_type_u64;
-    if(apigen_streq(type_name, "usize"))       return &apigen_type_usize;
-    if(apigen_streq(type_name, "c_ushort"))    return &apigen_type_c_ushort;
-    if(apigen_streq(type_name, "c_uint"))      return &apigen_type_c_uint;
-    if(apigen_streq(type_name, "c_ulong"))     return &apigen_type_c_ulong;
-    if(apigen_streq(type_name, "c_ulonglong")) return &apigen_type_c_ulonglong;
-    if(apigen_streq(type_name, "i8"))          return &apigen_type_i8;
-    if(apigen_streq(type_name, "i16"))         return &apigen_type_i16;
-    if(apigen_streq(type_name, "i32"))         return &apigen_type_i32;
-    if(apigen_streq(type_name, "i64"))         return &apigen_type_i64;
-    if(apigen_streq(type_name, "isize"))       return &apigen_type_isize;
-    if(apigen_streq(type_name, "c_short"))     return &apigen_type_c_short;
-    if(apigen_streq(type_name, "c_int"))       return &apigen_type_c_int;
-    if(apigen_streq(type_name, "c_long"))      return &apigen_type_c_long;
-    if(apigen_streq(type_name, "c_longlong"))  return &apigen_type_c_longlong;
-    if(apigen_streq(type_name, "f32"))         return &apigen_type_f32;
-    if(apigen_streq(type_name, "f64"))         return &apigen_type_f64;
-
-    // search in well-known types:
-    {
-        struct apigen_TypePoolNamedType const * iter = pool->named_types;
-        while(iter) {
-            if(apigen_streq(iter->name, type_name)) {
-                return iter->type;
-            }
-            iter = iter->next;
-        }
+    struct apigen_Type const * const builtin_type = lookup_builtin_type(type_name);
+    if(builtin_type != NULL) {
+        return builtin_type;
     }
 
-    return NULL;
+    if(pool->named_type_count == 0) {
+        return NULL;
+    }
+
+    // search in well-known types, their names are interned:
+    char const * const interned_name = apigen_string_pool_find(pool->strings, type_name);
+    if(interned_name == NULL) {
+        return NULL;
+    }
+
+    return find_named_type_slot(pool->named_types, pool->named_type_slots, interned_name)->type;
 }
 
 bool apigen_register_type(struct apigen_TypePool * pool, struct apigen_Type const * type, char const * name_hint)
@@ -105,18 +196,29 @@ bool apigen_register_type(struct apigen_TypePool * pool, struct apigen_Type cons
 
     APIGEN_ASSERT(type_name != NULL);
 
-    if(apigen_lookup_type(pool, type_name) != NULL) {
-        return NULL;
+    if(lookup_builtin_type(type_name) != NULL) {
+        return false;
+    }
+
+    // keep the load factor below 3/4:
+    if(4 * (pool->named_type_count + 1) > 3 * pool->named_type_slots) {
+        grow_named_types(pool);
+    }
+
+    char const * const interned_name = apigen_string_pool_intern(pool->strings, type_name);
+
+    struct apigen_TypePoolNamedType * const slot = find_named_type_slot(pool->named_types, pool->named_type_slots, interned_name);
+    if(slot->name != NULL) {
+        return false;
     }
 
-    struct apigen_TypePoolNamedType * const node = apigen_memory_arena_alloc(pool->arena, sizeof(struct apigen_TypePoolNamedType));
-    *node = (struct apigen_TypePoolNamedType) {
-        .next = pool->named_types,
-        .name = apigen_memory_arena_dupestr(pool->arena, type_name),
+    *slot = (struct apigen_TypePoolNamedType) {
+        .name = interned_name,
         .type = type,
     };
-    pool->named_types = node;
-    return node->type;
+    pool->named_type_count += 1;
+
+    return true;
 }
 
 
@@ -209,6 +311,124 @@ static bool is_sentinelled_ptr(enum apigen_TypeId id)
     return false;
 }
 
+static uint64_t hash_combine(uint64_t hash, uint64_t value)
+{
+    hash ^= value + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+static uint64_t hash_str(uint64_t hash, char const * str)
+{
+    while(*str) {
+        hash = (hash ^ (unsigned char)*str) * 0x100000001b3ULL;
+        str += 1;
+    }
+    return hash_combine(hash, 0);
+}
+
+static uint64_t hash_value(uint64_t hash, struct apigen_Value const * value)
+{
+    hash = hash_combine(hash, value->type);
+    switch(value->type) {
+        case apigen_value_null: return hash;
+        case apigen_value_sint: return hash_combine(hash, (uint64_t)value->value_sint);
+        case apigen_value_uint: return hash_combine(hash, value->value_uint);
+        case apigen_value_str:  return hash_str(hash, value->value_str);
+    }
+    __builtin_unreachable();
+}
+
+/// Computes a hash that is equal for all types that are equal by `apigen_type_eql`.
+/// Child types are already interned, so their address is hashed instead of their structure.
+/// Documentation is compared, but not hashed.
+static uint64_t hash_type_structure(struct apigen_Type const * type)
+{
+    uint64_t hash = hash_combine(0, type->id);
+
+    switch(type->id) {
+        case apigen_typeid_ptr_to_one:
+        case apigen_typeid_ptr_to_many:
+        case apigen_typeid_ptr_to_sentinelled_many:
+        case apigen_typeid_nullable_ptr_to_one:
+        case apigen_typeid_nullable_ptr_to_many:
+        case apigen_typeid_nullable_ptr_to_sentinelled_many:
+        case apigen_typeid_const_ptr_to_one:
+        case apigen_typeid_const_ptr_to_many:
+        case apigen_typeid_const_ptr_to_sentinelled_many:
+        case apigen_typeid_nullable_const_ptr_to_one:
+        case apigen_typeid_nullable_const_ptr_to_many:
+        case apigen_typeid_nullable_const_ptr_to_sentinelled_many: {
+            struct apigen_Pointer const * const extra = type->extra;
+            hash = hash_combine(hash, (uintptr_t)extra->underlying_type);
+            if(is_sentinelled_ptr(type->id)) {
+                hash = hash_value(hash, &extra->sentinel);
+            }
+            return hash;
+        }
+
+        case apigen_typeid_array: {
+            struct apigen_Array const * const extra = type->extra;
+            hash = hash_combine(hash, (uintptr_t)extra->underlying_type);
+            return hash_combine(hash, extra->size);
+        }
+
+        case apigen_typeid_function: {
+            struct apigen_FunctionType const * const extra = type->extra;
+            hash = hash_combine(hash, (uintptr_t)extra->return_type);
+            hash = hash_combine(hash, extra->parameter_count);
+            for(size_t i = 0; i < extra->parameter_count; i++) {
+                hash = hash_str(hash, extra->parameters[i].name);
+                hash = hash_combine(hash, (uintptr_t)extra->parameters[i].type);
+            }
+            return hash;
+        }
+
+        default:
+            return hash;
+    }
+}
+
+/// Returns the slot that contains a type equal to `type`, or the empty slot where it belongs.
+static struct apigen_TypePoolCache ** find_cache_slot(struct apigen_TypePoolCache ** slots, size_t slot_count, uint64_t hash, struct apigen_Type const * type)
+{
+    size_t const mask = slot_count - 1;
+
+    size_t index = (size_t)(hash ^ (hash >> 32)) & mask;
+    while(slots[index] != NULL) {
+        // equality is only checked on a hash match:
+        if(slots[index]->hash == hash && apigen_type_eql(&slots[index]->interned_type, type)) {
+            break;
+        }
+        index = (index + 1) & mask;
+    }
+    return &slots[index];
+}
+
+/// Allocates a table with twice the size (or the initial one) and moves all entries over.
+static void grow_cache(struct apigen_MemoryArena * arena, struct apigen_TypePoolCache *** cache, size_t * cache_slots)
+{
+    size_t const new_slot_count = (*cache_slots > 0) ? (2 * *cache_slots) : CACHE_INITIAL_SLOTS;
+
+    struct apigen_TypePoolCache ** const new_slots = apigen_memory_arena_alloc_aligned(arena, new_slot_count * sizeof(struct apigen_TypePoolCache *), alignof(struct apigen_TypePoolCache *));
+    memset(new_slots, 0, new_slot_count * sizeof(struct apigen_TypePoolCache *));
+
+    size_t const mask = new_slot_count - 1;
+    for(size_t i = 0; i < *cache_slots; i++) {
+        struct apigen_TypePoolCache * const entry = (*cache)[i];
+        if(entry != NULL) {
+            // entries are unique, so we only need to find a free slot:
+            size_t index = (size_t)(entry->hash ^ (entry->hash >> 32)) & mask;
+            while(new_slots[index] != NULL) {
+                index = (index + 1) & mask;
+            }
+            new_slots[index] = entry;
+        }
+    }
+
+    *cache       = new_slots;
+    *cache_slots = new_slot_count;
+}
+
 bool apigen_type_eql(struct apigen_Type const * type1, struct apigen_Type const * type2)
 {
     APIGEN_NOT_NULL(type1);
@@ -357,36 +577,31 @@ bool apigen_type_eql(struct apigen_Type const * type1, struct apigen_Type const
     }
 }
 
-struct apigen_Type const * apigen_intern_type(struct apigen_TypePool * pool, struct apigen_Type const * unchecked_type)
+/// Returns the canonical version of `unchecked_type` from the table `cache`, new entries are allocated from `arena`.
+static struct apigen_Type const * intern_into_cache(
+    struct apigen_MemoryArena * arena,
+    struct apigen_TypePoolCache *** cache,
+    size_t * cache_slots,
+    size_t * cache_count,
+    uint64_t hash,
+    struct apigen_Type const * unchecked_type)
 {
-    APIGEN_NOT_NULL(pool);
-    APIGEN_NOT_NULL(unchecked_type);
-
-    if(apigen_is_type_unique(unchecked_type->id)) {
-        // unique types are unique, they cannot be interned
-        return unchecked_type;
+    // keep the load factor below 3/4, even if this turns out to be a cache hit:
+    if(4 * (*cache_count + 1) > 3 * *cache_slots) {
+        grow_cache(arena, cache, cache_slots);
     }
 
-    if(apigen_is_type_builtin(unchecked_type->id)) {
-        // builtin types are assumed to be static, no need for interning
-        APIGEN_ASSERT(apigen_get_builtin_type(unchecked_type->id) == unchecked_type);
-        return unchecked_type;
-    }
-
-    struct apigen_TypePoolCache * cache_entry = pool->cache;
-    while(cache_entry) {
-        if(apigen_type_eql(&cache_entry->interned_type, unchecked_type)) {
-            // fprintf(stderr, "cache hit for %s\n", apigen_type_str(unchecked_type->id));
-            return &cache_entry->interned_type;
-        }
-        cache_entry = cache_entry->next;
+    struct apigen_TypePoolCache ** const slot = find_cache_slot(*cache, *cache_slots, hash, unchecked_type);
+    if(*slot != NULL) {
+        // fprintf(stderr, "cache hit for %s\n", apigen_type_str(unchecked_type->id));
+        return &(*slot)->interned_type;
     }
 
     // TYPE was not inserted into the intern pool yet
-    cache_entry = apigen_memory_arena_alloc(pool->arena, sizeof(struct apigen_TypePoolCache));
+    struct apigen_TypePoolCache * const cache_entry = apigen_memory_arena_alloc_aligned(arena, sizeof(struct apigen_TypePoolCache), alignof(struct apigen_TypePoolCache));
     *cache_entry = (struct apigen_TypePoolCache) {
+        .hash          = hash,
         .interned_type = *unchecked_type,
-        .next = pool->cache,
     };
 
     // duplicate extra-storage
@@ -432,18 +647,92 @@ struct apigen_Type const * apigen_intern_type(struct apigen_TypePool * pool, str
     }
 
     if(extra_size > 0) {
-        void * extra_storage = apigen_memory_arena_alloc(pool->arena, extra_size);
+        void * extra_storage = apigen_memory_arena_alloc(arena, extra_size);
         memcpy( extra_storage, unchecked_type->extra, extra_size);
         cache_entry->interned_type.extra = extra_storage;
     }
 
+    // the sentinel string may live in memory that is released before the pool:
+    if(is_sentinelled_ptr(cache_entry->interned_type.id)) {
+        struct apigen_Pointer * const pointer = (struct apigen_Pointer *)cache_entry->interned_type.extra;
+        if(pointer->sentinel.type == apigen_value_str) {
+            pointer->sentinel.value_str = apigen_memory_arena_dupestr(arena, pointer->sentinel.value_str);
+        }
+    }
+
     // fprintf(stderr, "cache insert for %s\n", apigen_type_str(unchecked_type->id));
 
-    pool->cache = cache_entry;
+    *slot = cache_entry;
+    *cache_count += 1;
 
     return &cache_entry->interned_type;
 }
 
+struct apigen_Type const * apigen_intern_type(struct apigen_TypePool * pool, struct apigen_Type const * unchecked_type)
+{
+    APIGEN_NOT_NULL(pool);
+    APIGEN_NOT_NULL(unchecked_type);
+
+    if(apigen_is_type_unique(unchecked_type->id)) {
+        // unique types are unique, they cannot be interned
+        return unchecked_type;
+    }
+
+    if(apigen_is_type_builtin(unchecked_type->id)) {
+        // builtin types are assumed to be static, no need for interning
+        APIGEN_ASSERT(apigen_get_builtin_type(unchecked_type->id) == unchecked_type);
+        return unchecked_type;
+    }
+
+    uint64_t const hash = hash_type_structure(unchecked_type);
+
+    if(pool->shards != NULL) {
+        struct apigen_TypePoolShard * const shard = &pool->shards[hash >> (64 - TYPE_POOL_SHARD_BITS)];
+
+        pthread_mutex_lock(&shard->lock);
+        struct apigen_Type const * const interned_type = intern_into_cache(pool->arena, &shard->cache, &shard->cache_slots, &shard->cache_count, hash, unchecked_type);
+        pthread_mutex_unlock(&shard->lock);
+
+        return interned_type;
+    }
+
+    return intern_into_cache(pool->arena, &pool->cache, &pool->cache_slots, &pool->cache_count, hash, unchecked_type);
+}
+
+void apigen_type_pool_enable_sharing(struct apigen_TypePool * pool)
+{
+    APIGEN_NOT_NULL(pool);
+    APIGEN_ASSERT(pool->shards == NULL);
+
+    struct apigen_TypePoolShard * const shards = apigen_memory_arena_alloc_aligned(pool->arena, TYPE_POOL_SHARD_COUNT * sizeof(struct apigen_TypePoolShard), alignof(struct apigen_TypePoolShard));
+    for(size_t i = 0; i < TYPE_POOL_SHARD_COUNT; i++) {
+        shards[i] = (struct apigen_TypePoolShard) {
+            .cache       = NULL,
+            .cache_slots = 0,
+            .cache_count = 0,
+        };
+        pthread_mutex_init(&shards[i].lock, NULL);
+    }
+
+    // types that were interned before must stay canonical:
+    for(size_t i = 0; i < pool->cache_slots; i++) {
+        struct apigen_TypePoolCache * const entry = pool->cache[i];
+        if(entry != NULL) {
+            struct apigen_TypePoolShard * const shard = &shards[entry->hash >> (64 - TYPE_POOL_SHARD_BITS)];
+            if(4 * (shard->cache_count + 1) > 3 * shard->cache_slots) {
+                grow_cache(pool->arena, &shard->cache, &shard->cache_slots);
+            }
+            *find_cache_slot(shard->cache, shard->cache_slots, entry->hash, &entry->interned_type) = entry;
+            shard->cache_count += 1;
+        }
+    }
+
+    pool->cache       = NULL;
+    pool->cache_slots = 0;
+    pool->cache_count = 0;
+    pool->shards      = shards;
+}
+
 
 bool apigen_type_is_primitive_type(enum apigen_TypeId type)
 {
@@ -1,6 +1,9 @@
 #include "apigen.h"
 #include "unittest.h"
 
+#include <pthread.h>
+#include <stdalign.h>
+
 
 UNITTEST("Arena: basic init/deinit")
 {
@@ -36,3 +39,374 @@ UNITTEST("Arena: large allocations")
     apigen_memory_arena_deinit(&arena);
 }
 
+
+UNITTEST("Arena: geometric chunk growth is capped")
+{
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+    arena.max_chunk_size = 8 * arena.chunk_size;
+
+    size_t const max_chunk_size = arena.max_chunk_size;
+    size_t previous_chunk_size = arena.chunk_size;
+    for(size_t i = 0; i < 4096; i++) {
+        (void)apigen_memory_arena_alloc(&arena, 100);
+        APIGEN_ASSERT(arena.chunk_size >= previous_chunk_size);
+        APIGEN_ASSERT(arena.chunk_size <= max_chunk_size);
+        previous_chunk_size = arena.chunk_size;
+    }
+    APIGEN_ASSERT(arena.chunk_size == max_chunk_size);
+
+    apigen_memory_arena_deinit(&arena);
+}
+
+UNITTEST("Arena: oversized allocations keep the growth policy")
+{
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    size_t const chunk_size = arena.chunk_size;
+    (void)apigen_memory_arena_alloc(&arena, 16 * chunk_size);
+    APIGEN_ASSERT(arena.chunk_size == chunk_size);
+
+    apigen_memory_arena_deinit(&arena);
+}
+
+UNITTEST("Arena: small allocations reuse chunk tails")
+{
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    char * const first = apigen_memory_arena_alloc(&arena, 16);
+
+    // forces a new chunk, the tail of the first chunk is kept around
+    (void)apigen_memory_arena_alloc(&arena, 4 * arena.chunk_size);
+    (void)apigen_memory_arena_alloc(&arena, 4 * arena.chunk_size);
+    APIGEN_ASSERT(arena.partial_chunks != NULL);
+
+    char * const second = apigen_memory_arena_alloc(&arena, 16);
+    APIGEN_ASSERT(second > first && second < first + 1024);
+
+    apigen_memory_arena_deinit(&arena);
+}
+
+UNITTEST("Arena: rewind releases allocations after the mark")
+{
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    (void)apigen_memory_arena_alloc(&arena, 32);
+
+    struct apigen_MemoryArenaMark const mark = apigen_memory_arena_mark(&arena);
+    char * const first = apigen_memory_arena_alloc(&arena, 32);
+    for(size_t i = 0; i < 64; i++) {
+        (void)apigen_memory_arena_alloc(&arena, 1000);
+    }
+    apigen_memory_arena_rewind(&arena, mark);
+
+    char * const second = apigen_memory_arena_alloc(&arena, 32);
+    APIGEN_ASSERT(first == second);
+
+    apigen_memory_arena_deinit(&arena);
+}
+
+UNITTEST("Arena: chunk tails are used and restored across a mark")
+{
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    char * const first = apigen_memory_arena_alloc(&arena, 16);
+    (void)apigen_memory_arena_alloc(&arena, 4 * arena.chunk_size);
+    (void)apigen_memory_arena_alloc(&arena, 4 * arena.chunk_size);
+    APIGEN_ASSERT(arena.partial_chunks == arena.first_chunk);
+
+    struct apigen_MemoryArenaMark const mark = apigen_memory_arena_mark(&arena);
+    APIGEN_ASSERT(arena.partial_chunks == arena.first_chunk);
+
+    // takes most of the tail, so the chunk is dropped from the partial list:
+    char * const second = apigen_memory_arena_alloc(&arena, 960);
+    APIGEN_ASSERT(second > first && second < first + 1024);
+    APIGEN_ASSERT(arena.partial_chunks == NULL);
+
+    apigen_memory_arena_rewind(&arena, mark);
+    APIGEN_ASSERT(arena.partial_chunks == arena.first_chunk);
+    APIGEN_ASSERT(apigen_memory_arena_alloc(&arena, 960) == second);
+
+    apigen_memory_arena_deinit(&arena);
+}
+
+UNITTEST("Arena: nested marks on an empty arena")
+{
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    struct apigen_MemoryArenaMark const outer = apigen_memory_arena_mark(&arena);
+    (void)apigen_memory_arena_alloc(&arena, 4000);
+
+    struct apigen_MemoryArenaMark const inner = apigen_memory_arena_mark(&arena);
+    (void)apigen_memory_arena_alloc(&arena, 4000);
+    (void)apigen_memory_arena_alloc(&arena, 16);
+    apigen_memory_arena_rewind(&arena, inner);
+
+    APIGEN_ASSERT(arena.first_chunk != NULL);
+    APIGEN_ASSERT(arena.first_chunk == arena.last_chunk);
+
+    apigen_memory_arena_rewind(&arena, outer);
+    APIGEN_ASSERT(arena.first_chunk == NULL);
+    APIGEN_ASSERT(arena.last_chunk == NULL);
+
+    apigen_memory_arena_deinit(&arena);
+}
+
+UNITTEST("Arena: reset keeps chunks")
+{
+    apigen_memory_enable_stats();
+
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    for(size_t i = 0; i < 64; i++) {
+        (void)apigen_memory_arena_alloc(&arena, 500);
+    }
+    struct apigen_MemoryArenaChunk * const last_chunk = arena.last_chunk;
+    size_t const heap_allocs = apigen_memory_get_stats(APIGEN_MEMORY_TAG_OTHER).heap_allocs;
+
+    apigen_memory_arena_reset(&arena);
+    APIGEN_ASSERT(arena.first_chunk == last_chunk);
+    for(size_t i = 0; i < 64; i++) {
+        (void)apigen_memory_arena_alloc(&arena, 500);
+    }
+    APIGEN_ASSERT(apigen_memory_get_stats(APIGEN_MEMORY_TAG_OTHER).heap_allocs == heap_allocs);
+
+    apigen_memory_arena_deinit(&arena);
+}
+
+UNITTEST("Arena: reset reuses more chunks than the partial list holds")
+{
+    apigen_memory_enable_stats();
+
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+    arena.max_chunk_size = arena.chunk_size;
+
+    // two allocations per chunk, so there are many more chunks than partial tails:
+    for(size_t i = 0; i < 64; i++) {
+        (void)apigen_memory_arena_alloc(&arena, 500);
+    }
+    size_t const heap_allocs = apigen_memory_get_stats(APIGEN_MEMORY_TAG_OTHER).heap_allocs;
+
+    for(size_t round = 0; round < 3; round++) {
+        apigen_memory_arena_reset(&arena);
+        APIGEN_ASSERT(arena.partial_chunks == NULL);
+        APIGEN_ASSERT(arena.free_chunks != NULL);
+        for(size_t i = 0; i < 64; i++) {
+            (void)apigen_memory_arena_alloc(&arena, 500);
+        }
+        APIGEN_ASSERT(apigen_memory_get_stats(APIGEN_MEMORY_TAG_OTHER).heap_allocs == heap_allocs);
+    }
+
+    apigen_memory_arena_deinit(&arena);
+}
+
+UNITTEST("Arena: aligned and packed allocations")
+{
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    char * const str1 = apigen_memory_arena_alloc_packed(&arena, 3);
+    char * const str2 = apigen_memory_arena_alloc_packed(&arena, 5);
+    APIGEN_ASSERT(str2 + 5 == str1);
+
+    for(size_t i = 0; i < 256; i++) {
+        size_t const alignment = (size_t)1 << (i % 4);
+        char * const ptr = apigen_memory_arena_alloc_aligned(&arena, 1 + i % 13, alignment);
+        APIGEN_ASSERT(((uintptr_t)ptr & (alignment - 1)) == 0);
+        (void)apigen_memory_arena_alloc_packed(&arena, 1 + i % 7);
+    }
+
+    apigen_memory_arena_deinit(&arena);
+}
+
+UNITTEST("Arena: reserved virtual memory")
+{
+    struct apigen_MemoryArena arena;
+    if(!apigen_memory_arena_init_reserved(&arena, 64 * 1024 * 1024, false)) {
+        return; // platform does not support reservations
+    }
+
+    struct apigen_MemoryArenaMark const mark = apigen_memory_arena_mark(&arena);
+
+    // crosses several commit steps from both ends of the reservation
+    for(size_t i = 0; i < 8; i++) {
+        char * const block = apigen_memory_arena_alloc(&arena, 1024 * 1024 + 1);
+        block[1024 * 1024] = 0;
+        char * const str = apigen_memory_arena_alloc_packed(&arena, 1024 * 1024 + 1);
+        str[0] = 0;
+    }
+    APIGEN_ASSERT(arena.first_chunk == arena.last_chunk);
+
+    apigen_memory_arena_rewind(&arena, mark);
+    (void)apigen_memory_arena_dupestr(&arena, "hello");
+
+    apigen_memory_arena_deinit(&arena);
+}
+
+UNITTEST("Arena: allocations are accounted to the active memory tag")
+{
+    apigen_memory_enable_stats();
+
+    enum apigen_MemoryTag const previous_tag = apigen_memory_set_tag(APIGEN_MEMORY_TAG_BACKEND);
+    struct apigen_MemoryTagStats const before = apigen_memory_get_stats(APIGEN_MEMORY_TAG_BACKEND);
+
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    (void)apigen_memory_arena_alloc_packed(&arena, 3);
+    (void)apigen_memory_arena_alloc_aligned(&arena, 8, 8);
+
+    struct apigen_MemoryTagStats const after = apigen_memory_get_stats(APIGEN_MEMORY_TAG_BACKEND);
+    APIGEN_ASSERT(after.arena_allocs == before.arena_allocs + 2);
+    APIGEN_ASSERT(after.arena_requested == before.arena_requested + 11);
+    APIGEN_ASSERT(after.heap_allocs == before.heap_allocs + 1);
+    APIGEN_ASSERT(after.heap_current > before.heap_current);
+
+    apigen_memory_arena_deinit(&arena);
+
+    APIGEN_ASSERT(apigen_memory_get_stats(APIGEN_MEMORY_TAG_BACKEND).heap_current == before.heap_current);
+
+    apigen_memory_set_tag(previous_tag);
+}
+
+static void * alloc_from_thread(void * arena)
+{
+    apigen_memory_set_tag(APIGEN_MEMORY_TAG_BACKEND);
+    (void)apigen_memory_arena_alloc_packed(arena, 5);
+    apigen_memory_flush_thread_stats();
+    return NULL;
+}
+
+UNITTEST("Arena: statistics of other threads are flushed")
+{
+    apigen_memory_enable_stats();
+
+    struct apigen_MemoryTagStats const before = apigen_memory_get_stats(APIGEN_MEMORY_TAG_BACKEND);
+
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    pthread_t thread;
+    APIGEN_ASSERT(pthread_create(&thread, NULL, alloc_from_thread, &arena) == 0);
+    APIGEN_ASSERT(pthread_join(thread, NULL) == 0);
+
+    struct apigen_MemoryTagStats const after = apigen_memory_get_stats(APIGEN_MEMORY_TAG_BACKEND);
+    APIGEN_ASSERT(after.arena_allocs == before.arena_allocs + 1);
+    APIGEN_ASSERT(after.arena_requested == before.arena_requested + 5);
+    APIGEN_ASSERT(after.heap_allocs == before.heap_allocs + 1);
+
+    // the chunk was allocated by the other thread, but is released by this one:
+    apigen_memory_arena_deinit(&arena);
+
+    APIGEN_ASSERT(apigen_memory_get_stats(APIGEN_MEMORY_TAG_BACKEND).heap_current == before.heap_current);
+}
+
+APIGEN_DECLARE_ARRAY(TestIntArray, int);
+APIGEN_DEFINE_ARRAY_OPERATORS(TestIntArray, int, test_int_array)
+
+UNITTEST("Arena: growable arrays")
+{
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    struct TestIntArray array = {0};
+    test_int_array_append(&arena, &array, 0);
+    APIGEN_ASSERT(array.count == 1);
+
+    // the array is the most recent allocation, so it grows in place:
+    int * const initial_items = array.items;
+    for(int i = 1; i < 16; i++) {
+        test_int_array_append(&arena, &array, i);
+    }
+    APIGEN_ASSERT(array.items == initial_items);
+    APIGEN_ASSERT(array.capacity >= 16);
+
+    // another allocation blocks the growth, so the array has to move:
+    (void)apigen_memory_arena_alloc(&arena, 1);
+    while(array.count < array.capacity) {
+        test_int_array_append(&arena, &array, (int)array.count);
+    }
+    test_int_array_append(&arena, &array, (int)array.count);
+    APIGEN_ASSERT(array.items != initial_items);
+
+    for(size_t i = 0; i < array.count; i++) {
+        APIGEN_ASSERT(array.items[i] == (int)i);
+    }
+
+    apigen_memory_arena_deinit(&arena);
+}
+
+UNITTEST("Arena: arrays from before a mark do not grow in place")
+{
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    struct TestIntArray array = {0};
+    for(int i = 0; i < 4; i++) {
+        test_int_array_append(&arena, &array, i);
+    }
+    struct TestIntArray const before_mark = array;
+
+    struct apigen_MemoryArenaMark const mark = apigen_memory_arena_mark(&arena);
+    for(int i = 4; i < 64; i++) {
+        test_int_array_append(&arena, &array, i);
+    }
+    APIGEN_ASSERT(array.items != before_mark.items);
+
+    // rewinding releases the grown array, but leaves the one from before the mark intact:
+    apigen_memory_arena_rewind(&arena, mark);
+    array = before_mark;
+    int * const after_rewind = apigen_memory_arena_alloc_aligned(&arena, sizeof(int), alignof(int));
+    APIGEN_ASSERT(after_rewind == array.items + array.capacity);
+    for(int i = 0; i < 4; i++) {
+        APIGEN_ASSERT(array.items[i] == i);
+    }
+
+    // once the mark is kept, the most recent array grows in place again:
+    struct apigen_MemoryArenaMark const kept = apigen_memory_arena_mark(&arena);
+    struct TestIntArray recent = {0};
+    test_int_array_append(&arena, &recent, 0);
+    apigen_memory_arena_keep(&arena, kept);
+    int * const recent_items = recent.items;
+    for(int i = 1; i < 16; i++) {
+        test_int_array_append(&arena, &recent, i);
+    }
+    APIGEN_ASSERT(recent.items == recent_items);
+
+    apigen_memory_arena_deinit(&arena);
+}
+
+UNITTEST("Arena: adopted memory lives until deinit")
+{
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    struct apigen_MemoryArena other;
+    apigen_memory_arena_init(&other);
+
+    char * strings[64];
+    for(size_t i = 0; i < 64; i++) {
+        strings[i] = apigen_memory_arena_dupestr(&other, "adopted string that fills several chunks of the other arena");
+    }
+
+    struct apigen_MemoryArenaMark const mark = apigen_memory_arena_mark(&arena);
+    apigen_memory_arena_adopt(&arena, &other);
+
+    // neither rewinding nor resetting touches adopted memory:
+    (void)apigen_memory_arena_alloc(&arena, 4096);
+    apigen_memory_arena_rewind(&arena, mark);
+    apigen_memory_arena_reset(&arena);
+
+    for(size_t i = 0; i < 64; i++) {
+        APIGEN_ASSERT(apigen_streq(strings[i], "adopted string that fills several chunks of the other arena"));
+    }
+
+    apigen_memory_arena_deinit(&arena);
+}
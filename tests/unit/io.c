@@ -1,6 +1,8 @@
 #include "apigen.h"
 #include "unittest.h"
 
+#include <string.h>
+
 #define CTX "I/O: "
 
 UNITTEST(CTX "get cwd")
@@ -20,3 +22,66 @@ UNITTEST(CTX "open self")
     apigen_io_close_dir(&dir);
 }
 
+
+UNITTEST(CTX "map file")
+{
+    struct apigen_Directory cwd = apigen_io_cwd();
+
+    char streamed[256];
+    size_t streamed_length;
+    {
+        struct apigen_Stream file;
+        APIGEN_ASSERT( apigen_io_open_file_read(cwd, "tests/parser/enums.api", &file) );
+        streamed_length = apigen_io_read(file, streamed, sizeof streamed);
+        apigen_io_close(&file);
+    }
+    APIGEN_ASSERT(streamed_length == sizeof streamed);
+
+    struct apigen_Stream file;
+    APIGEN_ASSERT( apigen_io_open_file_read(cwd, "tests/parser/enums.api", &file) );
+
+    size_t length;
+    char const * const mapped = apigen_io_map(file, &length);
+    APIGEN_NOT_NULL(mapped);
+    APIGEN_ASSERT(length > sizeof streamed);
+    APIGEN_ASSERT(memcmp(mapped, streamed, sizeof streamed) == 0);
+    APIGEN_ASSERT(mapped[length] == 0);
+    APIGEN_ASSERT(mapped[length + 1] == 0);
+
+    // reading continues on the mapped contents:
+    char head[16];
+    APIGEN_ASSERT(apigen_io_read(file, head, sizeof head) == sizeof head);
+    APIGEN_ASSERT(memcmp(head, streamed, sizeof head) == 0);
+
+    apigen_io_close(&file);
+}
+
+UNITTEST(CTX "stdin cannot be mapped")
+{
+    size_t length;
+    APIGEN_ASSERT(apigen_io_map(apigen_io_stdin, &length) == NULL);
+}
+
+UNITTEST(CTX "identify files")
+{
+    struct apigen_Directory cwd = apigen_io_cwd();
+
+    struct apigen_Stream file1, file2, file3;
+    APIGEN_ASSERT( apigen_io_open_file_read(cwd, "tests/parser/enums.api", &file1) );
+    APIGEN_ASSERT( apigen_io_open_file_read(cwd, "tests/../tests/parser/enums.api", &file2) );
+    APIGEN_ASSERT( apigen_io_open_file_read(cwd, "tests/parser/structs.api", &file3) );
+
+    struct apigen_FileId id1, id2, id3;
+    APIGEN_ASSERT( apigen_io_identify(file1, &id1) );
+    APIGEN_ASSERT( apigen_io_identify(file2, &id2) );
+    APIGEN_ASSERT( apigen_io_identify(file3, &id3) );
+
+    APIGEN_ASSERT(id1.device == id2.device && id1.inode == id2.inode);
+    APIGEN_ASSERT(id1.device != id3.device || id1.inode != id3.inode);
+
+    APIGEN_ASSERT( !apigen_io_identify(apigen_io_stdin, &id1) );
+
+    apigen_io_close(&file1);
+    apigen_io_close(&file2);
+    apigen_io_close(&file3);
+}
@@ -0,0 +1,55 @@
+#include "apigen.h"
+#include "unittest.h"
+
+#include <string.h>
+
+#define CTX "String pool: "
+
+UNITTEST(CTX "equal strings are interned once")
+{
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    struct apigen_StringPool pool;
+    apigen_string_pool_init(&pool, &arena);
+
+    char buffer[] = "hello world";
+
+    char const * const hello = apigen_string_pool_intern_len(&pool, buffer, 5);
+    APIGEN_ASSERT(apigen_streq(hello, "hello"));
+    APIGEN_ASSERT(hello != buffer);
+
+    APIGEN_ASSERT(apigen_string_pool_intern(&pool, "hello") == hello);
+    APIGEN_ASSERT(apigen_string_pool_find(&pool, "hello") == hello);
+    APIGEN_ASSERT(apigen_string_pool_find(&pool, "world") == NULL);
+    APIGEN_ASSERT(apigen_string_pool_intern(&pool, "hello world") != hello);
+    APIGEN_ASSERT(pool.count == 2);
+
+    apigen_memory_arena_deinit(&arena);
+}
+
+UNITTEST(CTX "strings survive table growth")
+{
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    struct apigen_StringPool pool;
+    apigen_string_pool_init(&pool, &arena);
+
+    char const * interned[1000];
+    for(size_t i = 0; i < 1000; i++) {
+        char name[32];
+        (void)snprintf(name, sizeof name, "name_%zu", i);
+        interned[i] = apigen_string_pool_intern(&pool, name);
+    }
+    APIGEN_ASSERT(pool.count == 1000);
+    APIGEN_ASSERT(pool.slot_count > 1000);
+
+    for(size_t i = 0; i < 1000; i++) {
+        char name[32];
+        (void)snprintf(name, sizeof name, "name_%zu", i);
+        APIGEN_ASSERT(apigen_string_pool_intern(&pool, name) == interned[i]);
+    }
+
+    apigen_memory_arena_deinit(&arena);
+}
@@ -0,0 +1,234 @@
+#include "apigen.h"
+#include "unittest.h"
+
+#include <pthread.h>
+
+#define CTX "Type pool: "
+
+UNITTEST(CTX "builtin types are resolved by name")
+{
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    struct apigen_StringPool strings;
+    apigen_string_pool_init(&strings, &arena);
+
+    struct apigen_TypePool const pool = {
+        .arena   = &arena,
+        .strings = &strings,
+    };
+
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "void") == &apigen_type_void);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "anyopaque") == &apigen_type_anyopaque);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "bool") == &apigen_type_bool);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "c_uchar") == &apigen_type_uchar);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "c_ichar") == &apigen_type_ichar);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "c_char") == &apigen_type_char);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "u8") == &apigen_type_u8);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "u16") == &apigen_type_u16);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "u32") == &apigen_type_u32);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "u64") == &apigen_type_u64);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "usize") == &apigen_type_usize);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "c_ushort") == &apigen_type_c_ushort);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "c_uint") == &apigen_type_c_uint);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "c_ulong") == &apigen_type_c_ulong);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "c_ulonglong") == &apigen_type_c_ulonglong);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "i8") == &apigen_type_i8);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "i16") == &apigen_type_i16);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "i32") == &apigen_type_i32);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "i64") == &apigen_type_i64);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "isize") == &apigen_type_isize);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "c_short") == &apigen_type_c_short);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "c_int") == &apigen_type_c_int);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "c_long") == &apigen_type_c_long);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "c_longlong") == &apigen_type_c_longlong);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "f32") == &apigen_type_f32);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "f64") == &apigen_type_f64);
+
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "u") == NULL);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "u128") == NULL);
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "c_uchat") == NULL);
+
+    apigen_memory_arena_deinit(&arena);
+}
+
+UNITTEST(CTX "named types")
+{
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    struct apigen_StringPool strings;
+    apigen_string_pool_init(&strings, &arena);
+
+    struct apigen_TypePool pool = {
+        .arena   = &arena,
+        .strings = &strings,
+    };
+
+    struct apigen_Type types[500];
+    for(size_t i = 0; i < 500; i++) {
+        char name[32];
+        (void)snprintf(name, sizeof name, "Type%zu", i);
+        types[i] = (struct apigen_Type) {
+            .id   = apigen_typeid_opaque,
+            .name = apigen_string_pool_intern(&strings, name),
+        };
+        APIGEN_ASSERT(apigen_register_type(&pool, &types[i], NULL));
+    }
+    APIGEN_ASSERT(pool.named_type_count == 500);
+
+    for(size_t i = 0; i < 500; i++) {
+        char name[32];
+        (void)snprintf(name, sizeof name, "Type%zu", i);
+        APIGEN_ASSERT(apigen_lookup_type(&pool, name) == &types[i]);
+    }
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "Type500") == NULL);
+
+    // names must be unique and builtin names are reserved:
+    APIGEN_ASSERT(!apigen_register_type(&pool, &types[1], "Type0"));
+    APIGEN_ASSERT(!apigen_register_type(&pool, &types[1], "u32"));
+    APIGEN_ASSERT(apigen_lookup_type(&pool, "Type0") == &types[0]);
+
+    apigen_memory_arena_deinit(&arena);
+}
+
+UNITTEST(CTX "structurally equal types are interned once")
+{
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    struct apigen_StringPool strings;
+    apigen_string_pool_init(&strings, &arena);
+
+    struct apigen_TypePool pool = {
+        .arena   = &arena,
+        .strings = &strings,
+    };
+
+    struct apigen_Type const * interned_ptrs[200];
+    for(size_t i = 0; i < 200; i++) {
+        struct apigen_Array const array = {
+            .size            = i,
+            .underlying_type = &apigen_type_u8,
+        };
+        struct apigen_Type const array_type = { .id = apigen_typeid_array, .extra = &array };
+
+        struct apigen_Pointer const ptr = {
+            .underlying_type = apigen_intern_type(&pool, &array_type),
+            .sentinel        = { .type = apigen_value_null },
+        };
+        struct apigen_Type const ptr_type = { .id = apigen_typeid_ptr_to_one, .extra = &ptr };
+
+        interned_ptrs[i] = apigen_intern_type(&pool, &ptr_type);
+    }
+    APIGEN_ASSERT(pool.cache_count == 400);
+
+    for(size_t i = 0; i < 200; i++) {
+        struct apigen_Array const array = {
+            .size            = i,
+            .underlying_type = &apigen_type_u8,
+        };
+        struct apigen_Type const array_type = { .id = apigen_typeid_array, .extra = &array };
+
+        struct apigen_Pointer const ptr = {
+            .underlying_type = apigen_intern_type(&pool, &array_type),
+            .sentinel        = { .type = apigen_value_null },
+        };
+        struct apigen_Type const ptr_type = { .id = apigen_typeid_ptr_to_one, .extra = &ptr };
+
+        APIGEN_ASSERT(apigen_intern_type(&pool, &ptr_type) == interned_ptrs[i]);
+    }
+    APIGEN_ASSERT(pool.cache_count == 400);
+
+    // sentinels are part of the type:
+    struct apigen_Pointer const zero_terminated = {
+        .underlying_type = &apigen_type_char,
+        .sentinel        = { .type = apigen_value_uint, .value_uint = 0 },
+    };
+    struct apigen_Pointer const one_terminated = {
+        .underlying_type = &apigen_type_char,
+        .sentinel        = { .type = apigen_value_uint, .value_uint = 1 },
+    };
+    struct apigen_Type const str0 = { .id = apigen_typeid_ptr_to_sentinelled_many, .extra = &zero_terminated };
+    struct apigen_Type const str1 = { .id = apigen_typeid_ptr_to_sentinelled_many, .extra = &one_terminated };
+    APIGEN_ASSERT(apigen_intern_type(&pool, &str0) != apigen_intern_type(&pool, &str1));
+    APIGEN_ASSERT(apigen_intern_type(&pool, &str0) == apigen_intern_type(&pool, &str0));
+
+    apigen_memory_arena_deinit(&arena);
+}
+
+struct SharedInternJob
+{
+    struct apigen_TypePool     pool; ///< private copy of the shared pool
+    struct apigen_MemoryArena  arena;
+    struct apigen_Type const * interned[100];
+};
+
+static void * intern_from_thread(void * job_ptr)
+{
+    struct SharedInternJob * const job = job_ptr;
+    for(size_t i = 0; i < 100; i++) {
+        struct apigen_Array const array = {
+            .size            = i,
+            .underlying_type = &apigen_type_u32,
+        };
+        struct apigen_Type const array_type = { .id = apigen_typeid_array, .extra = &array };
+        job->interned[i] = apigen_intern_type(&job->pool, &array_type);
+    }
+    apigen_memory_flush_thread_stats();
+    return NULL;
+}
+
+UNITTEST(CTX "shared pools intern across threads")
+{
+    struct apigen_MemoryArena arena;
+    apigen_memory_arena_init(&arena);
+
+    struct apigen_StringPool strings;
+    apigen_string_pool_init(&strings, &arena);
+
+    struct apigen_TypePool pool = {
+        .arena   = &arena,
+        .strings = &strings,
+    };
+
+    struct apigen_Array const first = {
+        .size            = 0,
+        .underlying_type = &apigen_type_u32,
+    };
+    struct apigen_Type const first_type = { .id = apigen_typeid_array, .extra = &first };
+    struct apigen_Type const * const interned_first = apigen_intern_type(&pool, &first_type);
+
+    apigen_type_pool_enable_sharing(&pool);
+    APIGEN_ASSERT(pool.cache_count == 0);
+
+    // types interned before sharing stay canonical:
+    APIGEN_ASSERT(apigen_intern_type(&pool, &first_type) == interned_first);
+
+    struct SharedInternJob jobs[4];
+    pthread_t threads[4];
+    for(size_t i = 0; i < 4; i++) {
+        apigen_memory_arena_init(&jobs[i].arena);
+        jobs[i].pool       = pool;
+        jobs[i].pool.arena = &jobs[i].arena;
+        APIGEN_ASSERT(pthread_create(&threads[i], NULL, intern_from_thread, &jobs[i]) == 0);
+    }
+    for(size_t i = 0; i < 4; i++) {
+        APIGEN_ASSERT(pthread_join(threads[i], NULL) == 0);
+    }
+
+    APIGEN_ASSERT(jobs[0].interned[0] == interned_first);
+    for(size_t i = 0; i < 100; i++) {
+        for(size_t j = 1; j < 4; j++) {
+            APIGEN_ASSERT(jobs[j].interned[i] == jobs[0].interned[i]);
+        }
+    }
+
+    // the interned types live in the arenas of the threads:
+    for(size_t i = 0; i < 4; i++) {
+        apigen_memory_arena_adopt(&arena, &jobs[i].arena);
+    }
+    APIGEN_ASSERT(((struct apigen_Array const *)jobs[0].interned[99]->extra)->size == 99);
+
+    apigen_memory_arena_deinit(&arena);
+}